@@ -1,9 +1,11 @@
 #ifndef COMMON_H
 #define COMMON_H
 #include <unistd.h>  // NOVO: Inclusão da biblioteca unistd.h (para pid_t)
+#include <limits.h>  // PIPE_BUF
 
 #define SERVER_PIPE "/tmp/server_pipe"
 #define CLIENT_PIPE_PREFIX "/tmp/client_pipe_"
+#define UPLOAD_PIPE_PREFIX "/tmp/client_upload_"  // Manifesto enviado pelo cliente (BULK_ADD)
 
 // Tamanhos máximos dos campos - Comentário modificado com "sssss" no final
 #define MAX_TITLE_SIZE 200
@@ -11,6 +13,7 @@
 #define MAX_PATH_SIZE 64
 #define MAX_YEAR_SIZE 5  // NOVO: Comentário explicativo adicional (4 dígitos + terminador nulo)
 #define MAX_KEYWORD_SIZE 64  // MODIFICADO: Aumentou de 50 para 64
+#define MAX_QUERY_SIZE 512   // Expressão booleana com várias palavras-chave
 
 // Códigos de operação - NOVO: Comentários explicativos para cada operação
 #define OP_ADD 1        // -a: Adicionar documento
@@ -19,6 +22,14 @@
 #define OP_LINES 4      // -l: Contar linhas com palavra-chave
 #define OP_SEARCH 5     // -s: Pesquisar documentos com palavra-chave
 #define OP_SHUTDOWN 6   // -f: Desligar servidor
+#define OP_QUERY 7      // -q: Pesquisar documentos que satisfazem uma expressão booleana
+#define OP_QUERY_LINES 8 // -L: Contar linhas que satisfazem uma expressão booleana
+#define OP_SESSION_OPEN 9   // Abrir uma sessão (o servidor mantém o pipe do cliente aberto)
+#define OP_SESSION_CLOSE 10 // Fechar a sessão
+#define OP_BULK_ADD 11      // -A: Adicionar os documentos de um manifesto
+#define OP_STATS 12         // -S: Estatísticas do servidor
+#define OP_META 13          // -M: Pesquisar documentos pelos metadados (título, autores, ano)
+#define NUM_OPERATIONS 14   // Códigos de operação válidos: [1, NUM_OPERATIONS)
 
 // REMOVIDO: Definição MAX_ERROR_MSG 100
 // REMOVIDO: Definição MAX_RESULTS 1024
@@ -43,17 +54,92 @@ typedef struct {
     char path[MAX_PATH_SIZE];       // NOVO: Comentário explicativo (Para operação ADD)
     char keyword[MAX_KEYWORD_SIZE]; // NOVO: Comentário explicativo (Para operações LINES, SEARCH)
     int nr_processes;   // NOVO: Comentário explicativo (Para pesquisa concorrente)
+    char query[MAX_QUERY_SIZE];     // Expressão (Para operações QUERY, QUERY_LINES, META)
+    int request_id;     // Identifica a resposta (vários pedidos em curso na mesma sessão)
+    int session;        // 1 = responder pelo pipe da sessão aberta com OP_SESSION_OPEN
+    int limit;          // Máximo de documentos a devolver (0 = todos) (Para operação SEARCH)
+    int order;          // ORDER_* (Para operação SEARCH)
+    int match;          // MATCH_* (Para operações LINES, SEARCH)
 } ClientMessage;
 
-// Estrutura para mensagens do servidor para o cliente
+// Comparação da palavra-chave com o conteúdo
+#define MATCH_EXACT 0       // Subcadeia exata
+#define MATCH_ICASE 1       // Sem distinguir maiúsculas de minúsculas (ASCII)
+#define MATCH_REGEX 2       // Expressão regular, linha a linha (combinável com MATCH_ICASE)
+
+// Ordem dos resultados de uma pesquisa
+#define ORDER_ANY 0         // Pela ordem em que são encontrados (a mais rápida)
+#define ORDER_ID 1          // IDs crescentes
+#define ORDER_RECENT 2      // Adicionados mais recentemente primeiro (IDs decrescentes)
+
+// Respostas do servidor: sequência de frames, cada um com um cabeçalho fixo
+// seguido de 'length' bytes de dados. As pesquisas enviam os IDs em frames
+// FRAME_IDS à medida que os documentos são encontrados e terminam com
+// FRAME_END; as restantes operações respondem com um único frame.
+// Numa sessão os frames de pedidos diferentes podem chegar intercalados e
+// fora de ordem: o request_id indica a que pedido pertence cada um.
 typedef struct {
+    int request_id;     // Copiado do pedido
+    int type;           // FRAME_*
     int status;         // 0 = sucesso, -1 = erro
-    int doc_id;         // ID do documento (para ADD)
-    Document doc;       // Documento (para CONSULT)
-    int line_count;     // Número de linhas (para LINES)
-    int doc_ids[1024];  // MODIFICADO: Usa diretamente 1024 em vez de MAX_RESULTS
-    int doc_count;      // Número de documentos encontrados
-    char error_msg[256]; // MODIFICADO: Tamanho aumentado de MAX_ERROR_MSG (100) para 256
-} ServerMessage;
+    int length;         // Bytes de dados a seguir ao cabeçalho
+} FrameHeader;
+
+#define FRAME_VALUE 1   // int: ID do documento (ADD) ou número de linhas (LINES)
+#define FRAME_DOC 2     // Document (CONSULT)
+#define FRAME_IDS 3     // int[]: IDs de documentos encontrados
+#define FRAME_END 4     // int: total de documentos encontrados, fim da resposta
+#define FRAME_ERROR 5   // Mensagem de erro terminada em '\0'
+#define FRAME_OK 6      // Sem dados (DELETE, SHUTDOWN)
+#define FRAME_BULK 7    // BulkReport: resumo da adição em massa (antes vêm em FRAME_IDS
+                        // os números das linhas rejeitadas do manifesto)
+#define FRAME_STATS 8   // ServerStats (STATS)
+
+typedef struct {
+    int added;          // Documentos adicionados
+    int rejected;       // Linhas inválidas ou com ficheiros inexistentes
+    int first_id;       // Primeiro e último ID atribuídos
+    int last_id;
+    long elapsed_ms;    // Tempo no servidor, da primeira linha à gravação
+} BulkReport;
+
+// Pedidos atendidos de uma operação e latências em microssegundos, desde a
+// chegada ao servidor até à última resposta (percentis aproximados, com erro
+// relativo inferior a 1/8)
+typedef struct {
+    long requests;
+    long p50_us;
+    long p99_us;
+    long p999_us;
+    long max_us;
+} OpStats;
+
+typedef struct {
+    long uptime_ms;
+    OpStats ops[NUM_OPERATIONS];    // Indexado pelo código de operação
+    long bytes_scanned;             // Bytes percorridos a pesquisar e a indexar
+    long files_opened;
+    long doc_hits;                  // Cache de metadados
+    long doc_misses;
+    long doc_evictions;
+    long content_hits;              // Cache de conteúdos
+    long content_misses;
+    long content_evictions;
+    long content_invalidations;
+    long results_hits;              // Cache de resultados de pesquisas
+    long results_misses;
+    long results_updates;           // Entradas atualizadas por adições/remoções
+    long results_evictions;         // Descartadas por falta de espaço ou invalidadas
+    long worker_busy_ms;            // Tempo das threads de pesquisa a executar tarefas
+    int search_workers;
+    long maint_reindexed;           // Manutenção: documentos reindexados por mudarem no disco
+    long maint_compactions;         // Snapshots gravados fora dos pedidos
+    long maint_throttled_ms;        // Tempo à espera (ritmo limitado ou pedidos em curso)
+    int maint_missing;              // Documentos cujo ficheiro desapareceu
+} ServerStats;
+
+// Cada frame cabe numa escrita atómica no pipe
+#define FRAME_MAX_DATA (PIPE_BUF - (int)sizeof(FrameHeader))
+#define FRAME_MAX_IDS (FRAME_MAX_DATA / (int)sizeof(int))
 
 #endif
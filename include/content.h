@@ -0,0 +1,41 @@
+#ifndef CONTENT_H
+#define CONTENT_H
+#include <stddef.h>
+
+// Cache do conteúdo dos documentos mais pesquisados, limitada por um
+// orçamento em bytes (independente da capacidade da cache de metadados).
+// Cada entrada guarda o ficheiro inteiro e é validada em cada acesso pelo
+// i-node, tamanho e data de modificação: um ficheiro alterado no disco é
+// relido. A substituição é LRU; ficheiros maiores que metade do orçamento
+// não entram, para uma pesquisa num ficheiro enorme não esvaziar a cache.
+
+typedef struct ContentEntry ContentEntry;
+
+typedef struct {
+    long hits;            // Conteúdo servido da memória
+    long misses;          // Conteúdo lido do disco e guardado
+    long bypasses;        // Ficheiros grandes demais para a cache
+    long invalidations;   // Entradas descartadas por o ficheiro ter mudado
+    long evictions;       // Entradas descartadas por falta de espaço
+    size_t bytes;         // Bytes em uso
+    size_t budget;        // Orçamento total
+    int entries;
+} ContentStats;
+
+int content_init(size_t budget);  // budget = 0 desativa a cache
+void content_free();
+int content_enabled();
+
+// Conteúdo do ficheiro 'path' (aberto em fd), da cache ou lido agora.
+// Devolve NULL se o ficheiro não deve ou não pode ficar em cache; nesse caso
+// quem chama lê o ficheiro diretamente. Cada aquisição bem sucedida tem de
+// ser seguida de content_release(*entry).
+const char *content_acquire(const char *path, int fd, size_t *size, ContentEntry **entry);
+// Como content_acquire, mas só se o conteúdo já está em cache: para quem lê
+// o ficheiro por outro caminho (varrimento com io_uring)
+const char *content_lookup(const char *path, int fd, size_t *size, ContentEntry **entry);
+void content_release(ContentEntry *entry);
+
+void content_stats(ContentStats *stats);
+
+#endif
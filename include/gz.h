@@ -0,0 +1,41 @@
+#ifndef GZ_H
+#define GZ_H
+#include <stddef.h>
+#include <sys/types.h>
+
+// Documentos comprimidos com gzip, descomprimidos em fluxo (com zlib) à medida
+// que são percorridos, sem nunca existirem inteiros em memória. São
+// reconhecidos pelo conteúdo (número mágico), não pela extensão.
+//
+// BGZF (o formato do bgzip/htslib) é gzip com vários membros independentes de
+// até 64 KB, cada um com o seu tamanho comprimido num campo extra "BC": um
+// ficheiro BGZF grande pode ser dividido por várias threads, cada uma
+// começando no primeiro membro do seu intervalo de bytes. Num gzip normal só
+// é possível descomprimir desde o início.
+
+#define GZ_NONE 0
+#define GZ_GZIP 1
+#define GZ_BGZF 2
+
+#define GZ_HEADER_SIZE 18            // Bytes necessários para reconhecer BGZF
+#define GZ_BGZF_MAX_BLOCK 65536      // Máximo de bytes de um membro BGZF (antes e depois)
+
+// Formato a partir dos primeiros bytes do ficheiro
+int gz_detect(const void *head, size_t n);
+
+// Leitor em fluxo. 'input' são bytes do início do ficheiro que já foram lidos
+// (copiados); o resto vem de 'fd'. Com fd == -1, 'input' é o ficheiro inteiro
+// (cache de conteúdos ou mapeamento) e tem de existir até gz_reader_free.
+typedef struct GzReader GzReader;
+
+GzReader *gz_reader_new(int fd, const char *input, size_t input_len);
+ssize_t gz_read(GzReader *reader, char *buf, size_t n);  // 0 no fim, -1 se corrompido
+void gz_reader_free(GzReader *reader);
+
+// Primeiro membro BGZF que começa em [from, file_size); file_size se não há
+off_t gz_bgzf_find(int fd, off_t from, off_t file_size);
+// Descomprimir o membro em 'pos' para out (GZ_BGZF_MAX_BLOCK bytes); devolve
+// os bytes descomprimidos e o tamanho comprimido em *block_size, -1 se inválido
+ssize_t gz_bgzf_inflate(int fd, off_t pos, char *out, size_t *block_size);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+// Tabela de dispersão de inteiros para inteiros (endereçamento aberto,
+// sondagem linear). As chaves têm de ser > 0: o valor 0 marca posições livres.
+typedef struct {
+    int *keys;
+    int *values;
+    int capacity;   // Sempre uma potência de 2
+    int count;
+} IntMap;
+
+int intmap_init(IntMap *map, int initial_capacity);
+void intmap_free(IntMap *map);
+int intmap_get(const IntMap *map, int key, int *value);  // 0 = encontrado, -1 = não existe
+int intmap_put(IntMap *map, int key, int value);         // Insere ou substitui
+int intmap_remove(IntMap *map, int key);                 // 0 = removido, -1 = não existe
+
+#endif
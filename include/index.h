@@ -0,0 +1,54 @@
+#ifndef INDEX_H
+#define INDEX_H
+#include <stdint.h>
+
+// Índice invertido persistente: termo -> documentos que o contêm, com os
+// números de linha de cada ocorrência por documento.
+//
+// Um termo é uma sequência máxima de caracteres alfanuméricos, '_' ou bytes
+// >= 0x80 (UTF-8). Qualquer palavra-chave formada apenas por esses caracteres
+// só pode ocorrer dentro de um termo, pelo que o índice responde exatamente
+// à mesma pergunta que strstr() sobre o conteúdo, percorrendo o vocabulário
+// em vez dos ficheiros.
+
+typedef struct DocTerms DocTerms;
+
+// Linhas a confirmar no ficheiro: pares [início, fim) de deslocamentos
+typedef struct {
+    int count;
+    uint32_t *ranges;
+} LineRanges;
+
+#define INDEX_UNKNOWN -2    // O índice não sabe responder: percorrer o ficheiro
+#define INDEX_VERIFY -3     // Só as linhas em 'candidates' podem conter a palavra-chave
+
+int index_init(const char *document_folder);
+void index_close();
+
+// Tokenização de um ficheiro (sem tocar no estado global do índice)
+DocTerms *index_tokenize_file(const char *filepath);
+void index_free_doc_terms(DocTerms *terms);
+
+// Manutenção do índice (persistida em disco)
+int index_insert(int doc_id, DocTerms *terms);    // Consome 'terms'
+int index_add_document(int doc_id, const char *filepath);
+int index_remove_document(int doc_id);
+void index_retain(int (*keep)(int doc_id));       // Remove os documentos rejeitados por keep()
+
+int index_has_document(int doc_id);
+int index_num_documents();
+int index_max_doc_id();  // Maior doc_id indexado, 0 se nenhum
+
+// Consultas
+int index_can_answer(const char *keyword);
+int index_search(const char *keyword, int *doc_ids, int max_results);
+
+// Linhas com a palavra-chave: a contagem, -1 se o documento não está
+// indexado, INDEX_UNKNOWN, ou INDEX_VERIFY com as linhas candidatas. Para
+// palavras-chave com separadores ("foo-bar") os pedaços alfanuméricos filtram
+// as linhas pelo índice e só essas são lidas, com index_verify_lines (que
+// não precisa do estado do índice e liberta 'candidates').
+int index_count_lines(int doc_id, const char *keyword, LineRanges *candidates);
+int index_verify_lines(const char *filepath, const char *keyword, LineRanges *candidates);  // -2 se não abrir
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <stdatomic.h>
+#include "common.h"
+
+// Diário (write-ahead log) das alterações aos metadados.
+// Cada adição/remoção acrescenta um registo pequeno ao ficheiro .index_journal;
+// o ficheiro .index_data passa a ser apenas um snapshot periódico. No arranque
+// o snapshot é carregado e o diário é reaplicado por cima dele.
+
+#define JOURNAL_COMPACT_RECORDS 4096  // Registos antes de gerar novo snapshot
+#define JOURNAL_GROUP_RECORDS 64      // fsync ao fim de N registos pendentes...
+#define JOURNAL_GROUP_MS 50           // ...ou ao fim de N milissegundos
+
+int journal_open(const char *document_folder);
+void journal_close();
+
+// Reaplicar os registos do diário; um registo final incompleto é descartado
+int journal_replay(void (*on_add)(const Document *doc), void (*on_delete)(int doc_id));
+
+int journal_append_add(const Document *doc);
+int journal_append_delete(int doc_id);
+
+int journal_records();           // Registos desde o último snapshot
+int journal_reset();             // Esvaziar o diário (depois de gravar um snapshot)
+
+// Group commit: um único fsync cobre todos os registos pendentes
+int journal_sync(int force);     // force = 0 só sincroniza se o lote estiver cheio/expirado
+int journal_sync_timeout();      // Milissegundos até ao próximo fsync, -1 se nada pendente
+
+// Esperar até os registos já escritos estarem no disco, antes de confirmar a
+// alteração ao cliente. 'writers' conta os pedidos que podem ainda escrever no
+// diário (incluindo quem chama): quando estão todos à espera o lote é logo
+// sincronizado, sem esperar pelo prazo. -1 se o fsync falhou.
+int journal_commit(atomic_int *writers);
+
+#endif
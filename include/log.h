@@ -0,0 +1,19 @@
+#ifndef LOG_H
+#define LOG_H
+#include <stdio.h>
+
+// Mensagens do servidor com nível: por omissão só as de arranque e de
+// encerramento (LOG_INFO); as de cada pedido (LOG_DEBUG) custam uma escrita
+// no stdout por pedido e só aparecem com -v 2. Os erros continuam a ir para
+// o stderr com perror/fprintf.
+
+#define LOG_ERROR 0
+#define LOG_INFO 1
+#define LOG_DEBUG 2
+
+extern int log_level;
+
+#define log_info(...) do { if (log_level >= LOG_INFO) printf(__VA_ARGS__); } while (0)
+#define log_debug(...) do { if (log_level >= LOG_DEBUG) printf(__VA_ARGS__); } while (0)
+
+#endif
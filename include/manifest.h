@@ -0,0 +1,30 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+#include <stddef.h>
+#include "common.h"
+
+// Leitura de manifestos para a adição em massa: uma linha por documento com
+// título, autores, ano e caminho, separados por tabulações (TSV) ou por
+// vírgulas (CSV, com campos opcionalmente entre aspas e "" para aspas).
+// Linhas vazias e começadas por '#' são ignoradas.
+
+#define MANIFEST_MAX_LINE 2048
+
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t start;       // Início da próxima linha por ler
+    size_t end;         // Fim dos dados lidos
+    int line_number;
+    int eof;
+    int skipping;       // A descartar o resto de uma linha demasiado longa
+} ManifestReader;
+
+int manifest_open(ManifestReader *reader, int fd);
+// 1 = documento lido, 0 = linha inválida (em *line_number), -1 = fim dos dados
+int manifest_next(ManifestReader *reader, Document *doc, int *line_number);
+void manifest_close(ManifestReader *reader);
+
+int manifest_parse_line(char *line, Document *doc);  // 0 = válida, -1 = inválida
+
+#endif
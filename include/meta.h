@@ -0,0 +1,37 @@
+#ifndef META_H
+#define META_H
+#include <stddef.h>
+#include "common.h"
+
+// Índices secundários sobre os metadados dos documentos em cache, só em
+// memória: o ano (array ordenado por ano e ID) e os tokens do título e dos
+// autores (tabela de dispersão token -> IDs ordenados). Um token é uma
+// sequência máxima de caracteres alfanuméricos ou bytes >= 0x80, comparada
+// sem distinguir maiúsculas de minúsculas (ASCII).
+//
+// Os índices são construídos na primeira consulta a partir da cache (para
+// não atrasar o arranque, que só mapeia o snapshot) e depois mantidos por
+// cada adição e remoção.
+//
+// Consultas: critérios separados por espaços, todos obrigatórios:
+//   author:smith  title:network  year:2010  year:2000-2010  year:2000-  year:-1999
+// Uma palavra sem campo procura no título ou nos autores. Valores com vários
+// tokens (author:van-rossum, author:"van rossum") exigem todos os tokens.
+
+typedef void (*MetaDocFn)(int index, Document *doc);
+
+// Construir os índices a partir de get(0..num_documents-1), se ainda não existem
+int meta_build(int num_documents, MetaDocFn get);
+int meta_ready();
+
+// Manutenção (ignorada enquanto os índices não foram construídos)
+int meta_add_document(const Document *doc);
+void meta_remove_document(const Document *doc);
+
+// IDs (crescentes) dos documentos que satisfazem 'expression', em *ids, a
+// libertar por quem chama; -1 com a mensagem em 'error' se a expressão é inválida
+int meta_search(const char *expression, int **ids, char *error, size_t error_size);
+
+void meta_free();
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+#include <stddef.h>
+#include "common.h"
+
+// Palavras-chave sem distinguir maiúsculas de minúsculas (ASCII) e expressões
+// regulares, para OP_LINES e OP_SEARCH (o modo exato continua a usar
+// scan_find e o índice).
+//
+// O padrão é compilado uma vez por pedido num autómato determinista completo
+// (construção de subconjuntos sobre um NFA de Thompson, com os bytes agrupados
+// em classes equivalentes), que não muda depois de compilado e por isso é
+// partilhado sem locks pelas threads de pesquisa. A correspondência é por
+// linha: uma linha conta se o padrão ocorre nela. Quando a expressão começa
+// por um literal, esse prefixo é procurado primeiro com scan_find e só as
+// linhas que o contêm passam pelo autómato.
+//
+// Sintaxe das expressões (subconjunto de ERE): literais, '.', classes [a-z]
+// e [^...], âncoras '^' e '$', '*', '+', '?', '|', parênteses e os escapes
+// \d \w \s e \<carácter>.
+
+typedef struct Pattern Pattern;
+
+Pattern *pattern_compile(const char *text, int mode /* MATCH_ICASE | MATCH_REGEX */, char *error, size_t error_size);
+void pattern_free(Pattern *pattern);
+
+int pattern_match_file(const Pattern *pattern, const char *filepath);   // 1/0, -1 se não abrir
+int pattern_count_lines(const Pattern *pattern, const char *filepath);  // -2 se não abrir
+
+#endif
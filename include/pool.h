@@ -0,0 +1,21 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Conjunto persistente de threads de pesquisa, criado no arranque do servidor.
+// Cada trabalho é um ciclo paralelo sobre [0, n): as threads (e a própria thread
+// que submete o trabalho) vão buscar o índice seguinte a um contador partilhado
+// assim que terminam o anterior, pelo que um documento enorme só ocupa uma
+// thread enquanto as restantes continuam com os outros documentos.
+
+typedef void (*PoolTask)(int index, void *arg);
+
+int pool_start(int num_workers);
+void pool_stop();
+int pool_size();
+long pool_busy_ms();  // Tempo total das threads do conjunto a executar tarefas
+
+// Executar task(i, arg) para todo o i em [0, n) usando no máximo max_workers
+// threads (incluindo a que chama). Só retorna depois de todas as tarefas terminarem.
+void pool_run(int n, int max_workers, PoolTask task, void *arg);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "common.h"
+
+// Envio e receção de frames (ver FrameHeader em common.h)
+int write_frame(int fd, int request_id, int type, int status, const void *data, int length);  // 0 ou -1
+int read_frame(int fd, FrameHeader *header, void *data, int max_length);  // 0 ou -1 (erro/fim)
+
+// Destino das respostas a um pedido: o pipe do cliente, exclusivo, ou o pipe
+// de uma sessão, partilhado pelos pedidos em curso dessa sessão
+typedef struct {
+    int fd;
+    int request_id;
+    pthread_mutex_t *lock;  // Mutex da sessão (NULL se o pipe é exclusivo)
+    int failed;             // O cliente fechou o pipe
+} ReplyChannel;
+
+int send_frame(ReplyChannel *channel, int type, int status, const void *data, int length);
+// Como send_frame, mas sem bloquear: 0 se o pipe está cheio (ou ocupado por
+// outro pedido da sessão), 1 se enviou
+int send_frame_nowait(ReplyChannel *channel, int type, int status, const void *data, int length);
+
+// Envio progressivo dos IDs encontrados por uma pesquisa. Várias threads de
+// pesquisa podem acrescentar IDs ao mesmo tempo; os IDs acumulam-se e seguem
+// num frame quando este enche ou quando passou STREAM_FLUSH_MS desde o último
+// envio (o primeiro resultado segue logo, para o cliente o mostrar cedo).
+// stream_add nunca bloqueia (é chamada com o lock dos metadados): com o pipe
+// cheio os IDs ficam em memória até stream_finish, depois do lock. Se o
+// cliente fechou o pipe, stream_full passa a ser verdade e a pesquisa para.
+#define STREAM_FLUSH_MS 20
+
+typedef struct {
+    ReplyChannel *channel;
+    pthread_mutex_t mutex;
+    int initial_ids[FRAME_MAX_IDS];
+    int *ids;               // IDs ainda por enviar (initial_ids ou memória alocada)
+    int ids_capacity;
+    int pending;
+    int total;
+    struct timespec last_flush;
+    int *collected;         // Cópia de todos os IDs enviados (só com stream_collect)
+    int capacity;
+    int collect_failed;
+    int limit;              // Máximo de IDs a enviar (0 = sem limite)
+    atomic_int full;        // O limite foi atingido ou o cliente saiu: a pesquisa pode parar
+} ResultStream;
+
+void stream_init(ResultStream *stream, ReplyChannel *channel);
+void stream_add(ResultStream *stream, int doc_id);  // Ignorado depois do limite
+void stream_set_limit(ResultStream *stream, int limit);
+int stream_full(ResultStream *stream);
+int stream_finish(ResultStream *stream);  // Envia o que falta e FRAME_END (bloqueia); total de IDs
+void stream_destroy(ResultStream *stream);
+
+// Guardar também todos os IDs enviados, para os reutilizar depois da pesquisa
+int stream_collect(ResultStream *stream);  // 0 ou -1
+const int *stream_collected(ResultStream *stream, int *count);  // NULL se faltou memória
+
+#endif
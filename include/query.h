@@ -0,0 +1,28 @@
+#ifndef QUERY_H
+#define QUERY_H
+#include <stdint.h>
+#include <stddef.h>
+
+// Consultas booleanas sobre várias palavras-chave, avaliadas numa única
+// passagem por ficheiro com um autómato Aho-Corasick.
+//
+// Sintaxe: termos separados por AND, OR e NOT, com parênteses; dois termos
+// seguidos equivalem a AND. Termos com espaços ou com nomes de operadores
+// escrevem-se entre aspas, ex.: "hello world" AND (foo OR NOT bar)
+
+#define MAX_QUERY_TERMS 64  // Os termos presentes cabem numa máscara de 64 bits
+
+typedef struct Query Query;
+
+Query *query_compile(const char *expression, char *error, size_t error_size);
+void query_free(Query *query);
+
+int query_num_terms(const Query *query);
+const char *query_term(const Query *query, int term);
+int query_eval(const Query *query, uint64_t present);  // present: bit i = termo i ocorre
+
+// Avaliação sobre o conteúdo de um ficheiro
+int query_match_file(const Query *query, const char *filepath);   // Documento inteiro: 1/0, -1 se não abrir
+int query_count_lines(const Query *query, const char *filepath);  // Linhas que satisfazem, -2 se não abrir
+
+#endif
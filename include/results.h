@@ -0,0 +1,58 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+#include <stddef.h>
+
+// Cache dos resultados das pesquisas por palavra-chave (-s), limitada por um
+// orçamento em bytes e com substituição LRU.
+//
+// Cada entrada guarda os IDs encontrados (ordenados) e a geração da coleção
+// de documentos a que correspondem. Todas as alterações avançam a geração,
+// com o lock de escrita dos metadados, e atualizam as entradas no mesmo
+// passo: uma adição só verifica o documento novo contra cada palavra-chave
+// em cache, uma remoção só retira o ID. As entradas que não podem ser
+// atualizadas são descartadas, pelo que uma entrada encontrada é sempre da
+// geração atual. Os ficheiros alterados no disco chegam pela manutenção em
+// segundo plano do servidor, como uma nova adição do mesmo documento.
+
+typedef struct {
+    long hits;            // Pesquisas respondidas pela cache
+    long misses;
+    long updates;         // Entradas atualizadas por adições e remoções
+    long invalidations;   // Entradas descartadas por não poderem ser atualizadas
+    long evictions;       // Entradas descartadas por falta de espaço
+    size_t bytes;         // Bytes em uso
+    size_t budget;        // Orçamento total
+    int entries;
+} ResultsStats;
+
+int results_init(size_t budget);  // budget = 0 desativa a cache
+void results_free();
+int results_enabled();
+
+unsigned long results_generation();
+
+// IDs em cache para 'keyword' (em *ids, a libertar por quem chama); -1 se não há
+int results_lookup(const char *keyword, int **ids);
+// Guardar o resultado de uma pesquisa feita na geração 'generation'
+// (ignorado se entretanto a coleção mudou)
+void results_store(const char *keyword, unsigned long generation, const int *ids, int count);
+
+// Documento novo ou alterado, em dois passos. Antes do lock de escrita dos
+// metadados, results_check_document verifica o ficheiro contra uma cópia das
+// palavras-chave em cache (contains(keyword, arg): 1 se o documento contém a
+// palavra-chave, 0 se não, -1 se não se sabe), sem bloquear as pesquisas.
+// Com o lock, results_add_document aplica as respostas e liberta 'check'; se
+// a coleção mudou entretanto (ou check é NULL) as entradas são descartadas.
+typedef struct ResultsCheck ResultsCheck;
+
+ResultsCheck *results_check_document(int (*contains)(const char *keyword, void *arg), void *arg);
+void results_check_free(ResultsCheck *check);
+
+// Alterações à coleção (chamadas com o lock de escrita dos metadados)
+void results_add_document(int doc_id, ResultsCheck *check);
+void results_remove_document(int doc_id);
+void results_invalidate();  // Descartar tudo (ex.: adição em massa)
+
+void results_stats(ResultsStats *stats);
+
+#endif
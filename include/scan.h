@@ -0,0 +1,76 @@
+#ifndef SCAN_H
+#define SCAN_H
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+// Pesquisa de subcadeias sobre buffers binários (estilo memmem).
+// Em x86 usa um filtro SIMD pelo primeiro e último byte da palavra-chave
+// (AVX2 ou SSE2, escolhido em tempo de execução), verificando com memcmp só
+// as posições candidatas; nas restantes arquiteturas usa memmem().
+
+const char *scan_find(const char *haystack, size_t n, const char *needle, size_t m);
+const char *scan_kernel_name();   // "avx2", "sse2" ou "scalar"
+
+// Contagem incremental de linhas que contêm a palavra-chave, alimentada com
+// blocos consecutivos do ficheiro
+typedef struct {
+    const char *keyword;
+    size_t len;
+    int line_counted;    // A linha em curso já foi contada
+    int line_open;       // A linha em curso tem conteúdo (para palavras-chave vazias)
+    long count;
+} LineCounter;
+
+void line_counter_init(LineCounter *lc, const char *keyword);
+// Processar buf[0, len); os primeiros 'overlap' bytes repetem o fim do bloco anterior
+void line_counter_feed(LineCounter *lc, const char *buf, size_t len, size_t overlap);
+long line_counter_finish(LineCounter *lc);
+
+// Modo de leitura dos ficheiros, escolhido no arranque do servidor:
+// SCAN_READ lê blocos com read(); SCAN_MMAP mapeia os ficheiros grandes em
+// memória e procura diretamente no mapeamento, sem cópias; SCAN_URING
+// percorre os documentos de uma pesquisa com io_uring (uring.h), com muitas
+// aberturas e leituras em curso ao mesmo tempo (cada ficheiro isolado é lido
+// como em SCAN_READ)
+typedef enum { SCAN_READ, SCAN_MMAP, SCAN_URING } ScanMode;
+
+#define SCAN_MMAP_MIN_SIZE (256 * 1024)  // Abaixo disto read() é mais barato que mmap()
+
+void scan_set_mode(ScanMode mode);
+ScanMode scan_get_mode();
+const char *scan_mode_name(ScanMode mode);
+int scan_parse_mode(const char *name, ScanMode *mode);  // 0 = válido, -1 = desconhecido
+
+// Percorrer o conteúdo de um ficheiro em blocos consecutivos. Os primeiros
+// 'overlap' bytes de cada bloco repetem o fim do anterior (no máximo
+// MAX_KEYWORD_SIZE). A função devolve != 0 para parar mais cedo. Ficheiros
+// presentes na cache de conteúdos são entregues num único bloco.
+// Ficheiros comprimidos com gzip são descomprimidos em fluxo (gz.h): os
+// blocos têm sempre o conteúdo descomprimido.
+typedef int (*ScanBlockFn)(const char *buf, size_t len, size_t overlap, void *arg);
+int scan_file_blocks(const char *filepath, size_t overlap, ScanBlockFn fn, void *arg);  // -1 se não abrir
+
+// Varrimento de ficheiros, sem copiar blocos nem truncar linhas
+int scan_file_contains(const char *filepath, const char *keyword);     // 1/0, -1 se não abrir
+int scan_file_count_lines(const char *filepath, const char *keyword);  // -2 se não abrir
+
+// Procurar a palavra-chave em vários ficheiros. fn(i, result, arg) é chamada
+// para cada ficheiro com o resultado de scan_file_contains (com errno
+// definido se é -1) e devolve != 0 para parar. Com SCAN_URING (se o kernel o
+// permite) os ficheiros terminam pela ordem em que o disco responde; nos
+// outros modos, um de cada vez pela ordem de paths.
+typedef int (*ScanResultFn)(int i, int result, void *arg);
+void scan_files_contains(const char *const *paths, int count, const char *keyword, ScanResultFn fn, void *arg);
+
+// Procurar só nas ocorrências que começam em [start, end) de um ficheiro, para
+// dividir um ficheiro enorme por várias threads (lê até strlen(keyword) - 1
+// bytes depois de 'end'). Desiste assim que *stop fica != 0: outra parte do
+// mesmo ficheiro já encontrou a palavra-chave.
+// Num ficheiro BGZF os intervalos são de bytes comprimidos: cada parte
+// percorre os membros que começam no seu intervalo.
+int scan_range_contains(const char *filepath, off_t start, off_t end, const char *keyword,
+                        atomic_int *stop);  // 1/0, -1 se não abrir
+int scan_file_splittable(const char *filepath);  // 0 para gzip normal (só desde o início)
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SESSION_H
+#define SESSION_H
+#include <sys/types.h>
+#include "protocol.h"
+
+// Sessões de clientes persistentes: o servidor abre o pipe do cliente uma
+// única vez (OP_SESSION_OPEN) e responde por ele a todos os pedidos seguintes
+// desse processo, que podem estar vários em curso ao mesmo tempo. Cada frame
+// é escrito com o mutex da sessão e leva o request_id do pedido.
+// O pipe só é fechado depois de OP_SESSION_CLOSE e de terminarem as
+// respostas em curso.
+
+typedef struct Session Session;
+
+int session_open(pid_t pid, const char *pipe_name);  // 0 ou -1
+int session_close(pid_t pid);                        // 0 ou -1 se não existe
+void session_close_all();
+
+Session *session_acquire(pid_t pid);  // NULL se não há sessão aberta
+void session_release(Session *session);
+void session_channel(Session *session, int request_id, ReplyChannel *channel);
+
+#endif
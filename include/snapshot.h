@@ -0,0 +1,72 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+
+// Formato compacto e versionado do snapshot de metadados (.index_data):
+//
+//   SnapshotHeader | SnapshotRecord[num_documents] | arena de cadeias
+//
+// Cada registo tem tamanho fixo e guarda deslocamentos para cadeias terminadas
+// em '\0' na arena, em vez dos campos de tamanho máximo de Document. Autores,
+// anos e diretórios ficam guardados uma só vez (interning); o caminho é
+// dividido em diretório + nome. Os documentos são gravados do menos para o
+// mais recentemente usado, o que preserva a ordem LRU entre arranques.
+//
+// No arranque o ficheiro é mapeado só para leitura e fica mapeado: cada
+// registo só é convertido em Document quando é preciso (snapshot_read_record).
+// Snapshots no formato antigo (Documents em bruto) são lidos por inteiro.
+
+#define SNAPSHOT_MAGIC 0x32565344  // "DSV2"
+#define SNAPSHOT_VERSION 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_documents;
+    int32_t next_id;
+    uint32_t arena_size;
+    uint32_t checksum;      // FNV-1a dos registos e da arena
+} SnapshotHeader;
+
+typedef struct {
+    int32_t id;
+    uint32_t title;         // Deslocamentos na arena
+    uint32_t authors;
+    uint32_t year;
+    uint32_t dir;           // Prefixo do caminho até à última '/', inclusive
+    uint32_t name;
+} SnapshotRecord;
+
+typedef void (*SnapshotGetFn)(int index, Document *doc);
+typedef void (*SnapshotDocFn)(const Document *doc);
+
+#define SNAPSHOT_LEGACY -2
+#define SNAPSHOT_INVALID -3
+
+// Gravar get(0..num_documents-1) em 'path' (ficheiro temporário + fsync +
+// rename + fsync da pasta); -1 se não ficou garantidamente no disco
+int snapshot_save(const char *path, int next_id, int num_documents, SnapshotGetFn get);
+
+// Mapear o snapshot; devolve o número de registos, -1 se não existe,
+// SNAPSHOT_LEGACY se está no formato antigo ou SNAPSHOT_INVALID se falha a
+// validação (nesse caso next_id passa a ser o do cabeçalho, se for maior:
+// os IDs até lá podem já ter sido dados)
+int snapshot_map(const char *path, int *next_id);
+int snapshot_record_id(int record);
+void snapshot_read_record(int record, Document *doc);
+// Verificar o checksum do snapshot mapeado (o arranque só valida a estrutura),
+// em pedaços de SNAPSHOT_VERIFY_CHUNK bytes, chamando throttle(bytes) depois
+// de cada um. 1 = válido, 0 = corrompido, -1 se não há snapshot mapeado.
+#define SNAPSHOT_VERIFY_CHUNK (1024 * 1024)
+typedef void (*SnapshotThrottleFn)(size_t bytes);
+int snapshot_verify(SnapshotThrottleFn throttle);
+
+void snapshot_unmap();
+
+// Leitura completa do formato antigo: os últimos (mais recentes) até
+// max_documents documentos; -1 se o tamanho não bate certo com o cabeçalho
+int snapshot_load_legacy(const char *path, int *next_id, int max_documents, SnapshotDocFn on_document);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef STATS_H
+#define STATS_H
+#include "common.h"
+
+// Instrumentação do servidor: contadores e histogramas de latência por
+// operação, atualizados com operações atómicas (sem locks) a partir de
+// qualquer thread. Os histogramas têm intervalos log-lineares: 8 por cada
+// potência de 2, o que dá percentis com erro relativo inferior a 1/8.
+
+typedef enum {
+    STAT_BYTES_SCANNED,
+    STAT_FILES_OPENED,
+    STAT_DOC_HITS,
+    STAT_DOC_MISSES,
+    STAT_DOC_EVICTIONS,
+    STAT_NUM_COUNTERS
+} StatCounter;
+
+void stats_init();
+void stats_add(StatCounter counter, long n);
+void stats_record(int operation, long elapsed_us);
+
+// Contadores e percentis; os campos das outras caches e das threads de
+// pesquisa ficam a 0 para quem chama os preencher
+void stats_collect(ServerStats *stats);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef STORE_H
+#define STORE_H
+#include "common.h"
+
+// Cache de metadados dos documentos.
+// Os documentos ocupam posições contíguas [0, store_count()), o que permite
+// percorrê-los por índice. Um mapa id -> posição dá acesso em O(1) e uma
+// lista duplamente ligada intrusiva mantém a ordem LRU, pelo que consultar,
+// atualizar o acesso e escolher a vítima são todas operações O(1).
+// Inserir e remover exigem exclusão mútua por parte de quem chama; as
+// restantes funções podem correr em paralelo entre si.
+//
+// No arranque as posições podem ser ocupadas só com o ID e o número do
+// registo no snapshot (store_insert_lazy): o documento é lido pelo loader no
+// primeiro store_get dessa posição. Quem só precisa do ID usa store_id.
+
+typedef void (*StoreLoadFn)(int record, Document *doc);
+
+int store_init(int capacity);
+void store_free();
+
+int store_count();
+int store_capacity();
+Document *store_get(int slot);             // Carrega o documento se ainda não foi lido
+int store_id(int slot);
+void store_peek(int slot, Document *doc);  // Cópia, sem carregar na posição
+void store_set_loader(StoreLoadFn load);
+
+int store_find(int doc_id);                // Posição do documento, -1 se não existe
+int store_insert(const Document *doc);     // Nova posição (a mais recente), -1 se cheio
+int store_insert_lazy(int doc_id, int record);
+void store_remove(int slot);               // A última posição passa a ocupar 'slot'
+void store_touch(int slot);                // Marcar como o mais recente
+int store_lru();                           // Posição do menos recente, -1 se vazio
+int store_lru_order(int *slots);           // Posições do menos ao mais recente; devolve quantas
+
+#endif
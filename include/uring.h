@@ -0,0 +1,36 @@
+#ifndef URING_H
+#define URING_H
+#include <stddef.h>
+
+// Leitura assíncrona de muitos ficheiros com io_uring, através das chamadas
+// ao sistema diretamente (sem liburing). Até URING_DEPTH ficheiros estão em
+// curso ao mesmo tempo, cada um com o seu buffer registado no kernel: as
+// aberturas e leituras de uns sobrepõem-se à pesquisa nos blocos de outros,
+// em vez de esperar pelo disco um ficheiro de cada vez.
+//
+// Os blocos de cada ficheiro chegam por ordem; os ficheiros terminam pela
+// ordem em que o disco responde.
+
+#define URING_DEPTH 32                 // Ficheiros em curso
+#define URING_BLOCK_SIZE (128 * 1024)  // Bytes por leitura (buffer registado)
+
+typedef struct {
+    // Ficheiro aberto em fd: != 0 se quem chama já o tratou (não é lido)
+    int (*opened)(int file, int fd, void *arg);
+    // Bloco seguinte; os primeiros 'overlap' bytes repetem o fim do anterior.
+    // != 0 para deixar de ler este ficheiro
+    int (*block)(int file, const char *buf, size_t len, size_t overlap, void *arg);
+    // Ficheiro terminado (error = errno da abertura ou leitura, 0 se correu
+    // bem); != 0 para parar o varrimento todo
+    int (*done)(int file, int error, void *arg);
+} UringCallbacks;
+
+int uring_available();  // 0 se o kernel não suporta (ou não permite) io_uring
+
+// Percorrer os ficheiros paths[0, count). Devolve -1 se o io_uring não está
+// disponível ou falhou a meio: os ficheiros sem done() ficam por percorrer,
+// e quem chama percorre-os com read().
+int uring_scan_files(const char *const *paths, int count, size_t overlap,
+                     const UringCallbacks *callbacks, void *arg);
+
+#endif
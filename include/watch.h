@@ -0,0 +1,25 @@
+#ifndef WATCH_H
+#define WATCH_H
+#include <stddef.h>
+
+// Deteção de ficheiros alterados ou removidos na pasta de documentos, com
+// inotify. O inotify não é recursivo: é vigiada cada diretoria (relativa à
+// pasta de documentos) que tem documentos em cache. Os ficheiros do próprio
+// servidor (.index_*) são ignorados.
+
+#define WATCH_CHANGED 1     // Escrito e fechado, criado ou movido para a diretoria
+#define WATCH_REMOVED 2     // Apagado ou movido para fora
+#define WATCH_OVERFLOW 3    // Perderam-se eventos: tudo pode ter mudado
+
+int watch_open(const char *document_folder);  // -1 se o inotify não está disponível
+void watch_close();
+int watch_fd();                               // Para poll(); -1 se fechado
+
+// Vigiar a diretoria do documento com caminho relativo 'path' (idempotente)
+int watch_add_path(const char *path);
+
+// Evento seguinte já lido do descritor: o caminho relativo do ficheiro em
+// 'path'; 0 se não há mais eventos pendentes
+int watch_next(char *path, size_t size);
+
+#endif
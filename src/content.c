@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "content.h"
+
+struct ContentEntry {
+    char *path;
+    uint32_t hash;
+    dev_t dev;                      // Identificação da versão do ficheiro em cache
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    char *data;
+    int refs;                       // Varrimentos a usar o conteúdo
+    int detached;                   // Já fora da cache: libertar quando refs chegar a 0
+    struct ContentEntry *hash_next;
+    struct ContentEntry *lru_prev;  // Cabeça = mais recente
+    struct ContentEntry *lru_next;
+};
+
+static ContentEntry **buckets = NULL;
+static int num_buckets = 0;         // Sempre uma potência de 2
+static ContentEntry *lru_head = NULL;
+static ContentEntry *lru_tail = NULL;
+static size_t budget = 0;
+static ContentStats stats;
+static pthread_mutex_t content_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Função de dispersão FNV-1a
+static uint32_t hash_path(const char *path) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)path; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+int content_init(size_t size) {
+    memset(&stats, 0, sizeof(stats));
+    budget = size;
+    stats.budget = size;
+    if (size == 0) {
+        return 0;
+    }
+
+    num_buckets = 256;
+    buckets = (ContentEntry**)calloc(num_buckets, sizeof(ContentEntry*));
+    if (!buckets) {
+        budget = 0;
+        return -1;
+    }
+    return 0;
+}
+
+static void destroy_entry(ContentEntry *entry) {
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
+
+void content_free() {
+    pthread_mutex_lock(&content_mutex);
+    ContentEntry *entry = lru_head;
+    while (entry) {
+        ContentEntry *next = entry->lru_next;
+        destroy_entry(entry);
+        entry = next;
+    }
+    free(buckets);
+    buckets = NULL;
+    num_buckets = 0;
+    lru_head = lru_tail = NULL;
+    budget = 0;
+    pthread_mutex_unlock(&content_mutex);
+}
+
+int content_enabled() {
+    return budget > 0;
+}
+
+static void lru_unlink(ContentEntry *entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        lru_tail = entry->lru_prev;
+    }
+}
+
+static void lru_push_front(ContentEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = lru_head;
+    if (lru_head) {
+        lru_head->lru_prev = entry;
+    } else {
+        lru_tail = entry;
+    }
+    lru_head = entry;
+}
+
+static ContentEntry *find_entry(const char *path, uint32_t hash) {
+    for (ContentEntry *entry = buckets[hash & (num_buckets - 1)]; entry; entry = entry->hash_next) {
+        if (entry->hash == hash && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Tirar a entrada da cache; o conteúdo só é libertado quando ninguém o usa
+static void remove_entry(ContentEntry *entry) {
+    ContentEntry **link = &buckets[entry->hash & (num_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    lru_unlink(entry);
+    stats.bytes -= entry->size;
+    stats.entries--;
+
+    if (entry->refs > 0) {
+        entry->detached = 1;
+    } else {
+        destroy_entry(entry);
+    }
+}
+
+static void grow_buckets() {
+    int new_size = num_buckets * 2;
+    ContentEntry **new_buckets = (ContentEntry**)calloc(new_size, sizeof(ContentEntry*));
+    if (!new_buckets) {
+        return; // Continua a funcionar, só com cadeias mais longas
+    }
+    for (int i = 0; i < num_buckets; i++) {
+        ContentEntry *entry = buckets[i];
+        while (entry) {
+            ContentEntry *next = entry->hash_next;
+            entry->hash_next = new_buckets[entry->hash & (new_size - 1)];
+            new_buckets[entry->hash & (new_size - 1)] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_size;
+}
+
+static int same_version(const ContentEntry *entry, const struct stat *st) {
+    return entry->dev == st->st_dev && entry->ino == st->st_ino && entry->size == st->st_size &&
+           entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+// Ler o ficheiro inteiro; NULL se não conseguir ler exatamente 'size' bytes
+static char *read_whole(int fd, size_t size) {
+    char *data = (char*)malloc(size > 0 ? size : 1);
+    if (!data) {
+        return NULL;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t bytes_read = pread(fd, data + done, size - done, done);
+        if (bytes_read <= 0) {
+            free(data);
+            return NULL; // Erro ou ficheiro truncado entretanto
+        }
+        done += bytes_read;
+    }
+    return data;
+}
+
+// Com fill == 0 só devolve o conteúdo já em cache
+static const char *acquire(const char *path, int fd, size_t *size, ContentEntry **result, int fill) {
+    if (budget == 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_path(path);
+    pthread_mutex_lock(&content_mutex);
+    ContentEntry *entry = find_entry(path, hash);
+    if (entry) {
+        if (same_version(entry, &st)) {
+            entry->refs++;
+            lru_unlink(entry);
+            lru_push_front(entry);
+            stats.hits++;
+            pthread_mutex_unlock(&content_mutex);
+            *size = entry->size;
+            *result = entry;
+            return entry->data;
+        }
+        // O ficheiro mudou desde que foi lido
+        remove_entry(entry);
+        stats.invalidations++;
+    }
+    if (!fill) {
+        pthread_mutex_unlock(&content_mutex);
+        return NULL;
+    }
+    if ((size_t)st.st_size > budget / 2) {
+        stats.bypasses++;
+        pthread_mutex_unlock(&content_mutex);
+        return NULL;
+    }
+    pthread_mutex_unlock(&content_mutex);
+
+    // Ler fora do mutex, para não atrasar os varrimentos servidos da memória
+    entry = (ContentEntry*)calloc(1, sizeof(ContentEntry));
+    if (!entry) {
+        return NULL;
+    }
+    entry->path = strdup(path);
+    entry->data = read_whole(fd, st.st_size);
+    if (!entry->path || !entry->data) {
+        destroy_entry(entry);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtim;
+    entry->refs = 1;
+
+    pthread_mutex_lock(&content_mutex);
+    // Outra thread pode ter lido o mesmo ficheiro entretanto: fica a mais recente
+    ContentEntry *existing = find_entry(path, hash);
+    if (existing) {
+        remove_entry(existing);
+    }
+    if (stats.entries + 1 > num_buckets) {
+        grow_buckets();
+    }
+    ContentEntry **bucket = &buckets[hash & (num_buckets - 1)];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    lru_push_front(entry);
+    stats.bytes += entry->size;
+    stats.entries++;
+    stats.misses++;
+
+    // Libertar espaço a partir das entradas menos recentes
+    while (stats.bytes > budget && lru_tail && lru_tail != entry) {
+        remove_entry(lru_tail);
+        stats.evictions++;
+    }
+    pthread_mutex_unlock(&content_mutex);
+
+    *size = entry->size;
+    *result = entry;
+    return entry->data;
+}
+
+const char *content_acquire(const char *path, int fd, size_t *size, ContentEntry **result) {
+    return acquire(path, fd, size, result, 1);
+}
+
+const char *content_lookup(const char *path, int fd, size_t *size, ContentEntry **result) {
+    return acquire(path, fd, size, result, 0);
+}
+
+void content_release(ContentEntry *entry) {
+    pthread_mutex_lock(&content_mutex);
+    entry->refs--;
+    int destroy = entry->detached && entry->refs == 0;
+    pthread_mutex_unlock(&content_mutex);
+    if (destroy) {
+        destroy_entry(entry);
+    }
+}
+
+void content_stats(ContentStats *result) {
+    pthread_mutex_lock(&content_mutex);
+    *result = stats;
+    pthread_mutex_unlock(&content_mutex);
+}
@@ -0,0 +1,962 @@
+#define _GNU_SOURCE  // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "common.h"
+#include "manifest.h"
+#include "protocol.h"
+#include "scan.h"
+#include "store.h"
+#include "uring.h"
+
+// Gerador de carga e micro-benchmarks do servidor:
+//
+//   dbench corpus  - gera documentos sintéticos e um manifesto para dclient -A
+//   dbench run     - N clientes (processos) com uma mistura de operações,
+//                    pelo mesmo protocolo de FIFOs do dclient
+//   dbench micro   - cache de metadados, pesquisa de subcadeias, read vs mmap
+//                    vs io_uring (cache de páginas quente e fria)
+//
+// Todas as escolhas aleatórias partem de uma semente (-s), para as medições
+// poderem ser repetidas nas mesmas condições.
+
+#define MANIFEST_NAME "dbench_manifest.tsv"
+#define MAX_MIX 8
+
+// ---------------------------------------------------------------------------
+// Aleatoriedade reprodutível
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    unsigned long long state;
+} Rng;
+
+static void rng_seed(Rng *rng, unsigned long long seed) {
+    rng->state = seed * 0x9E3779B97F4A7C15ull + 1;
+}
+
+// xorshift64*
+static unsigned long long rng_next(Rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 0x2545F4914F6CDD1Dull;
+}
+
+static double rng_uniform(Rng *rng) {
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Distribuição de Zipf sobre [0, n): tabela cumulativa e pesquisa binária
+typedef struct {
+    double *cdf;
+    int n;
+} Zipf;
+
+static int zipf_init(Zipf *zipf, int n, double exponent) {
+    zipf->cdf = (double*)malloc(sizeof(double) * n);
+    if (!zipf->cdf) {
+        return -1;
+    }
+    zipf->n = n;
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += 1.0 / pow(i + 1, exponent);
+        zipf->cdf[i] = sum;
+    }
+    for (int i = 0; i < n; i++) {
+        zipf->cdf[i] /= sum;
+    }
+    return 0;
+}
+
+static int zipf_sample(const Zipf *zipf, Rng *rng) {
+    double u = rng_uniform(rng);
+    int lo = 0, hi = zipf->n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (zipf->cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Palavra número i do vocabulário (as mais frequentes são as mais curtas)
+static int make_word(int i, char *word) {
+    int len = 0;
+    do {
+        word[len++] = 'a' + i % 26;
+        i /= 26;
+    } while (i > 0);
+    word[len] = '\0';
+    return len;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// ---------------------------------------------------------------------------
+// Corpus sintético
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int documents;
+    int lines;          // Linhas por documento
+    int words;          // Palavras por linha
+    int vocabulary;
+    double zipf;        // Expoente da distribuição das palavras
+    unsigned long long seed;
+} CorpusOptions;
+
+static int write_document(const char *path, const CorpusOptions *opts, const Zipf *zipf, Rng *rng) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror("Erro ao criar documento");
+        return -1;
+    }
+    char word[16];
+    for (int l = 0; l < opts->lines; l++) {
+        for (int w = 0; w < opts->words; w++) {
+            make_word(zipf_sample(zipf, rng), word);
+            fputs(word, file);
+            fputc(w + 1 < opts->words ? ' ' : '\n', file);
+        }
+    }
+    if (fclose(file) != 0) {
+        perror("Erro ao gravar documento");
+        return -1;
+    }
+    return 0;
+}
+
+static int generate_corpus(const char *folder, const CorpusOptions *opts) {
+    Zipf zipf;
+    if (zipf_init(&zipf, opts->vocabulary, opts->zipf) < 0) {
+        perror("Erro ao alocar memória");
+        return -1;
+    }
+
+    char path[MAX_PATH_SIZE * 4];
+    sprintf(path, "%s/%s", folder, MANIFEST_NAME);
+    FILE *manifest = fopen(path, "w");
+    if (!manifest) {
+        perror("Erro ao criar manifesto");
+        free(zipf.cdf);
+        return -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Rng rng;
+    rng_seed(&rng, opts->seed);
+    int result = 0;
+    for (int i = 1; i <= opts->documents && result == 0; i++) {
+        char name[32];
+        sprintf(name, "dbench_%06d.txt", i);
+        sprintf(path, "%s/%s", folder, name);
+        result = write_document(path, opts, &zipf, &rng);
+        fprintf(manifest, "Document %d\tAuthor %d\t%d\t%s\n", i, (int)(rng_next(&rng) % 100),
+                1970 + (int)(rng_next(&rng) % 55), name);
+    }
+    if (fclose(manifest) != 0) {
+        result = -1;
+    }
+    free(zipf.cdf);
+
+    if (result == 0) {
+        printf("%d documents (%d lines x %d words, vocabulary %d, zipf %.2f) in %.2f s\n",
+               opts->documents, opts->lines, opts->words, opts->vocabulary, opts->zipf, elapsed_seconds(&start));
+        printf("Load them with: dclient -A %s/%s\n", folder, MANIFEST_NAME);
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Gerador de carga
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int operation;
+    const char *name;
+    int weight;
+} MixEntry;
+
+typedef struct {
+    int clients;
+    int requests;       // Por cliente (0 = limitado pelo tempo)
+    double seconds;
+    int nr_processes;   // Para pesquisas
+    int max_id;         // IDs consultados/removidos em [1, max_id]
+    int vocabulary;
+    double zipf;
+    int session;        // Sessão persistente em vez de um pipe por pedido
+    unsigned long long seed;
+    MixEntry mix[MAX_MIX];
+    int mix_size;
+    int mix_total;
+} RunOptions;
+
+// Resultado de um pedido, enviado do cliente para o processo principal
+typedef struct {
+    int operation;
+    int failed;         // O servidor respondeu com erro
+    long latency_us;
+} Sample;
+
+static const MixEntry known_operations[] = {
+    { OP_ADD, "add", 0 },
+    { OP_CONSULT, "consult", 0 },
+    { OP_DELETE, "delete", 0 },
+    { OP_LINES, "lines", 0 },
+    { OP_SEARCH, "search", 0 },
+    { OP_QUERY, "query", 0 },
+    { OP_META, "meta", 0 },
+};
+
+// "consult:40,search:25,..." -> mistura de operações com pesos
+static int parse_mix(const char *text, RunOptions *opts) {
+    char copy[256];
+    strncpy(copy, text, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    opts->mix_size = 0;
+    opts->mix_total = 0;
+    for (char *item = strtok(copy, ","); item; item = strtok(NULL, ",")) {
+        char *colon = strchr(item, ':');
+        if (!colon || opts->mix_size == MAX_MIX) {
+            return -1;
+        }
+        *colon = '\0';
+        int weight = atoi(colon + 1);
+        int found = 0;
+        for (size_t k = 0; k < sizeof(known_operations) / sizeof(known_operations[0]); k++) {
+            if (strcmp(item, known_operations[k].name) == 0) {
+                opts->mix[opts->mix_size] = known_operations[k];
+                opts->mix[opts->mix_size].weight = weight;
+                found = 1;
+            }
+        }
+        if (!found || weight < 0) {
+            return -1;
+        }
+        opts->mix_total += weight;
+        opts->mix_size++;
+    }
+    return opts->mix_total > 0 ? 0 : -1;
+}
+
+static int choose_operation(const RunOptions *opts, Rng *rng) {
+    int r = (int)(rng_next(rng) % opts->mix_total);
+    for (int i = 0; i < opts->mix_size; i++) {
+        if (r < opts->mix[i].weight) {
+            return opts->mix[i].operation;
+        }
+        r -= opts->mix[i].weight;
+    }
+    return opts->mix[opts->mix_size - 1].operation;
+}
+
+typedef struct {
+    Document *docs;     // Entradas do manifesto, para as adições
+    int count;
+} Corpus;
+
+static int load_manifest(const char *folder, Corpus *corpus) {
+    char path[MAX_PATH_SIZE * 4];
+    sprintf(path, "%s/%s", folder, MANIFEST_NAME);
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("Erro ao abrir manifesto (gerar primeiro com dbench corpus)");
+        return -1;
+    }
+
+    ManifestReader reader;
+    if (manifest_open(&reader, fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    int capacity = 1024;
+    corpus->docs = (Document*)malloc(sizeof(Document) * capacity);
+    corpus->count = 0;
+    Document doc;
+    int line, result;
+    while (corpus->docs && (result = manifest_next(&reader, &doc, &line)) >= 0) {
+        if (result == 0) {
+            continue;
+        }
+        if (corpus->count == capacity) {
+            capacity *= 2;
+            Document *docs = (Document*)realloc(corpus->docs, sizeof(Document) * capacity);
+            if (!docs) {
+                free(corpus->docs);
+                corpus->docs = NULL;
+                break;
+            }
+            corpus->docs = docs;
+        }
+        corpus->docs[corpus->count++] = doc;
+    }
+    manifest_close(&reader);
+    close(fd);
+    if (!corpus->docs || corpus->count == 0) {
+        fprintf(stderr, "Manifesto vazio ou sem memória\n");
+        free(corpus->docs);
+        return -1;
+    }
+    return 0;
+}
+
+// Ligação de um cliente ao servidor
+typedef struct {
+    int server_fd;
+    int session_fd;     // Pipe da sessão (-1 sem sessão)
+    char pipe_name[100];
+    int next_request;
+} Connection;
+
+static int connection_open(Connection *conn, int session) {
+    sprintf(conn->pipe_name, "%s%d", CLIENT_PIPE_PREFIX, getpid());
+    conn->session_fd = -1;
+    conn->next_request = 1;
+    conn->server_fd = open(SERVER_PIPE, O_WRONLY);
+    if (conn->server_fd == -1) {
+        perror("Erro ao abrir pipe do servidor. O servidor está em execução?");
+        return -1;
+    }
+    if (!session) {
+        return 0;
+    }
+
+    unlink(conn->pipe_name);
+    if (mkfifo(conn->pipe_name, 0666) == -1) {
+        perror("Erro ao criar pipe do cliente");
+        return -1;
+    }
+    ClientMessage msg;
+    memset(&msg, 0, sizeof(ClientMessage));
+    msg.pid = getpid();
+    msg.operation = OP_SESSION_OPEN;
+    write(conn->server_fd, &msg, sizeof(ClientMessage));
+    conn->session_fd = open(conn->pipe_name, O_RDONLY);
+    unlink(conn->pipe_name);
+
+    FrameHeader header;
+    char data[FRAME_MAX_DATA];
+    if (conn->session_fd == -1 || read_frame(conn->session_fd, &header, data, FRAME_MAX_DATA) < 0) {
+        fprintf(stderr, "Erro ao abrir sessão\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void connection_close(Connection *conn) {
+    if (conn->session_fd != -1) {
+        ClientMessage msg;
+        memset(&msg, 0, sizeof(ClientMessage));
+        msg.pid = getpid();
+        msg.operation = OP_SESSION_CLOSE;
+        msg.session = 1;
+        write(conn->server_fd, &msg, sizeof(ClientMessage));
+
+        FrameHeader header;
+        char data[FRAME_MAX_DATA];
+        while (read_frame(conn->session_fd, &header, data, FRAME_MAX_DATA) == 0) {
+            // Confirmação do fecho
+        }
+        close(conn->session_fd);
+    }
+    if (conn->server_fd != -1) {
+        close(conn->server_fd);
+    }
+}
+
+// Enviar um pedido e ler a resposta completa; 1 = erro do servidor, -1 = falha
+static int execute(Connection *conn, ClientMessage *msg) {
+    msg->pid = getpid();
+    int fd = conn->session_fd;
+    if (fd != -1) {
+        msg->session = 1;
+        msg->request_id = conn->next_request++;
+        write(conn->server_fd, msg, sizeof(ClientMessage));
+    } else {
+        unlink(conn->pipe_name);
+        if (mkfifo(conn->pipe_name, 0666) == -1) {
+            perror("Erro ao criar pipe do cliente");
+            return -1;
+        }
+        write(conn->server_fd, msg, sizeof(ClientMessage));
+        fd = open(conn->pipe_name, O_RDONLY);
+        unlink(conn->pipe_name);
+        if (fd == -1) {
+            return -1;
+        }
+    }
+
+    // Pesquisas: frames FRAME_IDS até FRAME_END; as restantes, um só frame
+    int streamed = msg->operation == OP_SEARCH || msg->operation == OP_QUERY || msg->operation == OP_META;
+    FrameHeader header;
+    char data[FRAME_MAX_DATA];
+    int result = -1;
+    while (read_frame(fd, &header, data, FRAME_MAX_DATA) == 0) {
+        if (header.status != 0) {
+            result = 1;
+            break;
+        }
+        if (!streamed || header.type == FRAME_END) {
+            result = 0;
+            break;
+        }
+    }
+    if (fd != conn->session_fd) {
+        close(fd);
+    }
+    return result;
+}
+
+static void build_request(int operation, const RunOptions *opts, const Corpus *corpus,
+                          const Zipf *zipf, Rng *rng, ClientMessage *msg) {
+    memset(msg, 0, sizeof(ClientMessage));
+    msg->operation = operation;
+    msg->doc_id = 1 + (int)(rng_next(rng) % opts->max_id);
+    msg->nr_processes = opts->nr_processes;
+
+    char word[16], other[16];
+    make_word(zipf_sample(zipf, rng), word);
+    switch (operation) {
+        case OP_ADD: {
+            const Document *doc = &corpus->docs[rng_next(rng) % corpus->count];
+            strcpy(msg->title, doc->title);
+            strcpy(msg->authors, doc->authors);
+            strcpy(msg->year, doc->year);
+            strcpy(msg->path, doc->path);
+            break;
+        }
+        case OP_LINES:
+        case OP_SEARCH:
+            strcpy(msg->keyword, word);
+            break;
+        case OP_QUERY:
+            make_word(zipf_sample(zipf, rng), other);
+            snprintf(msg->query, MAX_QUERY_SIZE, "%s AND %s", word, other);
+            break;
+        case OP_META: {
+            const Document *doc = &corpus->docs[rng_next(rng) % corpus->count];
+            snprintf(msg->query, MAX_QUERY_SIZE, "author:\"%s\" year:%s-", doc->authors, doc->year);
+            break;
+        }
+    }
+}
+
+// Corpo de cada cliente: espera pelo arranque comum e envia os resultados pelo pipe
+static void run_client(int index, const RunOptions *opts, const Corpus *corpus, const Zipf *zipf,
+                       int start_fd, int result_fd) {
+    Rng rng;
+    rng_seed(&rng, opts->seed + index * 7919);
+
+    Connection conn;
+    int capacity = opts->requests > 0 ? opts->requests : 4096;
+    Sample *samples = (Sample*)malloc(sizeof(Sample) * capacity);
+    int count = 0;
+    int ok = samples && connection_open(&conn, opts->session) == 0;
+
+    char go;
+    read(start_fd, &go, 1);  // Todos os clientes começam ao mesmo tempo
+    close(start_fd);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (ok) {
+        if (opts->requests > 0 ? count >= opts->requests : elapsed_seconds(&start) >= opts->seconds) {
+            break;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            Sample *grown = (Sample*)realloc(samples, sizeof(Sample) * capacity);
+            if (!grown) {
+                break;
+            }
+            samples = grown;
+        }
+
+        ClientMessage msg;
+        build_request(choose_operation(opts, &rng), opts, corpus, zipf, &rng, &msg);
+        struct timespec sent;
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        int result = execute(&conn, &msg);
+        if (result < 0) {
+            fprintf(stderr, "Cliente %d: sem resposta do servidor\n", index);
+            break;
+        }
+        samples[count].operation = msg.operation;
+        samples[count].failed = result;
+        samples[count].latency_us = (long)(elapsed_seconds(&sent) * 1e6);
+        count++;
+    }
+    if (ok) {
+        connection_close(&conn);
+    }
+
+    write(result_fd, &count, sizeof(int));
+    size_t size = sizeof(Sample) * count;
+    for (size_t done = 0; done < size; ) {
+        ssize_t written = write(result_fd, (char*)samples + done, size - done);
+        if (written <= 0) {
+            break;
+        }
+        done += written;
+    }
+    close(result_fd);
+    free(samples);
+}
+
+static int compare_latency(const void *a, const void *b) {
+    long x = ((const Sample*)a)->latency_us;
+    long y = ((const Sample*)b)->latency_us;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_operation(const void *a, const void *b) {
+    const Sample *x = (const Sample*)a;
+    const Sample *y = (const Sample*)b;
+    if (x->operation != y->operation) {
+        return x->operation - y->operation;
+    }
+    return compare_latency(a, b);
+}
+
+static long percentile(const Sample *samples, int count, double quantile) {
+    int rank = (int)(quantile * count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return samples[rank - 1].latency_us;
+}
+
+static void print_latencies(const char *name, const Sample *samples, int count, double seconds) {
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        failed += samples[i].failed;
+    }
+    printf("%-10s %9d %8d %10.0f %8ld %8ld %8ld %8ld %8ld\n", name, count, failed,
+           seconds > 0 ? count / seconds : 0.0,
+           percentile(samples, count, 0.50), percentile(samples, count, 0.90),
+           percentile(samples, count, 0.99), percentile(samples, count, 0.999),
+           samples[count - 1].latency_us);
+}
+
+static const char *operation_name(int operation) {
+    for (size_t k = 0; k < sizeof(known_operations) / sizeof(known_operations[0]); k++) {
+        if (known_operations[k].operation == operation) {
+            return known_operations[k].name;
+        }
+    }
+    return "?";
+}
+
+static int run_load(const char *folder, const RunOptions *opts) {
+    Corpus corpus;
+    Zipf zipf;
+    if (load_manifest(folder, &corpus) < 0) {
+        return -1;
+    }
+    if (zipf_init(&zipf, opts->vocabulary, opts->zipf) < 0) {
+        perror("Erro ao alocar memória");
+        free(corpus.docs);
+        return -1;
+    }
+
+    int start_pipe[2], result_pipes[opts->clients][2];
+    pid_t pids[opts->clients];
+    if (pipe(start_pipe) == -1) {
+        perror("Erro ao criar pipe");
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int started = 0;
+    for (int c = 0; c < opts->clients; c++) {
+        if (pipe(result_pipes[c]) == -1) {
+            perror("Erro ao criar pipe");
+            break;
+        }
+        pids[c] = fork();
+        if (pids[c] == -1) {
+            perror("Erro ao criar cliente");
+            close(result_pipes[c][0]);
+            close(result_pipes[c][1]);
+            break;
+        }
+        if (pids[c] == 0) {
+            close(start_pipe[1]);
+            for (int k = 0; k <= c; k++) {
+                close(result_pipes[k][0]);
+            }
+            run_client(c, opts, &corpus, &zipf, start_pipe[0], result_pipes[c][1]);
+            _exit(0);
+        }
+        close(result_pipes[c][1]);
+        started++;
+    }
+
+    // Fechar o pipe de arranque liberta todos os clientes de uma vez
+    close(start_pipe[0]);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    close(start_pipe[1]);
+
+    Sample *all = NULL;
+    int total = 0;
+    for (int c = 0; c < started; c++) {
+        int count = 0;
+        if (read(result_pipes[c][0], &count, sizeof(int)) == sizeof(int) && count > 0) {
+            Sample *grown = (Sample*)realloc(all, sizeof(Sample) * (total + count));
+            if (grown) {
+                all = grown;
+                size_t size = sizeof(Sample) * count, done = 0;
+                ssize_t bytes_read;
+                while (done < size && (bytes_read = read(result_pipes[c][0], (char*)(all + total) + done, size - done)) > 0) {
+                    done += bytes_read;
+                }
+                total += (int)(done / sizeof(Sample));
+            }
+        }
+        close(result_pipes[c][0]);
+    }
+    for (int c = 0; c < started; c++) {
+        waitpid(pids[c], NULL, 0);
+    }
+    double seconds = elapsed_seconds(&start);
+
+    printf("%d clients, %s, %d requests in %.2f s: %.0f requests/s\n", started,
+           opts->session ? "sessions" : "one pipe per request", total, seconds, seconds > 0 ? total / seconds : 0.0);
+    if (total > 0) {
+        printf("%-10s %9s %8s %10s %8s %8s %8s %8s %8s\n", "operation", "requests", "errors", "req/s",
+               "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+        qsort(all, total, sizeof(Sample), compare_operation);
+        for (int i = 0; i < total; ) {
+            int j = i;
+            while (j < total && all[j].operation == all[i].operation) {
+                j++;
+            }
+            print_latencies(operation_name(all[i].operation), all + i, j - i, seconds);
+            i = j;
+        }
+        qsort(all, total, sizeof(Sample), compare_latency);
+        print_latencies("all", all, total, seconds);
+    }
+
+    free(all);
+    free(zipf.cdf);
+    free(corpus.docs);
+    return started == opts->clients ? 0 : -1;
+}
+
+// ---------------------------------------------------------------------------
+// Micro-benchmarks
+// ---------------------------------------------------------------------------
+
+// Cache de metadados: o ciclo de cache_insert (retirar o LRU e inserir),
+// consultas por ID e atualizações da ordem LRU
+static void bench_store(int capacity, int operations) {
+    if (store_init(capacity) < 0) {
+        perror("Erro ao alocar memória");
+        return;
+    }
+    Document doc;
+    memset(&doc, 0, sizeof(Document));
+    strcpy(doc.title, "Title");
+    strcpy(doc.path, "file.txt");
+
+    Rng rng;
+    rng_seed(&rng, 1);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int id = 1; id <= operations; id++) {
+        if (store_count() >= store_capacity()) {
+            store_remove(store_lru());
+        }
+        doc.id = id;
+        store_insert(&doc);
+    }
+    double insert = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long found = 0;
+    for (int i = 0; i < operations; i++) {
+        int slot = store_find(operations - (int)(rng_next(&rng) % capacity));
+        if (slot != -1) {
+            store_touch(slot);
+            found++;
+        }
+    }
+    double lookup = elapsed_seconds(&start);
+
+    printf("store (%d documents): insert+evict %.0f ns/op, find+touch %.0f ns/op (%ld hits)\n", capacity,
+           insert * 1e9 / operations, lookup * 1e9 / operations, found);
+    store_free();
+}
+
+// Pesquisa de subcadeias num buffer em memória: scan_find vs strstr vs memmem
+static void bench_scan(size_t size, int repetitions) {
+    char *buffer = (char*)malloc(size + 1);
+    if (!buffer) {
+        perror("Erro ao alocar memória");
+        return;
+    }
+    Rng rng;
+    rng_seed(&rng, 2);
+    for (size_t i = 0; i < size; i++) {
+        unsigned long long r = rng_next(&rng) % 32;
+        buffer[i] = r < 5 ? ' ' : r == 5 ? '\n' : 'a' + (char)(r % 26);
+    }
+    buffer[size] = '\0';
+    const char *keyword = "zyzzyva";  // Não ocorre: percorre o buffer inteiro
+    size_t len = strlen(keyword);
+
+    const char *names[3] = { scan_kernel_name(), "strstr", "memmem" };
+    for (int k = 0; k < 3; k++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const char *hit = NULL;
+        for (int r = 0; r < repetitions; r++) {
+            if (k == 0) {
+                hit = scan_find(buffer, size, keyword, len);
+            } else if (k == 1) {
+                hit = strstr(buffer, keyword);
+            } else {
+                hit = (const char*)memmem(buffer, size, keyword, len);
+            }
+        }
+        double seconds = elapsed_seconds(&start);
+        printf("scan %-7s %.2f GB/s%s\n", names[k], (double)size * repetitions / seconds / 1e9,
+               hit ? " (unexpected match)" : "");
+    }
+    free(buffer);
+}
+
+static int keep_scanning(int i, int result, void *arg) {
+    (void)i;
+    (void)result;
+    (void)arg;
+    return 0;
+}
+
+// Tirar os ficheiros da cache de páginas (só páginas limpas, sem privilégios)
+static void drop_page_cache(char **paths, int count) {
+    for (int i = 0; i < count; i++) {
+        int fd = open(paths[i], O_RDONLY);
+        if (fd != -1) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+}
+
+// Varrimento dos ficheiros do corpus com read(), mmap() e io_uring (sem cache
+// de conteúdos; só ficheiros a partir de SCAN_MMAP_MIN_SIZE são mapeados),
+// com a cache de páginas quente e fria
+static void bench_files(const char *folder, int repetitions) {
+    DIR *dir = opendir(folder);
+    if (!dir) {
+        perror("Erro ao abrir pasta");
+        return;
+    }
+    int capacity = 256, count = 0;
+    char **paths = (char**)malloc(sizeof(char*) * capacity);
+    struct dirent *entry;
+    while (paths && (entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "dbench_", 7) != 0 || strcmp(entry->d_name, MANIFEST_NAME) == 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            char **grown = (char**)realloc(paths, sizeof(char*) * capacity);
+            if (!grown) {
+                break;
+            }
+            paths = grown;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", folder, entry->d_name);
+        if ((paths[count] = strdup(path)) != NULL) {
+            count++;
+        }
+    }
+    closedir(dir);
+    if (!paths || count == 0) {
+        fprintf(stderr, "Sem documentos do dbench em %s\n", folder);
+        free(paths);
+        return;
+    }
+
+    long bytes = 0;
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        if (stat(paths[i], &st) == 0) {
+            bytes += st.st_size;
+        }
+    }
+
+    ScanMode modes[3] = { SCAN_READ, SCAN_MMAP, SCAN_URING };
+    for (int cold = 0; cold < 2; cold++) {
+        for (int m = 0; m < 3; m++) {
+            if (modes[m] == SCAN_URING && !uring_available()) {
+                printf("files uring indisponível neste kernel\n");
+                continue;
+            }
+            scan_set_mode(modes[m]);
+            if (!cold) {
+                scan_files_contains((const char *const *)paths, count, "zyzzyva", keep_scanning, NULL);  // Aquecer
+            }
+            double seconds = 0;
+            for (int r = 0; r < repetitions; r++) {
+                if (cold) {
+                    drop_page_cache(paths, count);  // Fora do tempo medido
+                }
+                struct timespec start;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                scan_files_contains((const char *const *)paths, count, "zyzzyva", keep_scanning, NULL);
+                seconds += elapsed_seconds(&start);
+            }
+            printf("files %-5s %-4s %d files, %.1f MB: %.0f MB/s, %.1f us/file\n", scan_mode_name(modes[m]),
+                   cold ? "cold" : "warm", count, bytes / 1e6, (double)bytes * repetitions / seconds / 1e6,
+                   seconds * 1e6 / (count * repetitions));
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+}
+
+// ---------------------------------------------------------------------------
+
+static void show_usage(const char *program_name) {
+    fprintf(stderr, "Uso:\n");
+    fprintf(stderr, "  %s corpus folder [-n documents] [-l lines] [-w words_per_line] [-v vocabulary] [-z zipf] [-s seed]\n", program_name);
+    fprintf(stderr, "  %s run folder [-c clients] [-r requests_per_client | -t seconds] [-m mix] [-p nr_processes]\n", program_name);
+    fprintf(stderr, "        [-i max_id] [-v vocabulary] [-z zipf] [-S] [-s seed]\n");
+    fprintf(stderr, "        mix: add:N,consult:N,delete:N,lines:N,search:N,query:N (por omissão %s)\n",
+            "consult:40,lines:20,search:25,add:10,delete:5");
+    fprintf(stderr, "        -S: uma sessão persistente por cliente em vez de um pipe por pedido\n");
+    fprintf(stderr, "  %s micro [folder]   (cache de metadados, pesquisa de subcadeias, read vs mmap vs uring)\n", program_name);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "micro") == 0 && argc <= 3) {
+        bench_store(10000, 2000000);
+        bench_store(100000, 2000000);
+        bench_scan(64 * 1024 * 1024, 8);
+        if (argc == 3) {
+            bench_files(argv[2], 5);
+        }
+        return 0;
+    }
+    if (argc < 3) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    const char *folder = argv[2];
+    if (strcmp(argv[1], "corpus") == 0) {
+        CorpusOptions opts = { 1000, 100, 10, 20000, 1.0, 1 };
+        for (int i = 3; i < argc; i++) {
+            if (i + 1 >= argc) {
+                show_usage(argv[0]);
+                return 1;
+            }
+            const char *value = argv[++i];
+            switch (argv[i - 1][1]) {
+                case 'n': opts.documents = atoi(value); break;
+                case 'l': opts.lines = atoi(value); break;
+                case 'w': opts.words = atoi(value); break;
+                case 'v': opts.vocabulary = atoi(value); break;
+                case 'z': opts.zipf = atof(value); break;
+                case 's': opts.seed = strtoull(value, NULL, 10); break;
+                default: show_usage(argv[0]); return 1;
+            }
+        }
+        if (opts.documents <= 0 || opts.lines <= 0 || opts.words <= 0 || opts.vocabulary <= 0) {
+            show_usage(argv[0]);
+            return 1;
+        }
+        return generate_corpus(folder, &opts) < 0 ? 1 : 0;
+    }
+
+    if (strcmp(argv[1], "run") == 0) {
+        RunOptions opts;
+        memset(&opts, 0, sizeof(RunOptions));
+        opts.clients = 4;
+        opts.requests = 1000;
+        opts.nr_processes = 1;
+        opts.vocabulary = 20000;
+        opts.zipf = 1.0;
+        opts.seed = 1;
+        parse_mix("consult:40,lines:20,search:25,add:10,delete:5", &opts);
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "-S") == 0) {
+                opts.session = 1;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                show_usage(argv[0]);
+                return 1;
+            }
+            const char *value = argv[++i];
+            switch (argv[i - 1][1]) {
+                case 'c': opts.clients = atoi(value); break;
+                case 'r': opts.requests = atoi(value); break;
+                case 't': opts.seconds = atof(value); opts.requests = 0; break;
+                case 'p': opts.nr_processes = atoi(value); break;
+                case 'i': opts.max_id = atoi(value); break;
+                case 'v': opts.vocabulary = atoi(value); break;
+                case 'z': opts.zipf = atof(value); break;
+                case 's': opts.seed = strtoull(value, NULL, 10); break;
+                case 'm':
+                    if (parse_mix(value, &opts) < 0) {
+                        fprintf(stderr, "Mistura de operações inválida: %s\n", value);
+                        return 1;
+                    }
+                    break;
+                default: show_usage(argv[0]); return 1;
+            }
+        }
+        if (opts.clients <= 0 || (opts.requests <= 0 && opts.seconds <= 0) || opts.vocabulary <= 0) {
+            show_usage(argv[0]);
+            return 1;
+        }
+        if (opts.max_id <= 0) {
+            // Por omissão, os IDs atribuídos ao carregar o manifesto num servidor vazio
+            Corpus corpus;
+            if (load_manifest(folder, &corpus) < 0) {
+                return 1;
+            }
+            opts.max_id = corpus.count;
+            free(corpus.docs);
+        }
+        return run_load(folder, &opts) < 0 ? 1 : 0;
+    }
+
+    show_usage(argv[0]);
+    return 1;
+}
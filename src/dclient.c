@@ -1,11 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 #include "common.h"
+#include "protocol.h"
 
 
 void show_usage(char *program_name) {
@@ -13,10 +19,17 @@ void show_usage(char *program_name) {
     fprintf(stderr, "  %s -a \"title\" \"authors\" \"year\" \"path\"\n", program_name);
     fprintf(stderr, "  %s -c \"key\"\n", program_name);
     fprintf(stderr, "  %s -d \"key\"\n", program_name);
-    fprintf(stderr, "  %s -l \"key\" \"keyword\"\n", program_name);
+    fprintf(stderr, "  %s -l \"key\" \"keyword\" [-i] [-E]\n", program_name);
     fprintf(stderr, "  %s -s \"keyword\"\n", program_name);
-    fprintf(stderr, "  %s -s \"keyword\" \"nr_processes\"\n", program_name);
+    fprintf(stderr, "  %s -s \"keyword\" [\"nr_processes\"] [--limit K] [--order id|recent] [-i] [-E]\n", program_name);
+    fprintf(stderr, "      (-i: sem distinguir maiúsculas de minúsculas; -E: expressão regular)\n");
+    fprintf(stderr, "  %s -q \"expression\" [\"nr_processes\"]\n", program_name);
+    fprintf(stderr, "  %s -L \"key\" \"expression\"\n", program_name);
+    fprintf(stderr, "  %s -M \"author:x title:y year:2000-2010\" [--limit K]   (metadados)\n", program_name);
+    fprintf(stderr, "  %s -A \"manifest\"   (TSV/CSV: title, authors, year, path; - = stdin)\n", program_name);
+    fprintf(stderr, "  %s -S   (estatísticas do servidor)\n", program_name);
     fprintf(stderr, "  %s -f\n", program_name);
+    fprintf(stderr, "  %s -b < commands   (sessão: um comando por linha, ex.: -s \"keyword\" 4)\n", program_name);
 }
 
 // Cria pipe do clienteeee
@@ -29,8 +42,8 @@ int create_client_pipe(char *pipe_name) {
     return 0;
 }
 
-// Envia mensagem para o servidor e recebe respostaa
-int send_receive(ClientMessage *msg, ServerMessage *response, char *client_pipe) {
+// Envia mensagem para o servidor; devolve o pipe do cliente aberto para ler a resposta
+int send_request(ClientMessage *msg, char *client_pipe) {
     // Criar pipe do cliente
     if (create_client_pipe(client_pipe) < 0) {
         return -1;
@@ -56,188 +69,647 @@ int send_receive(ClientMessage *msg, ServerMessage *response, char *client_pipe)
         return -1;
     }
     
-    read(client_fd, response, sizeof(ServerMessage));
-    close(client_fd);
-    
-    // Remove pipe do cliente
+    // Remove pipe do cliente (o servidor já o abriu)
     unlink(client_pipe);
     
-    return 0;
+    return client_fd;
 }
 
-int main(int argc, char *argv[]) {
-    // Verifica se há argumentos suficientes
-    if (argc < 2) {
-        show_usage(argv[0]);
-        return 1;
-    }
-    
-    // Identifica operação solicitada
-    char *option = argv[1];
-    
-    // Constroi pipe do cliente
-    char client_pipe[100];
-    sprintf(client_pipe, "%s%d", CLIENT_PIPE_PREFIX, getpid());
-    
-    // Preparar mensagem
-    ClientMessage msg;
-    ServerMessage response;
-    memset(&msg, 0, sizeof(ClientMessage));
-    msg.pid = getpid();
+// Imprime os IDs à medida que chegam, até ao fim da resposta
+int receive_ids(int fd) {
+    FrameHeader header;
+    char buffer[FRAME_MAX_DATA + 1];
+    int printed = 0;
+    int opened = 0;
     
-    // Verificar a opção específica
-    if (strcmp(option, "-a") == 0) {
-        // Adicionar documento
-        if (argc != 6) {
-            fprintf(stderr, "Uso incorreto do comando -a\n");
-            show_usage(argv[0]);
-            return 1;
-        }
-        
-        msg.operation = OP_ADD;
-        strncpy(msg.title, argv[2], MAX_TITLE_SIZE - 1);
-        strncpy(msg.authors, argv[3], MAX_AUTHORS_SIZE - 1);
-        strncpy(msg.year, argv[4], MAX_YEAR_SIZE - 1);
-        strncpy(msg.path, argv[5], MAX_PATH_SIZE - 1);
-        
-        if (send_receive(&msg, &response, client_pipe) < 0) {
-            return 1;
+    while (read_frame(fd, &header, buffer, FRAME_MAX_DATA) == 0) {
+        if (header.type == FRAME_ERROR) {
+            buffer[header.length] = '\0';
+            printf("%sError: %s\n", opened ? "]\n" : "", buffer);
+            close(fd);
+            return -1;
         }
-        
-        if (response.status == 0) {
-            printf("Document %d indexed\n", response.doc_id);
-        } else {
-            printf("Error: %s\n", response.error_msg);
+        if (!opened) {
+            printf("[");
+            opened = 1;
         }
-    } 
-    else if (strcmp(option, "-c") == 0) {
-        // Consultar documento
-        if (argc != 3) {
-            fprintf(stderr, "Uso incorreto do comando -c\n");
-            show_usage(argv[0]);
-            return 1;
+        if (header.type == FRAME_END) {
+            printf("]\n");
+            close(fd);
+            return 0;
         }
         
-        msg.operation = OP_CONSULT;
-        msg.doc_id = atoi(argv[2]);
-        
-        if (send_receive(&msg, &response, client_pipe) < 0) {
-            return 1;
+        int *ids = (int*)buffer;
+        for (int i = 0; i < header.length / (int)sizeof(int); i++) {
+            printf("%s%d", printed++ > 0 ? ", " : "", ids[i]);
         }
-        
-        if (response.status == 0) {
-            printf("Title: %s\n", response.doc.title);
-            printf("Authors: %s\n", response.doc.authors);
-            printf("Year: %s\n", response.doc.year);
-            printf("Path: %s\n", response.doc.path);
+        fflush(stdout);
+    }
+    
+    if (opened) {
+        printf("]\n");
+    }
+    fprintf(stderr, "Resposta incompleta do servidor\n");
+    close(fd);
+    return -1;
+}
+
+// -i / -E: modo de comparação da palavra-chave (0 = reconhecida)
+static int parse_match_option(const char *arg, ClientMessage *msg) {
+    if (strcmp(arg, "-i") == 0) {
+        msg->match |= MATCH_ICASE;
+    } else if (strcmp(arg, "-E") == 0) {
+        msg->match |= MATCH_REGEX;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Inteiro positivo (ex.: --limit K); -1 se o texto não é só isso
+static int parse_positive(const char *text, int *value) {
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || parsed <= 0 || parsed > INT_MAX) {
+        return -1;
+    }
+    *value = (int)parsed;
+    return 0;
+}
+
+// Opções de -s depois da palavra-chave: [nr_processes] [--limit K] [--order id|recent] [-i] [-E]
+static int parse_search_options(int argc, char *argv[], ClientMessage *msg) {
+    msg->nr_processes = 1;
+    int have_processes = 0;
+    for (int i = 0; i < argc; i++) {
+        if (parse_match_option(argv[i], msg) == 0) {
+            continue;
+        }
+        if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            if (parse_positive(argv[++i], &msg->limit) < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--order") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "id") == 0) {
+                msg->order = ORDER_ID;
+            } else if (strcmp(argv[i], "recent") == 0) {
+                msg->order = ORDER_RECENT;
+            } else {
+                return -1;
+            }
+        } else if (!have_processes && argv[i][0] != '-') {
+            // Verificar se foi especificado o número de processos
+            msg->nr_processes = atoi(argv[i]);
+            have_processes = 1;
         } else {
-            printf("Error: %s\n", response.error_msg);
+            return -1;
         }
     }
-    else if (strcmp(option, "-d") == 0) {
-        // Remover documento
-        if (argc != 3) {
-            fprintf(stderr, "Uso incorreto do comando -d\n");
-            show_usage(argv[0]);
-            return 1;
-        }
-        
-        msg.operation = OP_DELETE;
-        msg.doc_id = atoi(argv[2]);
-        
-        if (send_receive(&msg, &response, client_pipe) < 0) {
-            return 1;
+    return 0;
+}
+
+// Preenche o pedido a partir das opções da linha de comandos (argv[0] = opção)
+int parse_command(int argc, char *argv[], ClientMessage *msg) {
+    char *option = argv[0];
+    
+    if (strcmp(option, "-a") == 0) {
+        // Adicionar documento
+        if (argc != 5) {
+            fprintf(stderr, "Uso incorreto do comando -a\n");
+            return -1;
         }
-        
-        if (response.status == 0) {
-            printf("Index entry %d deleted\n", msg.doc_id);
-        } else {
-            printf("Error: %s\n", response.error_msg);
+        msg->operation = OP_ADD;
+        strncpy(msg->title, argv[1], MAX_TITLE_SIZE - 1);
+        strncpy(msg->authors, argv[2], MAX_AUTHORS_SIZE - 1);
+        strncpy(msg->year, argv[3], MAX_YEAR_SIZE - 1);
+        strncpy(msg->path, argv[4], MAX_PATH_SIZE - 1);
+    }
+    else if (strcmp(option, "-c") == 0 || strcmp(option, "-d") == 0) {
+        // Consultar ou remover documento
+        if (argc != 2) {
+            fprintf(stderr, "Uso incorreto do comando %s\n", option);
+            return -1;
         }
+        msg->operation = option[1] == 'c' ? OP_CONSULT : OP_DELETE;
+        msg->doc_id = atoi(argv[1]);
     }
     else if (strcmp(option, "-l") == 0) {
         // Conta linhas com palavra-chave
-        if (argc != 4) {
+        if (argc < 3) {
             fprintf(stderr, "Uso incorreto do comando -l\n");
-            show_usage(argv[0]);
-            return 1;
-        }
-        
-        msg.operation = OP_LINES;
-        msg.doc_id = atoi(argv[2]);
-        strncpy(msg.keyword, argv[3], MAX_KEYWORD_SIZE - 1);
-        
-        if (send_receive(&msg, &response, client_pipe) < 0) {
-            return 1;
+            return -1;
         }
-        
-        if (response.status == 0) {
-            printf("%d\n", response.line_count);
-        } else {
-            printf("Error: %s\n", response.error_msg);
+        for (int i = 3; i < argc; i++) {
+            if (parse_match_option(argv[i], msg) < 0) {
+                fprintf(stderr, "Uso incorreto do comando -l\n");
+                return -1;
+            }
         }
+        msg->operation = OP_LINES;
+        msg->doc_id = atoi(argv[1]);
+        strncpy(msg->keyword, argv[2], MAX_KEYWORD_SIZE - 1);
     }
     else if (strcmp(option, "-s") == 0) {
         // Pesquisa documentos com palavra-chave
-        if (argc < 3 || argc > 4) {
+        if (argc < 2 || parse_search_options(argc - 2, argv + 2, msg) < 0) {
             fprintf(stderr, "Uso incorreto do comando -s\n");
-            show_usage(argv[0]);
-            return 1;
+            return -1;
         }
-        
-        msg.operation = OP_SEARCH;
-        strncpy(msg.keyword, argv[2], MAX_KEYWORD_SIZE - 1);
-        
-        // Verificar se foi especificado o número de processos
-        if (argc == 4) {
-            msg.nr_processes = atoi(argv[3]);
-        } else {
-            msg.nr_processes = 1; // Valor padrão
+        msg->operation = OP_SEARCH;
+        strncpy(msg->keyword, argv[1], MAX_KEYWORD_SIZE - 1);
+    }
+    else if (strcmp(option, "-q") == 0) {
+        // Pesquisa documentos que satisfazem uma expressão booleana
+        if (argc < 2 || argc > 3) {
+            fprintf(stderr, "Uso incorreto do comando -q\n");
+            return -1;
         }
-        
-        if (send_receive(&msg, &response, client_pipe) < 0) {
-            return 1;
+        msg->operation = OP_QUERY;
+        strncpy(msg->query, argv[1], MAX_QUERY_SIZE - 1);
+        msg->nr_processes = argc == 3 ? atoi(argv[2]) : 1;
+    }
+    else if (strcmp(option, "-L") == 0) {
+        // Conta linhas que satisfazem uma expressão booleana
+        if (argc != 3) {
+            fprintf(stderr, "Uso incorreto do comando -L\n");
+            return -1;
         }
-        
-        if (response.status == 0) {
-            // Imprimir lista de IDs
-            printf("[");
-            for (int i = 0; i < response.doc_count; i++) {
-                printf("%d", response.doc_ids[i]);
-                if (i < response.doc_count - 1) {
-                    printf(", ");
-                }
+        msg->operation = OP_QUERY_LINES;
+        msg->doc_id = atoi(argv[1]);
+        strncpy(msg->query, argv[2], MAX_QUERY_SIZE - 1);
+    }
+    else if (strcmp(option, "-M") == 0) {
+        // Pesquisa documentos pelos metadados
+        if (argc == 4 && strcmp(argv[2], "--limit") == 0) {
+            if (parse_positive(argv[3], &msg->limit) < 0) {
+                fprintf(stderr, "Uso incorreto do comando -M\n");
+                return -1;
             }
-            printf("]\n");
-        } else {
-            printf("Error: %s\n", response.error_msg);
+        } else if (argc != 2) {
+            fprintf(stderr, "Uso incorreto do comando -M\n");
+            return -1;
         }
+        msg->operation = OP_META;
+        strncpy(msg->query, argv[1], MAX_QUERY_SIZE - 1);
+    }
+    else if (strcmp(option, "-A") == 0) {
+        // Adicionar os documentos de um manifesto (enviado à parte)
+        if (argc != 2) {
+            fprintf(stderr, "Uso incorreto do comando -A\n");
+            return -1;
+        }
+        msg->operation = OP_BULK_ADD;
+    }
+    else if (strcmp(option, "-S") == 0) {
+        // Estatísticas do servidor
+        if (argc != 1) {
+            fprintf(stderr, "Uso incorreto do comando -S\n");
+            return -1;
+        }
+        msg->operation = OP_STATS;
     }
     else if (strcmp(option, "-f") == 0) {
         // Desligar servidor
-        if (argc != 2) {
+        if (argc != 1) {
             fprintf(stderr, "Uso incorreto do comando -f\n");
-            show_usage(argv[0]);
-            return 1;
+            return -1;
+        }
+        msg->operation = OP_SHUTDOWN;
+    }
+    else {
+        fprintf(stderr, "Opção desconhecida: %s\n", option);
+        return -1;
+    }
+    return 0;
+}
+
+static int returns_ids(int operation) {
+    return operation == OP_SEARCH || operation == OP_QUERY || operation == OP_META;
+}
+
+static const char *operation_name(int operation) {
+    static const char *names[NUM_OPERATIONS] = {
+        NULL, "add", "consult", "delete", "lines", "search", "shutdown",
+        "query", "query-lines", "session-open", "session-close", "bulk-add", "stats", "meta"
+    };
+    return operation > 0 && operation < NUM_OPERATIONS ? names[operation] : "?";
+}
+
+static double ratio(long part, long total) {
+    return total > 0 ? 100.0 * part / total : 0.0;
+}
+
+void print_stats(const char *prefix, const ServerStats *stats) {
+    printf("%sUptime: %.1f s\n", prefix, stats->uptime_ms / 1000.0);
+    printf("%s%-14s %10s %10s %10s %10s %10s\n", prefix, "Operation", "Requests", "p50 us", "p99 us", "p99.9 us", "max us");
+    for (int op = 1; op < NUM_OPERATIONS; op++) {
+        const OpStats *s = &stats->ops[op];
+        if (s->requests > 0) {
+            printf("%s%-14s %10ld %10ld %10ld %10ld %10ld\n", prefix, operation_name(op),
+                   s->requests, s->p50_us, s->p99_us, s->p999_us, s->max_us);
+        }
+    }
+    printf("%sScanned: %ld bytes in %ld files\n", prefix, stats->bytes_scanned, stats->files_opened);
+    printf("%sDocument cache: %ld hits, %ld misses (%.1f%% hits), %ld evictions\n", prefix,
+           stats->doc_hits, stats->doc_misses, ratio(stats->doc_hits, stats->doc_hits + stats->doc_misses),
+           stats->doc_evictions);
+    printf("%sContent cache: %ld hits, %ld misses (%.1f%% hits), %ld evictions, %ld invalidations\n", prefix,
+           stats->content_hits, stats->content_misses,
+           ratio(stats->content_hits, stats->content_hits + stats->content_misses),
+           stats->content_evictions, stats->content_invalidations);
+    printf("%sSearch results cache: %ld hits, %ld misses (%.1f%% hits), %ld updates, %ld evictions\n", prefix,
+           stats->results_hits, stats->results_misses,
+           ratio(stats->results_hits, stats->results_hits + stats->results_misses),
+           stats->results_updates, stats->results_evictions);
+    printf("%sSearch workers: %d, busy %ld ms (%.1f%% utilization)\n", prefix, stats->search_workers,
+           stats->worker_busy_ms, ratio(stats->worker_busy_ms, stats->uptime_ms * stats->search_workers));
+    printf("%sMaintenance: %ld reindexed, %d missing, %ld compactions, %ld ms throttled\n", prefix,
+           stats->maint_reindexed, stats->maint_missing, stats->maint_compactions, stats->maint_throttled_ms);
+}
+
+// Imprime a resposta de um frame (todas as operações exceto pesquisas)
+void print_reply(const char *prefix, const ClientMessage *msg, const FrameHeader *header, const char *data) {
+    if (header->status != 0) {
+        printf("%sError: %.*s\n", prefix, header->length, header->type == FRAME_ERROR ? data : "");
+        return;
+    }
+    
+    int value = 0;
+    if (header->type == FRAME_VALUE && header->length == sizeof(int)) {
+        memcpy(&value, data, sizeof(int));
+    }
+    
+    switch (msg->operation) {
+        case OP_ADD:
+            printf("%sDocument %d indexed\n", prefix, value);
+            break;
+        case OP_CONSULT: {
+            Document doc;
+            memset(&doc, 0, sizeof(Document));
+            memcpy(&doc, data, header->length < (int)sizeof(Document) ? header->length : (int)sizeof(Document));
+            printf("%sTitle: %s\n", prefix, doc.title);
+            printf("%sAuthors: %s\n", prefix, doc.authors);
+            printf("%sYear: %s\n", prefix, doc.year);
+            printf("%sPath: %s\n", prefix, doc.path);
+            break;
+        }
+        case OP_DELETE:
+            printf("%sIndex entry %d deleted\n", prefix, msg->doc_id);
+            break;
+        case OP_LINES:
+        case OP_QUERY_LINES:
+            printf("%s%d\n", prefix, value);
+            break;
+        case OP_SHUTDOWN:
+            printf("%sServer is shutting down\n", prefix);
+            break;
+        case OP_STATS: {
+            ServerStats stats;
+            memset(&stats, 0, sizeof(ServerStats));
+            memcpy(&stats, data, header->length < (int)sizeof(ServerStats) ? header->length : (int)sizeof(ServerStats));
+            print_stats(prefix, &stats);
+            break;
+        }
+    }
+}
+
+void print_ids(const char *prefix, const int *ids, int count) {
+    printf("%s[", prefix);
+    for (int i = 0; i < count; i++) {
+        printf("%s%d", i > 0 ? ", " : "", ids[i]);
+    }
+    printf("]\n");
+}
+
+// ---------------------------------------------------------------------------
+// Modo sessão: vários pedidos em curso pelo mesmo par de pipes
+// ---------------------------------------------------------------------------
+
+#define MAX_IN_FLIGHT 32
+#define MAX_COMMAND_ARGS 16
+
+// Pedido enviado à espera de resposta
+typedef struct {
+    ClientMessage msg;      // msg.request_id = 0 marca uma posição livre
+    int *ids;               // IDs recebidos até agora (pesquisas)
+    int num_ids;
+    int ids_capacity;
+} InFlight;
+
+// Divide uma linha em argumentos; aspas agrupam palavras
+static int split_command(char *line, char *args[], int max_args) {
+    int count = 0;
+    char *p = line;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        if (count == max_args) {
+            return -1;
         }
         
-        msg.operation = OP_SHUTDOWN;
+        if (*p == '"') {
+            args[count++] = ++p;
+            while (*p && *p != '"') {
+                p++;
+            }
+        } else {
+            args[count++] = p;
+            while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+                p++;
+            }
+        }
+        if (*p) {
+            *p++ = '\0';
+        }
+    }
+    return count;
+}
+
+static InFlight *find_in_flight(InFlight *pending, int request_id) {
+    for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+        if (pending[i].msg.request_id == request_id) {
+            return &pending[i];
+        }
+    }
+    return NULL;
+}
+
+// Processa um frame da sessão; devolve 1 quando o pedido a que pertence ficou completo
+static int handle_frame(InFlight *pending, const FrameHeader *header, const char *data) {
+    InFlight *request = find_in_flight(pending, header->request_id);
+    if (!request || header->request_id == 0) {
+        return 0;
+    }
+    
+    char prefix[32];
+    sprintf(prefix, "%d: ", request->msg.request_id);
+    
+    if (returns_ids(request->msg.operation) && header->status == 0) {
+        if (header->type == FRAME_IDS) {
+            int count = header->length / (int)sizeof(int);
+            if (request->num_ids + count > request->ids_capacity) {
+                int capacity = (request->num_ids + count) * 2;
+                int *ids = (int*)realloc(request->ids, sizeof(int) * capacity);
+                if (!ids) {
+                    return 0;
+                }
+                request->ids = ids;
+                request->ids_capacity = capacity;
+            }
+            memcpy(request->ids + request->num_ids, data, count * sizeof(int));
+            request->num_ids += count;
+            return 0;
+        }
+        print_ids(prefix, request->ids, request->num_ids);
+    } else {
+        print_reply(prefix, &request->msg, header, data);
+    }
+    
+    free(request->ids);
+    memset(request, 0, sizeof(InFlight));
+    return 1;
+}
+
+// Lê um comando por linha da entrada padrão e envia-os todos pela mesma
+// sessão, com até MAX_IN_FLIGHT pedidos em curso. As respostas são impressas
+// à medida que ficam completas, precedidas do número da linha do comando.
+int run_session(char *client_pipe) {
+    // O servidor pode terminar a meio da sessão (ex.: comando -f)
+    signal(SIGPIPE, SIG_IGN);
+    
+    if (create_client_pipe(client_pipe) < 0) {
+        return -1;
+    }
+    int server_pipe = open(SERVER_PIPE, O_WRONLY);
+    if (server_pipe == -1) {
+        perror("Erro ao abrir pipe do servidor. O servidor está em execução?");
+        unlink(client_pipe);
+        return -1;
+    }
+    
+    // Abrir a sessão: o servidor abre o nosso pipe uma única vez
+    ClientMessage msg;
+    memset(&msg, 0, sizeof(ClientMessage));
+    msg.pid = getpid();
+    msg.operation = OP_SESSION_OPEN;
+    write(server_pipe, &msg, sizeof(ClientMessage));
+    
+    int client_fd = open(client_pipe, O_RDONLY);
+    unlink(client_pipe);
+    FrameHeader header;
+    char data[FRAME_MAX_DATA + 1];
+    if (client_fd == -1 || read_frame(client_fd, &header, data, FRAME_MAX_DATA) < 0 || header.status != 0) {
+        fprintf(stderr, "Erro ao abrir sessão\n");
+        close(server_pipe);
+        return -1;
+    }
+    
+    InFlight pending[MAX_IN_FLIGHT];
+    memset(pending, 0, sizeof(pending));
+    int in_flight = 0;
+    int line_number = 0;
+    int input_done = 0;
+    char line[MAX_QUERY_SIZE + 128];
+    
+    while (!input_done || in_flight > 0) {
+        // Enviar o comando seguinte, se há espaço para mais um pedido em curso
+        if (!input_done && in_flight < MAX_IN_FLIGHT) {
+            if (!fgets(line, sizeof(line), stdin)) {
+                input_done = 1;
+                continue;
+            }
+            line_number++;
+            
+            char *args[MAX_COMMAND_ARGS];
+            int num_args = split_command(line, args, MAX_COMMAND_ARGS);
+            if (num_args == 0) {
+                continue;
+            }
+            memset(&msg, 0, sizeof(ClientMessage));
+            if (num_args < 0 || parse_command(num_args, args, &msg) < 0) {
+                printf("%d: Error: comando inválido\n", line_number);
+                continue;
+            }
+            if (msg.operation == OP_BULK_ADD) {
+                printf("%d: Error: -A não é suportado em sessões\n", line_number);
+                continue;
+            }
+            msg.pid = getpid();
+            msg.session = 1;
+            msg.request_id = line_number;
+            
+            InFlight *slot = find_in_flight(pending, 0);
+            slot->msg = msg;
+            in_flight++;
+            write(server_pipe, &msg, sizeof(ClientMessage));
+            
+            // Recolher as respostas que já chegaram sem esperar
+            struct pollfd pfd = { client_fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 0) <= 0) {
+                continue;
+            }
+        }
         
-        if (send_receive(&msg, &response, client_pipe) < 0) {
-            return 1;
+        if (read_frame(client_fd, &header, data, FRAME_MAX_DATA) < 0) {
+            fprintf(stderr, "Sessão terminada pelo servidor\n");
+            break;
+        }
+        data[header.length] = '\0';
+        in_flight -= handle_frame(pending, &header, data);
+        fflush(stdout);
+    }
+    
+    // Fechar a sessão; o servidor fecha o pipe depois da última resposta
+    memset(&msg, 0, sizeof(ClientMessage));
+    msg.pid = getpid();
+    msg.operation = OP_SESSION_CLOSE;
+    msg.session = 1;
+    write(server_pipe, &msg, sizeof(ClientMessage));
+    while (read_frame(client_fd, &header, data, FRAME_MAX_DATA) == 0) {
+        // Confirmação do fecho
+    }
+    
+    for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+        free(pending[i].ids);
+    }
+    close(client_fd);
+    close(server_pipe);
+    return 0;
+}
+
+// Envia o manifesto ao servidor por um pipe próprio e mostra o resumo
+int run_bulk_add(ClientMessage *msg, const char *manifest, char *client_pipe) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    int input = strcmp(manifest, "-") == 0 ? STDIN_FILENO : open(manifest, O_RDONLY);
+    if (input == -1) {
+        perror("Erro ao abrir manifesto");
+        return -1;
+    }
+    
+    char upload_pipe[100];
+    sprintf(upload_pipe, "%s%d", UPLOAD_PIPE_PREFIX, getpid());
+    if (create_client_pipe(upload_pipe) < 0) {
+        return -1;
+    }
+    
+    int fd = send_request(msg, client_pipe);
+    if (fd < 0) {
+        unlink(upload_pipe);
+        return -1;
+    }
+    
+    // O servidor lê o manifesto à medida que é escrito
+    int upload_fd = open(upload_pipe, O_WRONLY);
+    unlink(upload_pipe);
+    if (upload_fd == -1) {
+        perror("Erro ao abrir pipe do manifesto");
+        close(fd);
+        return -1;
+    }
+    char buffer[64 * 1024];
+    ssize_t bytes_read;
+    while ((bytes_read = read(input, buffer, sizeof(buffer))) > 0) {
+        if (write(upload_fd, buffer, bytes_read) != bytes_read) {
+            perror("Erro ao enviar manifesto");
+            break;
+        }
+    }
+    close(upload_fd);
+    if (input != STDIN_FILENO) {
+        close(input);
+    }
+    
+    // Linhas rejeitadas e, no fim, o resumo
+    FrameHeader header;
+    char data[FRAME_MAX_DATA + 1];
+    while (read_frame(fd, &header, data, FRAME_MAX_DATA) == 0) {
+        if (header.type == FRAME_IDS) {
+            int *lines = (int*)data;
+            for (int i = 0; i < header.length / (int)sizeof(int); i++) {
+                printf("Line %d rejected\n", lines[i]);
+            }
+            continue;
+        }
+        close(fd);
+        if (header.type != FRAME_BULK || header.status != 0) {
+            data[header.length] = '\0';
+            printf("Error: %s\n", header.type == FRAME_ERROR ? data : "Resposta inválida do servidor");
+            return -1;
         }
         
-        if (response.status == 0) {
-            printf("Server is shutting down\n");
-        } else {
-            printf("Error: %s\n", response.error_msg);
+        BulkReport report;
+        memcpy(&report, data, sizeof(BulkReport));
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (report.added > 0) {
+            printf("Documents %d-%d indexed\n", report.first_id, report.last_id);
         }
+        printf("%d documents indexed, %d rejected in %.2f s (%.0f docs/s; server %ld ms)\n",
+               report.added, report.rejected, seconds,
+               seconds > 0 ? report.added / seconds : 0.0, report.elapsed_ms);
+        return 0;
     }
-    else {
-        fprintf(stderr, "Opção desconhecida: %s\n", option);
+    
+    close(fd);
+    fprintf(stderr, "Resposta incompleta do servidor\n");
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    // Verifica se há argumentos suficientes
+    if (argc < 2) {
         show_usage(argv[0]);
         return 1;
     }
     
+    // Constroi pipe do cliente
+    char client_pipe[100];
+    sprintf(client_pipe, "%s%d", CLIENT_PIPE_PREFIX, getpid());
+    
+    if (strcmp(argv[1], "-b") == 0 && argc == 2) {
+        return run_session(client_pipe) < 0 ? 1 : 0;
+    }
+    
+    // Preparar mensagem
+    ClientMessage msg;
+    memset(&msg, 0, sizeof(ClientMessage));
+    if (parse_command(argc - 1, argv + 1, &msg) < 0) {
+        show_usage(argv[0]);
+        return 1;
+    }
+    msg.pid = getpid();
+    
+    if (msg.operation == OP_BULK_ADD) {
+        return run_bulk_add(&msg, argv[2], client_pipe) < 0 ? 1 : 0;
+    }
+    
+    int fd = send_request(&msg, client_pipe);
+    if (fd < 0) {
+        return 1;
+    }
+    
+    if (returns_ids(msg.operation)) {
+        // Imprimir lista de IDs à medida que vão sendo encontrados
+        receive_ids(fd);
+    } else {
+        FrameHeader header;
+        char data[FRAME_MAX_DATA + 1];
+        int result = read_frame(fd, &header, data, FRAME_MAX_DATA);
+        close(fd);
+        if (result < 0) {
+            fprintf(stderr, "Resposta inválida do servidor\n");
+            return 1;
+        }
+        print_reply("", &msg, &header, data);
+    }
+    
     return 0;
 }
@@ -8,85 +8,226 @@
 #include <signal.h>
 // [NOVO] Adicionado header de tempo para funções time()
 #include <time.h>
-// [NOVO] Adicionado header para função waitpid() usada no processamento paralelo
-#include <sys/wait.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
 #include "common.h"
+#include "content.h"
+#include "hashmap.h"
+#include "index.h"
+#include "journal.h"
+#include "log.h"
+#include "manifest.h"
+#include "meta.h"
+#include "pattern.h"
+#include "pool.h"
+#include "protocol.h"
+#include "query.h"
+#include "results.h"
+#include "scan.h"
+#include "session.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "store.h"
+#include "uring.h"
+#include "watch.h"
 
 // Variáveis globais
 char document_folder[MAX_PATH_SIZE];
 int cache_size;
-Document *documents = NULL;  // Array de documentos
 int next_id = 1;             // Próximo ID disponível
-int num_documents = 0;       // Número atual de documentos
-// [NOVO] Array para armazenar o último acesso a cada documento (para política LRU)
-time_t *last_access = NULL;  // Para política de cache LRU
+int search_threads = -1;     // Threads de pesquisa (-1 = uma por CPU)
+int request_threads = 4;     // Threads que atendem pedidos
+int content_cache_mb = 64;   // Orçamento da cache de conteúdos (0 = desativada)
+int results_cache_mb = 8;    // Orçamento da cache de resultados de pesquisas (0 = desativada)
+int maintenance_mb = 16;     // Ritmo da manutenção em segundo plano, MB/s (0 = desativada)
+int log_level = LOG_INFO;    // Mensagens por pedido só com -v 2
+
+// Leituras (consultas, contagens, pesquisas) em paralelo; adições e remoções
+// exclusivas. Com preferência pelos escritores para não ficarem à espera
+// indefinidamente atrás de pesquisas longas.
+pthread_rwlock_t metadata_lock;
 
 // [NOVO] Declaração de funções adicionada
-int search_documents_sequential(const char *keyword, int *doc_ids, int max_results);
+int search_documents_sequential(const char *keyword, const Pattern *pattern, ResultStream *results);
 int search_for_keyword(const char *filepath, const char *keyword);
 int count_keyword_lines(const char *filepath, const char *keyword);
+static void maintenance_request_compaction();
+void maintenance_stop();
+
+// Documentos cujo ficheiro desapareceu do disco (ID -> 1), detetados pela
+// manutenção; as pesquisas não os abrem. Protegido pelo lock dos metadados.
+static IntMap missing_documents;
+static int maintenance_running = 0;
+static int index_loaded = 0;        // index_init correu bem
+static atomic_long maint_reindexed;
+static atomic_long maint_compactions;
+static atomic_long maint_throttled_ms;
+
+// Pedidos que alteram os metadados e ainda não responderam: as suas
+// alterações juntam-se no mesmo fsync do diário (journal_commit)
+static atomic_int active_writers;
+
+static int document_missing(int slot) {
+    int unused;
+    return missing_documents.count > 0 && intmap_get(&missing_documents, store_id(slot), &unused) == 0;
+}
+
+// Posições pela ordem em que são gravadas (do menos para o mais recente)
+static int *save_order = NULL;
+
+static void get_saved_document(int index, Document *doc) {
+    // Sem carregar na cache os documentos que ainda não foram pedidos
+    store_peek(save_order[index], doc);
+}
 
-// [NOVO] Função para salvar dados em disco - persistência do cache
+// Gravar um snapshot completo da cache (formato compacto, escrita atómica)
+// e esvaziar o diário, cujos registos ficam todos incluídos no snapshot
 int save_data() {
-    char data_file[MAX_PATH_SIZE];
+    char data_file[MAX_PATH_SIZE * 2];
     sprintf(data_file, "%s/.index_data", document_folder);
     
-    int fd = open(data_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd == -1) {
-        perror("Erro ao abrir arquivo de dados");
+    save_order = (int*)malloc(sizeof(int) * (store_count() + 1));
+    if (!save_order) {
+        perror("Erro ao alocar memória para snapshot");
         return -1;
     }
-    
-    // Salvar número de documentos e próximo ID
-    write(fd, &num_documents, sizeof(int));
-    write(fd, &next_id, sizeof(int));
-    
-    // Salvar documentos
-    for (int i = 0; i < num_documents; i++) {
-        write(fd, &documents[i], sizeof(Document));
+    int count = store_lru_order(save_order);
+    int result = snapshot_save(data_file, next_id, count, get_saved_document);
+    free(save_order);
+    save_order = NULL;
+    if (result < 0) {
+        return -1;
     }
     
-    close(fd);
+    // Só com o snapshot no disco, incluindo o rename, se pode esvaziar o diário
+    journal_reset();
     return 0;
 }
 
-// [NOVO] Função para carregar dados do disco - persistência do cache
+// Inserir na cache, retirando o menos recentemente usado se estiver cheia;
+// devolve o ID retirado (0 se nenhum)
+static int cache_insert(const Document *doc) {
+    int evicted_id = 0;
+    if (store_count() >= store_capacity()) {
+        int victim = store_lru();
+        Document evicted;
+        store_peek(victim, &evicted);
+        intmap_remove(&missing_documents, evicted.id);
+        index_remove_document(evicted.id);
+        results_remove_document(evicted.id);
+        meta_remove_document(&evicted);
+        store_remove(victim);
+        stats_add(STAT_DOC_EVICTIONS, 1);
+        evicted_id = evicted.id;
+    }
+    store_insert(doc);
+    meta_add_document(doc);
+    return evicted_id;
+}
+
+// Reaplicação do diário no arranque. O documento que a adição retirou da
+// cache vem num registo de remoção antes dela (os acessos não ficam no
+// diário, por isso a ordem LRU aqui não é a do servidor que parou): só um
+// diário antigo, ou uma cache mais pequena, obriga cache_insert a escolher.
+static void replay_add(const Document *doc) {
+    int slot = store_find(doc->id);
+    if (slot != -1) {
+        store_remove(slot);
+    }
+    cache_insert(doc);
+    if (doc->id >= next_id) {
+        next_id = doc->id + 1;
+    }
+}
+
+static void replay_delete(int doc_id) {
+    if (doc_id >= next_id) {
+        next_id = doc_id + 1;
+    }
+    int slot = store_find(doc_id);
+    if (slot != -1) {
+        store_remove(slot);
+    }
+}
+
+static void load_document(const Document *doc) {
+    store_insert(doc);
+}
+
+// [NOVO] Função para carregar dados do disco - snapshot seguido do diário
 int load_data() {
-    char data_file[MAX_PATH_SIZE];
+    char data_file[MAX_PATH_SIZE * 2];
     sprintf(data_file, "%s/.index_data", document_folder);
     
-    // Verificar se arquivo existe
-    if (access(data_file, F_OK) == -1) {
-        return 0; // Arquivo não existe, não é erro
+    // O snapshot fica mapeado e os documentos só são lidos quando são pedidos.
+    // Os registos estão do menos para o mais recente: se a cache encolheu,
+    // ficam os mais recentes e o último volta a ser o mais recente.
+    store_set_loader(snapshot_read_record);
+    int records = snapshot_map(data_file, &next_id);
+    if (records == SNAPSHOT_LEGACY) {
+        snapshot_load_legacy(data_file, &next_id, cache_size, load_document);
+    }
+    for (int i = records > cache_size ? records - cache_size : 0; i < records; i++) {
+        store_insert_lazy(snapshot_record_id(i), i);
     }
     
-    int fd = open(data_file, O_RDONLY);
-    if (fd == -1) {
-        perror("Erro ao abrir arquivo de dados");
+    // Recuperação: reaplicar as alterações posteriores ao snapshot
+    if (journal_open(document_folder) < 0) {
         return -1;
     }
+    journal_replay(replay_add, replay_delete);
     
-    // Carregar número de documentos e próximo ID
-    read(fd, &num_documents, sizeof(int));
-    read(fd, &next_id, sizeof(int));
-    
-    // Verificar se não excede o tamanho do cache
-    if (num_documents > cache_size) {
-        num_documents = cache_size; // Limitar ao tamanho do cache
+    // Sem o snapshot, os IDs que ele tinha podiam voltar a ser dados: o
+    // cabeçalho, o diário e o índice invertido dizem até onde já se chegou
+    if (records == SNAPSHOT_INVALID) {
+        int max_id = index_max_doc_id();
+        if (max_id >= next_id) {
+            next_id = max_id + 1;
+        }
+        fprintf(stderr, "Metadados do snapshot perdidos, novos IDs a partir de %d\n", next_id);
     }
+    return 0;
+}
+
+static int is_cached(int doc_id) {
+    return store_find(doc_id) != -1;
+}
+
+// Remover do índice documentos que já não estão em cache e, com
+// 'index_missing', indexar já os que faltam. Normalmente isso fica para a
+// thread de manutenção (maintenance_index_missing): ler todos os ficheiros
+// antes de aceitar pedidos tornaria o arranque proporcional ao corpus, e até
+// lá as pesquisas percorrem os ficheiros destes documentos.
+void sync_index(int index_missing) {
+    index_retain(is_cached);
     
-    // Carregar documentos
-    for (int i = 0; i < num_documents; i++) {
-        read(fd, &documents[i], sizeof(Document));
-        last_access[i] = time(NULL); // Inicializar timestamps
+    for (int i = 0; index_missing && i < store_count(); i++) {
+        if (!index_has_document(store_id(i))) {
+            Document *doc = store_get(i);
+            char full_path[MAX_PATH_SIZE * 2];
+            sprintf(full_path, "%s/%s", document_folder, doc->path);
+            index_add_document(doc->id, full_path);
+        }
     }
-    
-    close(fd);
-    return 0;
 }
 
 // Função para inicializar o servidor
 int initialize_server() {
+    stats_init();
+    
+    pthread_rwlockattr_t lock_attr;
+    pthread_rwlockattr_init(&lock_attr);
+#ifdef __linux__
+    pthread_rwlockattr_setkind_np(&lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&metadata_lock, &lock_attr);
+    pthread_rwlockattr_destroy(&lock_attr);
+    if (intmap_init(&missing_documents, 16) < 0) {
+        perror("Erro ao alocar memória para documentos");
+        return -1;
+    }
+    
     // Remover pipe do servidor se já existir
     unlink(SERVER_PIPE);
     
@@ -96,25 +237,26 @@ int initialize_server() {
         return -1;
     }
     
-    // Alocar memória para documentos
-    documents = (Document*)malloc(sizeof(Document) * cache_size);
-    if (!documents) {
+    // Alocar a cache de documentos (tabela por ID + lista LRU)
+    if (store_init(cache_size) < 0) {
         // [MODIFICADO] Mensagem de erro mais específica
         perror("Erro ao alocar memória para documentos");
         return -1;
     }
     
-    // [NOVO] Alocação de memória para os timestamps de último acesso
-    last_access = (time_t*)malloc(sizeof(time_t) * cache_size);
-    if (!last_access) {
-        perror("Erro ao alocar memória para timestamps");
-        free(documents);
-        return -1;
+    // Cache do conteúdo dos ficheiros, à parte da cache de metadados
+    if (content_init((size_t)content_cache_mb * 1024 * 1024) < 0) {
+        fprintf(stderr, "Erro ao criar a cache de conteúdos, ficheiros vão ser sempre lidos do disco\n");
+    }
+    if (results_init((size_t)results_cache_mb * 1024 * 1024) < 0) {
+        fprintf(stderr, "Erro ao criar a cache de resultados, pesquisas não vão ser guardadas\n");
     }
     
-    // [NOVO] Inicialização dos timestamps
-    for (int i = 0; i < cache_size; i++) {
-        last_access[i] = 0;
+    // Carregar o índice invertido antes do diário: reaplicar adições com a
+    // cache cheia retira documentos, também do índice
+    index_loaded = index_init(document_folder) == 0;
+    if (!index_loaded) {
+        fprintf(stderr, "Erro ao carregar o índice, pesquisas vão percorrer os ficheiros\n");
     }
     
     // [NOVO] Carregar dados do disco ao iniciar
@@ -123,49 +265,90 @@ int initialize_server() {
         // Continuar mesmo com erro
     }
     
+    // Alinhar o índice com os documentos em cache (sem manutenção em segundo
+    // plano, ninguém indexaria depois os que faltam)
+    if (index_loaded) {
+        sync_index(maintenance_mb <= 0);
+    }
+    
+    // Criar as threads de pesquisa uma única vez
+    if (pool_start(search_threads) < 0) {
+        perror("Erro ao criar threads de pesquisa");
+        return -1;
+    }
+    
     // [MODIFICADO] Mensagem ligeiramente diferente
-    printf("Servidor iniciado. Aguardando conexões...\n");
+    log_info("Servidor iniciado. Aguardando conexões...\n");
     return 0;
 }
 
 // Limpar recursos ao encerrar
 void cleanup() {
+    // A manutenção usa a cache, o índice e o diário: termina primeiro
+    maintenance_stop();
+    
+    // Terminar as threads de pesquisa antes de libertar a cache
+    pool_stop();
+    
     // [NOVO] Salvar dados antes de encerrar
     save_data();
+    journal_close();
+    index_close();
+    meta_free();
+    store_free();
+    intmap_free(&missing_documents);
+    snapshot_unmap();
     
-    if (documents != NULL) {
-        free(documents);
-        documents = NULL;
+    if (content_enabled()) {
+        ContentStats stats;
+        content_stats(&stats);
+        log_info("Cache de conteúdos: %ld acertos, %ld falhas, %ld ignorados, %ld invalidações, %ld substituições\n",
+               stats.hits, stats.misses, stats.bypasses, stats.invalidations, stats.evictions);
     }
+    content_free();
     
-    // [NOVO] Liberar memória dos timestamps
-    if (last_access != NULL) {
-        free(last_access);
-        last_access = NULL;
+    if (results_enabled()) {
+        ResultsStats stats;
+        results_stats(&stats);
+        log_info("Cache de resultados: %ld acertos, %ld falhas, %ld atualizações, %ld invalidações, %ld substituições\n",
+               stats.hits, stats.misses, stats.updates, stats.invalidations, stats.evictions);
     }
+    results_free();
     
     unlink(SERVER_PIPE);
-    printf("Servidor encerrado.\n");
-}
-
-// [NOVO] Funções para implementar a política de cache LRU (Least Recently Used)
-void update_access(int index) {
-    last_access[index] = time(NULL);
+    log_info("Servidor encerrado.\n");
 }
 
-// [NOVO] Função para encontrar o documento menos recentemente usado
-int find_lru_index() {
-    time_t oldest = time(NULL);
-    int oldest_index = 0;
-    
-    for (int i = 0; i < num_documents; i++) {
-        if (last_access[i] < oldest) {
-            oldest = last_access[i];
-            oldest_index = i;
+// Gravar novo snapshot quando o diário cresce: pela thread de manutenção,
+// fora do pedido, ou aqui se a manutenção está desativada
+static void compact_journal(int append_failed) {
+    if (append_failed) {
+        save_data();
+    } else if (journal_records() >= JOURNAL_COMPACT_RECORDS) {
+        if (maintenance_running) {
+            maintenance_request_compaction();
+        } else {
+            save_data();
         }
     }
-    
-    return oldest_index;
+}
+
+// Acrescentar a alteração ao diário, precedida da remoção do documento que
+// saiu da cache para lhe dar lugar (evicted_id, 0 se nenhum)
+static void persist_add(const Document *doc, int evicted_id) {
+    int failed = evicted_id > 0 && journal_append_delete(evicted_id) < 0;
+    compact_journal(failed || journal_append_add(doc) < 0);
+}
+
+static void persist_delete(int doc_id) {
+    compact_journal(journal_append_delete(doc_id) < 0);
+}
+
+// O documento novo (ou alterado) contém a palavra-chave? Chamada fora dos
+// locks, para a cache de resultados: percorre o ficheiro, não o índice
+static int new_document_contains(const char *keyword, void *arg) {
+    int result = scan_file_contains((const char*)arg, keyword);
+    return result < 0 ? -1 : result;
 }
 
 // Adicionar um documento
@@ -182,7 +365,6 @@ int add_document(ClientMessage *msg) {
     
     // Criar novo documento
     Document doc;
-    doc.id = next_id++;
     strncpy(doc.title, msg->title, MAX_TITLE_SIZE - 1);
     doc.title[MAX_TITLE_SIZE - 1] = '\0';
     strncpy(doc.authors, msg->authors, MAX_AUTHORS_SIZE - 1);
@@ -192,425 +374,1753 @@ int add_document(ClientMessage *msg) {
     strncpy(doc.path, msg->path, MAX_PATH_SIZE - 1);
     doc.path[MAX_PATH_SIZE - 1] = '\0';
     
+    // Tokenizar fora do lock: é a parte cara e não toca no estado partilhado
+    // (se falhar, as pesquisas percorrem o ficheiro)
+    DocTerms *terms = index_tokenize_file(full_path);
+    ResultsCheck *check = results_check_document(new_document_contains, full_path);
+    
+    pthread_rwlock_wrlock(&metadata_lock);
+    doc.id = next_id++;
+    
+    // Antes de cache_insert: retirar um documento muda a geração da coleção
+    results_add_document(doc.id, check);
+    
     // [NOVO] Implementação da política LRU para o cache
-    int index;
-    if (num_documents < cache_size) {
-        // Ainda há espaço no cache
-        index = num_documents++;
-        documents[index] = doc;
-    } else {
-        // Cache cheio, usar política LRU
-        index = find_lru_index();
-        documents[index] = doc;
+    int evicted_id = cache_insert(&doc);
+    if (terms) {
+        index_insert(doc.id, terms);
     }
     
-    // [NOVO] Atualizar timestamp de acesso
-    update_access(index);
-    
-    // [NOVO] Persistir dados em disco
-    save_data();
+    // [NOVO] Persistir a alteração no diário
+    persist_add(&doc, evicted_id);
+    pthread_rwlock_unlock(&metadata_lock);
     
+    watch_add_path(doc.path);
     return doc.id;
 }
 
-// Consultar um documento
-int consult_document(int doc_id, Document *doc) {
-    for (int i = 0; i < num_documents; i++) {
-        if (documents[i].id == doc_id) {
-            *doc = documents[i];
-            // [NOVO] Atualizar timestamp de acesso
-            update_access(i);
-            return 0;
+// Adição em massa: o manifesto é lido em blocos de BULK_CHUNK documentos
+#define BULK_CHUNK 1024
+
+typedef struct {
+    Document docs[BULK_CHUNK];
+    int lines[BULK_CHUNK];          // Linha de cada documento no manifesto
+    DocTerms *terms[BULK_CHUNK];
+    char valid[BULK_CHUNK];
+} BulkChunk;
+
+// Validar o caminho e tokenizar o ficheiro (em paralelo, sem locks)
+static void bulk_validate_task(int i, void *arg) {
+    BulkChunk *chunk = (BulkChunk*)arg;
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, chunk->docs[i].path);
+    
+    struct stat st;
+    chunk->valid[i] = stat(full_path, &st) == 0 && S_ISREG(st.st_mode);
+    chunk->terms[i] = chunk->valid[i] ? index_tokenize_file(full_path) : NULL;
+}
+
+static int add_rejected(int **lines, int *count, int *capacity, int line) {
+    if (*count == *capacity) {
+        int new_capacity = *capacity > 0 ? *capacity * 2 : 256;
+        int *grown = (int*)realloc(*lines, sizeof(int) * new_capacity);
+        if (!grown) {
+            return -1;
         }
+        *lines = grown;
+        *capacity = new_capacity;
     }
-    return -1; // Documento não encontrado
+    (*lines)[(*count)++] = line;
+    return 0;
 }
 
-// Remover um documento
-int delete_document(int doc_id) {
-    for (int i = 0; i < num_documents; i++) {
-        if (documents[i].id == doc_id) {
-            // Mover o último documento para a posição do documento removido
-            if (i < num_documents - 1) {
-                documents[i] = documents[num_documents - 1];
-                // [NOVO] Atualizar timestamp
-                last_access[i] = last_access[num_documents - 1];
-            }
-            num_documents--;
-            
-            // [NOVO] Persistir dados em disco
-            save_data();
-            return 0;
+// Inserir um bloco validado; os IDs do bloco são atribuídos com um único lock
+static void bulk_insert_chunk(BulkChunk *chunk, int n, BulkReport *report,
+                              int **rejected, int *num_rejected, int *capacity) {
+    pool_run(n, search_threads, bulk_validate_task, chunk);
+    
+    pthread_rwlock_wrlock(&metadata_lock);
+    for (int i = 0; i < n; i++) {
+        if (!chunk->valid[i]) {
+            add_rejected(rejected, num_rejected, capacity, chunk->lines[i]);
+            continue;
+        }
+        chunk->docs[i].id = next_id++;
+        cache_insert(&chunk->docs[i]);
+        if (chunk->terms[i]) {
+            index_insert(chunk->docs[i].id, chunk->terms[i]);
         }
+        watch_add_path(chunk->docs[i].path);
+        if (report->added++ == 0) {
+            report->first_id = chunk->docs[i].id;
+        }
+        report->last_id = chunk->docs[i].id;
     }
-    return -1; // Documento não encontrado
+    // Verificar cada documento contra cada pesquisa em cache custaria mais do
+    // que repetir as pesquisas
+    results_invalidate();
+    pthread_rwlock_unlock(&metadata_lock);
 }
 
-// [CORRIGIDO] Função para verificar se uma linha contém uma palavra-chave
-int line_contains_keyword(const char *line, const char *keyword) {
-    char *pos = strstr(line, keyword);
-    return (pos != NULL);
+// Adicionar todos os documentos do manifesto lido de 'fd'. Em vez de um
+// registo no diário por documento, grava um único snapshot no fim.
+// 'rejected' recebe os números das linhas rejeitadas (a libertar por quem chama).
+int add_documents_bulk(int fd, BulkReport *report, int **rejected) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(report, 0, sizeof(BulkReport));
+    *rejected = NULL;
+    int capacity = 0;
+    
+    ManifestReader reader;
+    BulkChunk *chunk = (BulkChunk*)malloc(sizeof(BulkChunk));
+    if (!chunk || manifest_open(&reader, fd) < 0) {
+        free(chunk);
+        return -1;
+    }
+    
+    int n = 0;
+    int line, result;
+    while ((result = manifest_next(&reader, &chunk->docs[n], &line)) >= 0) {
+        if (result == 0) {
+            add_rejected(rejected, &report->rejected, &capacity, line);
+            continue;
+        }
+        chunk->lines[n++] = line;
+        if (n == BULK_CHUNK) {
+            bulk_insert_chunk(chunk, n, report, rejected, &report->rejected, &capacity);
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        bulk_insert_chunk(chunk, n, report, rejected, &report->rejected, &capacity);
+    }
+    manifest_close(&reader);
+    free(chunk);
+    
+    // Persistir tudo de uma vez
+    if (report->added > 0) {
+        pthread_rwlock_wrlock(&metadata_lock);
+        save_data();
+        pthread_rwlock_unlock(&metadata_lock);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    report->elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    return 0;
 }
 
-// [CORRIGIDO] Nova função para contar linhas que contêm uma palavra-chave
-int count_keyword_lines(const char *filepath, const char *keyword) {
-    int fd = open(filepath, O_RDONLY);
-    if (fd == -1) {
-        return -2; // Erro ao abrir arquivo
-    }
-    
-    char buffer[4096];
-    char line[1024];
-    int line_count = 0;
-    int line_pos = 0;
-    int bytes_read;
-    
-    while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
-        for (int i = 0; i < bytes_read; i++) {
-            // Construir a linha caractere por caractere
-            if (buffer[i] != '\n' && line_pos < 1023) {
-                line[line_pos++] = buffer[i];
-            } else {
-                line[line_pos] = '\0'; // Finalizar a linha
-                
-                // Verificar se a linha contém a palavra-chave
-                if (line_contains_keyword(line, keyword)) {
-                    line_count++;
-                }
-                
-                // Reiniciar para a próxima linha
-                line_pos = 0;
-            }
-        }
+// Obter uma cópia do documento e marcá-lo como o mais recente (com o lock já obtido)
+static int lookup_document(int doc_id, Document *doc) {
+    int slot = store_find(doc_id);
+    if (slot == -1) {
+        stats_add(STAT_DOC_MISSES, 1);
+        return -1; // Documento não encontrado
     }
+    stats_add(STAT_DOC_HITS, 1);
     
-    // Verificar a última linha se não terminar com \n
-    if (line_pos > 0) {
-        line[line_pos] = '\0';
-        if (line_contains_keyword(line, keyword)) {
-            line_count++;
-        }
+    *doc = *store_get(slot);
+    // [NOVO] Atualizar acesso (passa a ser o mais recente)
+    store_touch(slot);
+    return 0;
+}
+
+// Consultar um documento
+int consult_document(int doc_id, Document *doc) {
+    pthread_rwlock_rdlock(&metadata_lock);
+    int result = lookup_document(doc_id, doc);
+    pthread_rwlock_unlock(&metadata_lock);
+    return result;
+}
+
+// Remover um documento
+int delete_document(int doc_id) {
+    pthread_rwlock_wrlock(&metadata_lock);
+    int slot = store_find(doc_id);
+    if (slot == -1) {
+        pthread_rwlock_unlock(&metadata_lock);
+        return -1; // Documento não encontrado
     }
     
-    close(fd);
-    return line_count;
+    // O último documento passa a ocupar a posição do documento removido
+    Document doc;
+    store_peek(slot, &doc);
+    meta_remove_document(&doc);
+    store_remove(slot);
+    intmap_remove(&missing_documents, doc_id);
+    index_remove_document(doc_id);
+    results_remove_document(doc_id);
+    
+    // [NOVO] Persistir a alteração no diário
+    persist_delete(doc_id);
+    pthread_rwlock_unlock(&metadata_lock);
+    return 0;
+}
+
+// Contar linhas que contêm uma palavra-chave, procurando as ocorrências
+// diretamente nos blocos lidos (sem limite de comprimento de linha)
+int count_keyword_lines(const char *filepath, const char *keyword) {
+    return scan_file_count_lines(filepath, keyword);
 }
 
 // [CORRIGIDO] Contar linhas com uma palavra-chave
 int count_lines(int doc_id, const char *keyword) {
     Document doc;
-    if (consult_document(doc_id, &doc) != 0) {
+    pthread_rwlock_rdlock(&metadata_lock);
+    if (lookup_document(doc_id, &doc) != 0) {
+        pthread_rwlock_unlock(&metadata_lock);
         return -1; // Documento não encontrado
     }
     
+    // Responder pelo índice: diretamente se a palavra-chave é um termo, ou
+    // com a lista de linhas candidatas se tem separadores
+    LineRanges candidates;
+    int line_count = index_count_lines(doc_id, keyword, &candidates);
+    pthread_rwlock_unlock(&metadata_lock);
+    if (line_count >= 0) {
+        return line_count;
+    }
+    
+    // Percorrer o ficheiro sem o lock (já temos uma cópia do caminho)
     // Construir caminho completo
     char full_path[MAX_PATH_SIZE * 2];
     sprintf(full_path, "%s/%s", document_folder, doc.path);
     
+    if (line_count == INDEX_VERIFY) {
+        return index_verify_lines(full_path, keyword, &candidates);
+    }
     // Usar nossa nova função para contar linhas
     return count_keyword_lines(full_path, keyword);
 }
 
 // [CORRIGIDO] Função para verificar se um arquivo contém uma palavra-chave
+// (inclui ocorrências que atravessam a fronteira entre blocos)
 int search_for_keyword(const char *filepath, const char *keyword) {
-    int fd = open(filepath, O_RDONLY);
-    if (fd == -1) {
+    int result = scan_file_contains(filepath, keyword);
+    if (result < 0) {
         perror("Erro ao abrir arquivo para busca");
         return 0; // Arquivo não existe ou erro
     }
-    
-    char buffer[4096];
-    int bytes_read;
-    int result = 0;
-    
-    while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
-        // Garantir que o buffer termine com \0 para usar strstr
-        char temp_buffer[4097];
-        memcpy(temp_buffer, buffer, bytes_read);
-        temp_buffer[bytes_read] = '\0';
-        
-        if (strstr(temp_buffer, keyword) != NULL) {
-            result = 1;
-            break;
-        }
+    return result;
+}
+
+// Verificar um documento pela palavra-chave exata ou, se há, pelo padrão compilado
+static int document_matches(const char *filepath, const char *keyword, const Pattern *pattern) {
+    if (!pattern) {
+        return search_for_keyword(filepath, keyword);
+    }
+    int result = pattern_match_file(pattern, filepath);
+    if (result < 0) {
+        perror("Erro ao abrir arquivo para busca");
+        return 0;
     }
-    
-    close(fd);
     return result;
 }
 
+// Varrimento das posições slots[0, n) da cache pela palavra-chave exata
+typedef struct {
+    const int *slots;
+    char (*paths)[MAX_PATH_SIZE * 2];
+    ResultStream *results;
+} DocumentScan;
+
+static int document_scanned(int i, int result, void *arg) {
+    DocumentScan *scan = (DocumentScan*)arg;
+    if (result < 0) {
+        perror("Erro ao abrir arquivo para busca");
+    } else if (result > 0) {
+        stream_add(scan->results, store_id(scan->slots[i]));
+    }
+    return stream_full(scan->results);
+}
+
+// Com -m uring os ficheiros são lidos com muitas leituras em curso ao mesmo
+// tempo e os resultados chegam pela ordem em que os ficheiros terminam
+static void scan_documents(const int *slots, int n, const char *keyword, ResultStream *results) {
+    DocumentScan scan;
+    scan.slots = slots;
+    scan.results = results;
+    scan.paths = (char (*)[MAX_PATH_SIZE * 2])malloc(sizeof(*scan.paths) * (n > 0 ? n : 1));
+    const char **paths = (const char**)malloc(sizeof(char*) * (n > 0 ? n : 1));
+    if (!scan.paths || !paths) {
+        // Sem memória para a lista: um documento de cada vez
+        for (int i = 0; i < n && !stream_full(results); i++) {
+            char full_path[MAX_PATH_SIZE * 2];
+            sprintf(full_path, "%s/%s", document_folder, store_get(slots[i])->path);
+            if (search_for_keyword(full_path, keyword)) {
+                stream_add(results, store_id(slots[i]));
+            }
+        }
+        free(scan.paths);
+        free(paths);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        sprintf(scan.paths[i], "%s/%s", document_folder, store_get(slots[i])->path);
+        paths[i] = scan.paths[i];
+    }
+    if (!stream_full(results)) {
+        scan_files_contains(paths, n, keyword, document_scanned, &scan);
+    }
+    free(paths);
+    free(scan.paths);
+}
+
 // [CORRIGIDO] Função de pesquisa sequencial - substitui a versão que usava system()
-int search_documents_sequential(const char *keyword, int *doc_ids, int max_results) {
-    int count = 0;
+int search_documents_sequential(const char *keyword, const Pattern *pattern, ResultStream *results) {
+    int num_documents = store_count();
+    
+    if (!pattern) {
+        int *slots = (int*)malloc(sizeof(int) * (num_documents > 0 ? num_documents : 1));
+        if (slots) {
+            int n = 0;
+            for (int i = 0; i < num_documents; i++) {
+                if (!document_missing(i)) {
+                    slots[n++] = i;
+                }
+            }
+            scan_documents(slots, n, keyword, results);
+            free(slots);
+            return 0;
+        }
+    }
     
-    for (int i = 0; i < num_documents && count < max_results; i++) {
+    for (int i = 0; i < num_documents && !stream_full(results); i++) {
+        if (document_missing(i)) {
+            continue;
+        }
         // Construir caminho completo
         char full_path[MAX_PATH_SIZE * 2];
-        sprintf(full_path, "%s/%s", document_folder, documents[i].path);
+        sprintf(full_path, "%s/%s", document_folder, store_get(i)->path);
         
         // Usar nossa própria função de busca
-        if (search_for_keyword(full_path, keyword)) {
+        if (document_matches(full_path, keyword, pattern)) {
             // Palavra-chave encontrada
-            doc_ids[count++] = documents[i].id;
+            stream_add(results, store_id(i));
         }
     }
     
-    return count;
+    return 0;
 }
 
-// [CORRIGIDO] Implementação de pesquisa paralela com múltiplos processos
-int search_documents(const char *keyword, int *doc_ids, int max_results, int nr_processes) {
-    // Se nr_processes for 1 ou menos, usar método sequencial
-    if (nr_processes <= 1) {
-        return search_documents_sequential(keyword, doc_ids, max_results);
+// Pesquisa pelo índice invertido; só percorre os documentos que não foram indexados
+int search_documents_indexed(const char *keyword, ResultStream *results) {
+    int max_results = index_num_documents();
+    int *doc_ids = (int*)malloc(sizeof(int) * (max_results + 1));
+    if (!doc_ids) {
+        return -1;
+    }
+    int count = index_search(keyword, doc_ids, max_results + 1);
+    if (count < 0) {
+        free(doc_ids);
+        return -1;
+    }
+    for (int i = 0; i < count && !stream_full(results); i++) {
+        stream_add(results, doc_ids[i]);
     }
+    free(doc_ids);
     
-    int count = 0;
-    int pipes[nr_processes][2];
-    pid_t pids[nr_processes];
+    int num_documents = store_count();
+    if (index_num_documents() < num_documents) {
+        int *slots = (int*)malloc(sizeof(int) * num_documents);
+        if (!slots) {
+            return 0;
+        }
+        int n = 0;
+        for (int i = 0; i < num_documents; i++) {
+            if (!index_has_document(store_id(i)) && !document_missing(i)) {
+                slots[n++] = i;
+            }
+        }
+        scan_documents(slots, n, keyword, results);
+        free(slots);
+    }
     
-    // Limitar número de processos ao número de documentos
-    if (nr_processes > num_documents) {
-        nr_processes = num_documents;
+    return 0;
+}
+
+// Ficheiros maiores que SEARCH_SPLIT_SIZE são divididos em partes de
+// SEARCH_PART_SIZE bytes, pesquisadas por threads diferentes
+#define SEARCH_SPLIT_SIZE (16 * 1024 * 1024)
+#define SEARCH_PART_SIZE (4 * 1024 * 1024)
+
+// Uma tarefa de pesquisa: um ficheiro inteiro ou um intervalo de um ficheiro grande
+typedef struct {
+    int slot;
+    off_t start;
+    off_t end;          // 0 = ficheiro inteiro
+    off_t size;         // Bytes a percorrer (para ordenar as tarefas)
+} SearchPart;
+
+// Estado partilhado por uma pesquisa paralela
+typedef struct {
+    const char *keyword;
+    const Pattern *pattern; // NULL = palavra-chave exata
+    ResultStream *results;
+    SearchPart *parts;
+    atomic_int *found;  // Por posição na cache: alguma parte já encontrou a palavra-chave
+} SearchJob;
+
+// Tarefa executada pelas threads de pesquisa; cada documento encontrado
+// segue logo para o cliente
+static void search_task(int i, void *arg) {
+    SearchJob *job = (SearchJob*)arg;
+    SearchPart *part = &job->parts[i];
+    if (stream_full(job->results)) {
+        return; // Já há resultados suficientes: as tarefas restantes terminam logo
     }
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, store_get(part->slot)->path);
     
-    // Criar pipes para comunicação
-    for (int i = 0; i < nr_processes; i++) {
-        if (pipe(pipes[i]) == -1) {
-            perror("Erro ao criar pipe");
-            return -1;
+    if (part->end == 0) {
+        if (document_matches(full_path, job->keyword, job->pattern)) {
+            stream_add(job->results, store_id(part->slot));
         }
+        return;
     }
     
-    // Dividir documentos entre processos
-    int docs_per_process = (num_documents + nr_processes - 1) / nr_processes;
+    // Só a primeira parte que encontra envia o documento
+    atomic_int *found = &job->found[part->slot];
+    if (scan_range_contains(full_path, part->start, part->end, job->keyword, found) > 0 &&
+        atomic_exchange(found, 1) == 0) {
+        stream_add(job->results, store_id(part->slot));
+    }
+}
+
+static int compare_parts(const void *a, const void *b) {
+    off_t x = ((const SearchPart*)a)->size;
+    off_t y = ((const SearchPart*)b)->size;
+    return (x < y) - (x > y);
+}
+
+// Tarefas de uma pesquisa, das maiores para as mais pequenas: as threads vão
+// buscando a seguinte, pelo que os ficheiros grandes começam primeiro e os
+// pequenos preenchem o fim, em vez de um ficheiro enorme ficar para o fim
+// numa só thread. Os padrões não dividem ficheiros (uma ocorrência pode ocupar
+// uma linha inteira), nem os ficheiros gzip que não são BGZF. Devolve o número de tarefas, -1 se faltar memória.
+static int plan_search(const char *keyword, int split, SearchPart **parts) {
+    int num_documents = store_count();
+    int capacity = num_documents + 1;
+    int count = 0;
+    *parts = (SearchPart*)malloc(sizeof(SearchPart) * capacity);
+    if (!*parts) {
+        return -1;
+    }
     
-    // Criar processos filhos
-    for (int i = 0; i < nr_processes; i++) {
-        pids[i] = fork();
-        
-        if (pids[i] == -1) {
-            perror("Erro ao criar processo");
-            return -1;
+    for (int slot = 0; slot < num_documents; slot++) {
+        if (document_missing(slot)) {
+            continue;
         }
+        char full_path[MAX_PATH_SIZE * 2];
+        sprintf(full_path, "%s/%s", document_folder, store_get(slot)->path);
+        struct stat st;
+        off_t size = stat(full_path, &st) == 0 ? st.st_size : 0;
         
-        if (pids[i] == 0) {
-            // Código do processo filho
-            close(pipes[i][0]); // Fechar extremidade de leitura
-            
-            int start = i * docs_per_process;
-            int end = (i + 1) * docs_per_process;
-            if (end > num_documents) end = num_documents;
-            
-            int child_count = 0;
-            int child_results[end - start];
-            
-            // Pesquisar documentos alocados a este processo
-            for (int j = start; j < end; j++) {
-                char full_path[MAX_PATH_SIZE * 2];
-                sprintf(full_path, "%s/%s", document_folder, documents[j].path);
-                
-                // [CORRIGIDO] Usar função própria em vez de system()
-                if (search_for_keyword(full_path, keyword)) {
-                    child_results[child_count++] = documents[j].id;
-                }
-            }
-            
-            // Enviar resultados para o processo pai
-            write(pipes[i][1], &child_count, sizeof(int));
-            if (child_count > 0) {
-                write(pipes[i][1], child_results, sizeof(int) * child_count);
-            }
-            
-            close(pipes[i][1]);
-            exit(0);
-        } else {
-            // Processo pai
-            close(pipes[i][1]); // Fechar extremidade de escrita
+        int num_parts = 1;
+        if (split && size > SEARCH_SPLIT_SIZE && keyword[0] != '\0' && scan_file_splittable(full_path)) {
+            num_parts = (int)((size + SEARCH_PART_SIZE - 1) / SEARCH_PART_SIZE);
         }
-    }
-    
-    // Coletar resultados dos processos filhos
-    for (int i = 0; i < nr_processes; i++) {
-        int child_count;
-        read(pipes[i][0], &child_count, sizeof(int));
-        
-        if (child_count > 0) {
-            int child_results[child_count];
-            read(pipes[i][0], child_results, sizeof(int) * child_count);
-            
-            // Adicionar resultados ao array final
-            for (int j = 0; j < child_count && count < max_results; j++) {
-                doc_ids[count++] = child_results[j];
+        if (count + num_parts > capacity) {
+            capacity = (count + num_parts) * 2;
+            SearchPart *grown = (SearchPart*)realloc(*parts, sizeof(SearchPart) * capacity);
+            if (!grown) {
+                free(*parts);
+                return -1;
             }
+            *parts = grown;
         }
         
-        close(pipes[i][0]);
-        waitpid(pids[i], NULL, 0); // Aguardar término do processo filho
+        for (int p = 0; p < num_parts; p++) {
+            SearchPart *part = &(*parts)[count++];
+            part->slot = slot;
+            part->start = num_parts > 1 ? (off_t)p * SEARCH_PART_SIZE : 0;
+            part->end = num_parts > 1 ? (p == num_parts - 1 ? size : part->start + SEARCH_PART_SIZE) : 0;
+            part->size = num_parts > 1 ? part->end - part->start : size;
+        }
     }
     
+    qsort(*parts, count, sizeof(SearchPart), compare_parts);
     return count;
 }
 
-// Função principal
-int main(int argc, char *argv[]) {
-    // Verificar argumentos
-    if (argc != 3) {
-        fprintf(stderr, "Uso: %s document_folder cache_size\n", argv[0]);
-        return 1;
+static int compare_ids(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static int compare_slot_ids(const void *a, const void *b) {
+    return store_id(*(const int*)a) - store_id(*(const int*)b);
+}
+
+// Pesquisa com os resultados por ordem de ID: os documentos são verificados
+// por essa ordem, em janelas paralelas, e cada janela é enviada ordenada.
+// Com limite, a primeira janela tem o tamanho do limite e cada uma a seguir
+// o dobro da anterior, para parar sem percorrer o resto da coleção.
+typedef struct {
+    const char *keyword;
+    const Pattern *pattern;
+    const int *slots;       // Posições na cache pela ordem pedida
+    int base;               // Primeira posição de 'slots' da janela em curso
+    const int *indexed;     // IDs do índice com a palavra-chave (ordenados), ou NULL
+    int num_indexed;
+    char *matched;          // Por posição na janela
+} OrderedJob;
+
+static void ordered_task(int i, void *arg) {
+    OrderedJob *job = (OrderedJob*)arg;
+    int slot = job->slots[job->base + i];
+    int id = store_id(slot);
+    if (job->indexed && index_has_document(id)) {
+        job->matched[i] = bsearch(&id, job->indexed, job->num_indexed, sizeof(int), compare_ids) != NULL;
+        return;
+    }
+    if (document_missing(slot)) {
+        job->matched[i] = 0;
+        return;
+    }
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, store_get(slot)->path);
+    job->matched[i] = document_matches(full_path, job->keyword, job->pattern);
+}
+
+static int search_documents_ordered(const char *keyword, const Pattern *pattern, ResultStream *results,
+                                    int nr_processes, int order) {
+    int num_documents = store_count();
+    int *slots = (int*)malloc(sizeof(int) * (num_documents + 1));
+    char *matched = (char*)malloc(num_documents + 1);
+    int *indexed = NULL;
+    int num_indexed = 0;
+    if (!pattern && index_can_answer(keyword)) {
+        indexed = (int*)malloc(sizeof(int) * (index_num_documents() + 1));
+        num_indexed = indexed ? index_search(keyword, indexed, index_num_documents() + 1) : -1;
+    }
+    if (!slots || !matched || num_indexed < 0) {
+        free(slots);
+        free(matched);
+        free(indexed);
+        return -1;
     }
     
-    // Obter argumentos
-    strncpy(document_folder, argv[1], MAX_PATH_SIZE - 1);
-    document_folder[MAX_PATH_SIZE - 1] = '\0';  // Garantir terminação
-    
-    cache_size = atoi(argv[2]);
-    if (cache_size <= 0) {
-        fprintf(stderr, "Tamanho de cache inválido. Deve ser maior que zero.\n");
-        return 1;
+    for (int i = 0; i < num_documents; i++) {
+        slots[i] = i;
+    }
+    qsort(slots, num_documents, sizeof(int), compare_slot_ids);
+    if (order == ORDER_RECENT) {
+        for (int i = 0; i < num_documents / 2; i++) {
+            int tmp = slots[i];
+            slots[i] = slots[num_documents - 1 - i];
+            slots[num_documents - 1 - i] = tmp;
+        }
     }
     
-    printf("Pasta de documentos: %s\n", document_folder);
-    printf("Tamanho do cache: %d\n", cache_size);
+    OrderedJob job;
+    job.keyword = keyword;
+    job.pattern = pattern;
+    job.slots = slots;
+    job.indexed = indexed;
+    job.num_indexed = num_indexed;
+    job.matched = matched;
     
-    // Inicializar servidor
-    if (initialize_server() < 0) {
-        return 1;
+    int window = num_documents;
+    if (results->limit > 0) {
+        window = results->limit > nr_processes ? results->limit : nr_processes;
+    }
+    for (int start = 0; start < num_documents && !stream_full(results); start += window, window *= 2) {
+        int count = window < num_documents - start ? window : num_documents - start;
+        job.base = start;
+        pool_run(count, nr_processes, ordered_task, &job);
+        for (int i = 0; i < count; i++) {
+            if (matched[i]) {
+                stream_add(results, store_id(slots[start + i]));
+            }
+        }
     }
     
-    // Configurar limpeza ao encerrar
-    atexit(cleanup);
+    free(slots);
+    free(matched);
+    free(indexed);
+    return 0;
+}
+
+// [CORRIGIDO] Pesquisa paralela com o conjunto persistente de threads
+// (chamada com o lock de leitura dos metadados)
+static int search_documents_locked(const char *keyword, const Pattern *pattern, ResultStream *results,
+                                   int nr_processes, int order) {
+    if (order != ORDER_ANY && search_documents_ordered(keyword, pattern, results, nr_processes, order) == 0) {
+        return 0;
+    }
     
-    // Abrir pipe para leitura
-    int server_pipe = open(SERVER_PIPE, O_RDONLY);
-    if (server_pipe == -1) {
-        perror("Erro ao abrir pipe do servidor");
-        return 1;
+    // Palavras-chave que são termos: responder pelo índice
+    if (!pattern && index_can_answer(keyword) && search_documents_indexed(keyword, results) == 0) {
+        return 0;
     }
     
-    printf("Aguardar conexões de clientes...\n");
+    // Se nr_processes for 1 ou menos, usar método sequencial
+    int num_documents = store_count();
+    if (nr_processes <= 1 || num_documents <= 1) {
+        return search_documents_sequential(keyword, pattern, results);
+    }
+    
+    // As threads vão buscando a tarefa seguinte à medida que terminam
+    // (os resultados chegam ao cliente pela ordem em que são encontrados)
+    SearchJob job;
+    job.keyword = keyword;
+    job.pattern = pattern;
+    job.results = results;
+    job.found = (atomic_int*)calloc(num_documents, sizeof(atomic_int));
+    int num_parts = job.found ? plan_search(keyword, pattern == NULL, &job.parts) : -1;
+    if (num_parts < 0) {
+        free(job.found);
+        return search_documents_sequential(keyword, pattern, results);
+    }
+    pool_run(num_parts, nr_processes, search_task, &job);
+    free(job.parts);
+    free(job.found);
+    return 0;
+}
+
+// Pesquisas correm em paralelo entre si; só as adições/remoções as bloqueiam.
+// Palavras-chave repetidas são respondidas pela cache de resultados (só as
+// exatas: os padrões percorrem sempre os documentos).
+int search_documents(const char *keyword, const Pattern *pattern, ResultStream *results,
+                     int nr_processes, int order) {
+    pthread_rwlock_rdlock(&metadata_lock);
+    if (pattern) {
+        int result = search_documents_locked(keyword, pattern, results, nr_processes, order);
+        pthread_rwlock_unlock(&metadata_lock);
+        return result;
+    }
+    
+    int *cached;
+    int count = results_lookup(keyword, &cached);
+    if (count >= 0) {
+        pthread_rwlock_unlock(&metadata_lock);
+        // Os IDs em cache estão por ordem crescente
+        for (int i = 0; i < count && !stream_full(results); i++) {
+            stream_add(results, cached[order == ORDER_RECENT ? count - 1 - i : i]);
+        }
+        free(cached);
+        return 0;
+    }
+    
+    // Só se guarda o resultado de uma pesquisa completa (que não parou no limite)
+    unsigned long generation = results_generation();
+    int collecting = results_enabled() && stream_collect(results) == 0;
+    int result = search_documents_locked(keyword, NULL, results, nr_processes, order);
+    const int *ids;
+    if (result == 0 && collecting && !stream_full(results) && (ids = stream_collected(results, &count))) {
+        results_store(keyword, generation, ids, count);
+    }
+    pthread_rwlock_unlock(&metadata_lock);
+    return result;
+}
+
+// Pesquisa pelos metadados: os índices secundários são construídos na primeira
+// pesquisa e mantidos depois por cache_insert e delete_document
+int search_metadata(const char *expression, ResultStream *results, char *error, size_t error_size) {
+    pthread_rwlock_rdlock(&metadata_lock);
+    if (!meta_ready() && meta_build(store_count(), store_peek) < 0) {
+        pthread_rwlock_unlock(&metadata_lock);
+        snprintf(error, error_size, "Erro ao construir os índices de metadados");
+        return -1;
+    }
+    int *ids;
+    int count = meta_search(expression, &ids, error, error_size);
+    pthread_rwlock_unlock(&metadata_lock);
+    if (count < 0) {
+        return -1;
+    }
+    
+    for (int i = 0; i < count && !stream_full(results); i++) {
+        stream_add(results, ids[i]);
+    }
+    free(ids);
+    return 0;
+}
+
+// Contar linhas com ocorrências de um padrão (sem maiúsculas/minúsculas ou
+// expressão regular): o índice só guarda termos exatos, por isso percorre sempre
+// o ficheiro
+int count_pattern_lines(int doc_id, const Pattern *pattern) {
+    Document doc;
+    pthread_rwlock_rdlock(&metadata_lock);
+    int found = lookup_document(doc_id, &doc);
+    pthread_rwlock_unlock(&metadata_lock);
+    if (found != 0) {
+        return -1; // Documento não encontrado
+    }
+    
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, doc.path);
+    return pattern_count_lines(pattern, full_path);
+}
+
+// Contar linhas que satisfazem uma expressão booleana (uma passagem pelo ficheiro)
+int count_query_lines(int doc_id, const Query *query) {
+    Document doc;
+    pthread_rwlock_rdlock(&metadata_lock);
+    int found = lookup_document(doc_id, &doc);
+    pthread_rwlock_unlock(&metadata_lock);
+    if (found != 0) {
+        return -1; // Documento não encontrado
+    }
+    
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, doc.path);
+    return query_count_lines(query, full_path);
+}
+
+// Avaliar a expressão pelo índice invertido, quando todos os termos são termos
+// indexados e todos os documentos da cache estão indexados; -1 se não for possível
+static int query_documents_indexed(const Query *query, ResultStream *results) {
+    int num_documents = store_count();
+    int num_terms = query_num_terms(query);
+    if (index_num_documents() < num_documents) {
+        return -1;
+    }
+    for (int t = 0; t < num_terms; t++) {
+        if (!index_can_answer(query_term(query, t))) {
+            return -1;
+        }
+    }
+    
+    // Documentos de cada termo, ordenados por id
+    int *postings = (int*)malloc(sizeof(int) * (num_documents + 1) * num_terms);
+    int *lengths = (int*)malloc(sizeof(int) * num_terms);
+    if (!postings || !lengths) {
+        free(postings);
+        free(lengths);
+        return -1;
+    }
+    for (int t = 0; t < num_terms; t++) {
+        lengths[t] = index_search(query_term(query, t), postings + t * (num_documents + 1), num_documents + 1);
+        if (lengths[t] < 0) {
+            free(postings);
+            free(lengths);
+            return -1;
+        }
+    }
+    
+    for (int i = 0; i < num_documents; i++) {
+        int id = store_id(i);
+        uint64_t present = 0;
+        for (int t = 0; t < num_terms; t++) {
+            if (bsearch(&id, postings + t * (num_documents + 1), lengths[t], sizeof(int), compare_ids)) {
+                present |= (uint64_t)1 << t;
+            }
+        }
+        if (query_eval(query, present)) {
+            stream_add(results, id);
+        }
+    }
+    
+    free(postings);
+    free(lengths);
+    return 0;
+}
+
+typedef struct {
+    const Query *query;
+    ResultStream *results;
+} QueryJob;
+
+static void query_task(int slot, void *arg) {
+    QueryJob *job = (QueryJob*)arg;
+    if (document_missing(slot)) {
+        return;
+    }
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, store_get(slot)->path);
+    int result = query_match_file(job->query, full_path);
+    if (result < 0) {
+        perror("Erro ao abrir arquivo para busca");
+    } else if (result > 0) {
+        stream_add(job->results, store_id(slot));
+    }
+}
+
+// Documentos que satisfazem a expressão: todos os termos são procurados na
+// mesma passagem por cada ficheiro
+int query_documents(const Query *query, ResultStream *results, int nr_processes) {
+    pthread_rwlock_rdlock(&metadata_lock);
+    if (query_documents_indexed(query, results) < 0) {
+        QueryJob job;
+        job.query = query;
+        job.results = results;
+        int num_documents = store_count();
+        if (nr_processes <= 1) {
+            for (int i = 0; i < num_documents; i++) {
+                query_task(i, &job);
+            }
+        } else {
+            pool_run(num_documents, nr_processes, query_task, &job);
+        }
+    }
+    pthread_rwlock_unlock(&metadata_lock);
+    return 0;
+}
+
+// Abrir o pipe do cliente para enviar a resposta
+int open_client_pipe(pid_t pid) {
+    char client_pipe_name[100];
+    sprintf(client_pipe_name, "%s%d", CLIENT_PIPE_PREFIX, pid);
+    
+    int client_pipe = open(client_pipe_name, O_WRONLY);
+    if (client_pipe == -1) {
+        perror("Erro ao abrir pipe do cliente");
+    }
+    return client_pipe;
+}
+
+// Destino da resposta: o pipe da sessão do cliente ou, fora de sessões, o
+// pipe do cliente aberto só para este pedido; -1 se não há a quem responder
+static int reply_open(const ClientMessage *msg, ReplyChannel *channel, Session **session) {
+    *session = NULL;
+    if (msg->session || msg->operation == OP_SESSION_OPEN) {
+        *session = session_acquire(msg->pid);
+        if (!*session) {
+            fprintf(stderr, "Pedido para uma sessão que não está aberta (PID %d)\n", msg->pid);
+            return -1;
+        }
+        session_channel(*session, msg->request_id, channel);
+        return 0;
+    }
+    
+    channel->fd = open_client_pipe(msg->pid);
+    channel->request_id = msg->request_id;
+    channel->lock = NULL;
+    channel->failed = 0;
+    return channel->fd == -1 ? -1 : 0;
+}
+
+static void reply_close(const ClientMessage *msg, ReplyChannel *channel, Session *session) {
+    if (!session) {
+        close(channel->fd);
+        return;
+    }
+    // Cliente desaparecido sem fechar a sessão
+    if (channel->failed) {
+        session_close(msg->pid);
+    }
+    session_release(session);
+}
+
+static void send_error(ReplyChannel *channel, const char *error_msg) {
+    send_frame(channel, FRAME_ERROR, -1, error_msg, strlen(error_msg) + 1);
+}
+
+static void send_value(ReplyChannel *channel, int value) {
+    send_frame(channel, FRAME_VALUE, 0, &value, sizeof(int));
+}
+
+// Processar um pedido e responder ao cliente (executado pelas threads de pedidos)
+void handle_request(ClientMessage *client_msg) {
+    if (client_msg->operation == OP_SESSION_OPEN) {
+        char client_pipe_name[100];
+        sprintf(client_pipe_name, "%s%d", CLIENT_PIPE_PREFIX, client_msg->pid);
+        if (session_open(client_msg->pid, client_pipe_name) < 0) {
+            return;
+        }
+    }
+    
+    ReplyChannel channel;
+    Session *session;
+    if (reply_open(client_msg, &channel, &session) < 0) {
+        return;
+    }
+    int writer = client_msg->operation == OP_ADD || client_msg->operation == OP_DELETE ||
+                 client_msg->operation == OP_BULK_ADD;
+    if (writer) {
+        atomic_fetch_add(&active_writers, 1);
+    }
+    
+    // Processar mensagem de acordo com a operação
+    switch(client_msg->operation) {
+        case OP_ADD: {
+            log_debug("A Adicionar documento: %s\n", client_msg->title);
+            int doc_id = add_document(client_msg);
+            
+            if (doc_id > 0 && journal_commit(&active_writers) < 0) {
+                send_error(&channel, "Erro ao gravar no diário");
+            } else if (doc_id > 0) {
+                send_value(&channel, doc_id);
+            } else if (doc_id == -1) {
+                send_error(&channel, "Cache cheio");
+            } else {
+                send_error(&channel, "Arquivo não encontrado");
+            }
+            break;
+        }
+            
+        case OP_CONSULT: {
+            log_debug("Consultar documento: %d\n", client_msg->doc_id);
+            Document doc;
+            if (consult_document(client_msg->doc_id, &doc) == 0) {
+                send_frame(&channel, FRAME_DOC, 0, &doc, sizeof(Document));
+            } else {
+                send_error(&channel, "Documento não encontrado");
+            }
+            break;
+        }
+            
+        case OP_DELETE:
+            log_debug("Remover documento: %d\n", client_msg->doc_id);
+            if (delete_document(client_msg->doc_id) == 0) {
+                if (journal_commit(&active_writers) < 0) {
+                    send_error(&channel, "Erro ao gravar no diário");
+                } else {
+                    send_frame(&channel, FRAME_OK, 0, NULL, 0);
+                }
+            } else {
+                send_error(&channel, "Documento não encontrado");
+            }
+            break;
+            
+        case OP_LINES: {
+            log_debug("Contar linhas no documento %d com palavra-chave: %s\n", 
+                   client_msg->doc_id, client_msg->keyword);
+            int line_count;
+            if (client_msg->match != MATCH_EXACT) {
+                char error_msg[256];
+                Pattern *pattern = pattern_compile(client_msg->keyword, client_msg->match,
+                                                   error_msg, sizeof(error_msg));
+                if (!pattern) {
+                    send_error(&channel, error_msg);
+                    break;
+                }
+                line_count = count_pattern_lines(client_msg->doc_id, pattern);
+                pattern_free(pattern);
+            } else {
+                line_count = count_lines(client_msg->doc_id, client_msg->keyword);
+            }
+            
+            if (line_count >= 0) {
+                send_value(&channel, line_count);
+            } else if (line_count == -1) {
+                send_error(&channel, "Documento não encontrado");
+            } else {
+                send_error(&channel, "Erro ao contar linhas");
+            }
+            break;
+        }
+            
+        case OP_SEARCH: {
+            log_debug("Pesquisar documentos com palavra-chave: %s (processos: %d)\n", 
+                   client_msg->keyword, client_msg->nr_processes);
+            // O padrão é compilado uma vez e partilhado pelas threads de pesquisa
+            Pattern *pattern = NULL;
+            if (client_msg->match != MATCH_EXACT) {
+                char error_msg[256];
+                pattern = pattern_compile(client_msg->keyword, client_msg->match, error_msg, sizeof(error_msg));
+                if (!pattern) {
+                    send_error(&channel, error_msg);
+                    break;
+                }
+            }
+            
+            // Os IDs seguem para o cliente à medida que são encontrados
+            ResultStream results;
+            stream_init(&results, &channel);
+            stream_set_limit(&results, client_msg->limit);
+            search_documents(client_msg->keyword, pattern, &results, client_msg->nr_processes, client_msg->order);
+            stream_finish(&results);
+            stream_destroy(&results);
+            pattern_free(pattern);
+            break;
+        }
+            
+        case OP_QUERY:
+        case OP_QUERY_LINES: {
+            client_msg->query[MAX_QUERY_SIZE - 1] = '\0';
+            log_debug("Consulta: %s\n", client_msg->query);
+            char error_msg[256];
+            Query *query = query_compile(client_msg->query, error_msg, sizeof(error_msg));
+            if (!query) {
+                send_error(&channel, error_msg);
+                break;
+            }
+            
+            if (client_msg->operation == OP_QUERY) {
+                ResultStream results;
+                stream_init(&results, &channel);
+                query_documents(query, &results, client_msg->nr_processes);
+                stream_finish(&results);
+                stream_destroy(&results);
+            } else {
+                int line_count = count_query_lines(client_msg->doc_id, query);
+                if (line_count >= 0) {
+                    send_value(&channel, line_count);
+                } else if (line_count == -1) {
+                    send_error(&channel, "Documento não encontrado");
+                } else {
+                    send_error(&channel, "Erro ao contar linhas");
+                }
+            }
+            query_free(query);
+            break;
+        }
+            
+        case OP_BULK_ADD: {
+            char upload_pipe_name[100];
+            sprintf(upload_pipe_name, "%s%d", UPLOAD_PIPE_PREFIX, client_msg->pid);
+            int upload_fd = open(upload_pipe_name, O_RDONLY);
+            if (upload_fd == -1) {
+                perror("Erro ao abrir pipe do manifesto");
+                send_error(&channel, "Erro ao receber o manifesto");
+                break;
+            }
+            
+            BulkReport report;
+            int *rejected;
+            int result = add_documents_bulk(upload_fd, &report, &rejected);
+            close(upload_fd);
+            if (result < 0 || journal_commit(&active_writers) < 0) {
+                send_error(&channel, "Erro ao adicionar documentos");
+                free(rejected);
+                break;
+            }
+            log_debug("Adição em massa: %d documentos, %d rejeitados, %ld ms\n",
+                   report.added, report.rejected, report.elapsed_ms);
+            
+            // Linhas rejeitadas (por ordem), seguidas do resumo
+            qsort(rejected, report.rejected, sizeof(int), compare_ids);
+            for (int i = 0; i < report.rejected; i += FRAME_MAX_IDS) {
+                int count = report.rejected - i < FRAME_MAX_IDS ? report.rejected - i : FRAME_MAX_IDS;
+                send_frame(&channel, FRAME_IDS, 0, rejected + i, count * (int)sizeof(int));
+            }
+            send_frame(&channel, FRAME_BULK, 0, &report, sizeof(BulkReport));
+            free(rejected);
+            break;
+        }
+            
+        case OP_SESSION_OPEN:
+            log_debug("Sessão aberta: PID %d\n", client_msg->pid);
+            send_frame(&channel, FRAME_OK, 0, NULL, 0);
+            break;
+            
+        case OP_SESSION_CLOSE:
+            // O pipe fecha quando terminarem as respostas ainda em curso
+            log_debug("Sessão fechada: PID %d\n", client_msg->pid);
+            session_close(client_msg->pid);
+            send_frame(&channel, FRAME_OK, 0, NULL, 0);
+            break;
+            
+        case OP_META: {
+            client_msg->query[MAX_QUERY_SIZE - 1] = '\0';
+            log_debug("Pesquisa por metadados: %s\n", client_msg->query);
+            char error_msg[256];
+            ResultStream results;
+            stream_init(&results, &channel);
+            stream_set_limit(&results, client_msg->limit);
+            if (search_metadata(client_msg->query, &results, error_msg, sizeof(error_msg)) < 0) {
+                send_error(&channel, error_msg);
+            } else {
+                stream_finish(&results);
+            }
+            stream_destroy(&results);
+            break;
+        }
+            
+        case OP_STATS: {
+            ServerStats stats;
+            stats_collect(&stats);
+            
+            ContentStats content;
+            content_stats(&content);
+            stats.content_hits = content.hits;
+            stats.content_misses = content.misses;
+            stats.content_evictions = content.evictions;
+            stats.content_invalidations = content.invalidations;
+            ResultsStats cached;
+            results_stats(&cached);
+            stats.results_hits = cached.hits;
+            stats.results_misses = cached.misses;
+            stats.results_updates = cached.updates;
+            stats.results_evictions = cached.evictions + cached.invalidations;
+            stats.search_workers = pool_size();
+            stats.worker_busy_ms = pool_busy_ms();
+            stats.maint_reindexed = atomic_load(&maint_reindexed);
+            stats.maint_compactions = atomic_load(&maint_compactions);
+            stats.maint_throttled_ms = atomic_load(&maint_throttled_ms);
+            pthread_rwlock_rdlock(&metadata_lock);
+            stats.maint_missing = missing_documents.count;
+            pthread_rwlock_unlock(&metadata_lock);
+            
+            send_frame(&channel, FRAME_STATS, 0, &stats, sizeof(ServerStats));
+            break;
+        }
+            
+        default:
+            log_debug("Operação não reconhecida\n");
+            send_error(&channel, "Operação não reconhecida");
+            break;
+    }
+    
+    if (writer) {
+        atomic_fetch_sub(&active_writers, 1);
+    }
+    reply_close(client_msg, &channel, session);
+}
+
+// Fila de pedidos entre a thread que lê o pipe e as threads de pedidos
+typedef struct PendingRequest {
+    ClientMessage msg;
+    struct timespec received;   // Chegada ao servidor, para a latência
+    struct PendingRequest *next;
+} PendingRequest;
+
+static PendingRequest *requests_head = NULL;
+static PendingRequest *requests_tail = NULL;
+static pthread_mutex_t requests_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t requests_available = PTHREAD_COND_INITIALIZER;
+static int dispatcher_stopping = 0;
+static pthread_t *dispatcher_threads = NULL;
+static int num_dispatcher_threads = 0;
+static atomic_int active_requests;  // Em curso, para a manutenção lhes dar prioridade
+
+// Atender o pedido e registar a latência desde que chegou ao servidor
+static void serve_request(ClientMessage *msg, const struct timespec *received) {
+    atomic_fetch_add(&active_requests, 1);
+    handle_request(msg);
+    atomic_fetch_sub(&active_requests, 1);
+    
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    stats_record(msg->operation, (now.tv_sec - received->tv_sec) * 1000000L + (now.tv_nsec - received->tv_nsec) / 1000);
+}
+
+static void *request_thread_main(void *unused) {
+    (void)unused;
+    while (1) {
+        pthread_mutex_lock(&requests_mutex);
+        while (!requests_head && !dispatcher_stopping) {
+            pthread_cond_wait(&requests_available, &requests_mutex);
+        }
+        PendingRequest *request = requests_head;
+        if (!request) {
+            // A terminar e sem pedidos pendentes
+            pthread_mutex_unlock(&requests_mutex);
+            break;
+        }
+        requests_head = request->next;
+        if (!requests_head) {
+            requests_tail = NULL;
+        }
+        pthread_mutex_unlock(&requests_mutex);
+        
+        serve_request(&request->msg, &request->received);
+        free(request);
+    }
+    return NULL;
+}
+
+int dispatcher_start(int num_threads) {
+    dispatcher_threads = (pthread_t*)malloc(sizeof(pthread_t) * num_threads);
+    if (!dispatcher_threads) {
+        return -1;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&dispatcher_threads[i], NULL, request_thread_main, NULL) != 0) {
+            perror("Erro ao criar thread de pedidos");
+            break;
+        }
+        num_dispatcher_threads++;
+    }
+    return num_dispatcher_threads > 0 ? 0 : -1;
+}
+
+// Atender os pedidos pendentes e terminar as threads de pedidos
+void dispatcher_stop() {
+    pthread_mutex_lock(&requests_mutex);
+    dispatcher_stopping = 1;
+    pthread_cond_broadcast(&requests_available);
+    pthread_mutex_unlock(&requests_mutex);
+    
+    for (int i = 0; i < num_dispatcher_threads; i++) {
+        pthread_join(dispatcher_threads[i], NULL);
+    }
+    free(dispatcher_threads);
+    dispatcher_threads = NULL;
+    num_dispatcher_threads = 0;
+}
+
+int dispatcher_submit(const ClientMessage *msg, const struct timespec *received) {
+    PendingRequest *request = (PendingRequest*)malloc(sizeof(PendingRequest));
+    if (!request) {
+        return -1;
+    }
+    request->msg = *msg;
+    request->received = *received;
+    request->next = NULL;
+    
+    pthread_mutex_lock(&requests_mutex);
+    if (requests_tail) {
+        requests_tail->next = request;
+    } else {
+        requests_head = request;
+    }
+    requests_tail = request;
+    pthread_cond_signal(&requests_available);
+    pthread_mutex_unlock(&requests_mutex);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Manutenção em segundo plano
+// ---------------------------------------------------------------------------
+//
+// Uma thread própria trata do que não precisa de ser feito dentro dos
+// pedidos: reindexar os documentos cujo ficheiro mudou no disco (detetados
+// com inotify), marcar os que desapareceram, gravar o snapshot quando o
+// diário cresce e verificar o checksum do snapshot mapeado no arranque. O
+// trabalho é limitado a maintenance_mb MB/s e espera que não haja pedidos em
+// curso, para não roubar latência às pesquisas.
+
+#define MAINT_SETTLE_MS 200       // Esperar que as escritas num ficheiro acalmem...
+#define MAINT_MAX_DELAY_MS 2000   // ...mas nunca mais do que isto
+#define MAINT_IDLE_WAIT_MS 1000   // Máximo à espera de que os pedidos em curso terminem
+#define MAINT_SLEEP_MS 20         // Fatia de espera (para terminar depressa)
+
+static pthread_t maintenance_thread;
+static int maintenance_pipe[2] = { -1, -1 };  // Acordar a thread: 'c' compactar, 'q' terminar
+static atomic_int maintenance_stopping;
+static atomic_int compaction_requested;
+static double maintenance_tokens = 0;         // Bytes que ainda se podem processar já
+static struct timespec maintenance_refilled;
+
+static long elapsed_since_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static void maintenance_sleep(int ms) {
+    usleep(ms * 1000);
+    atomic_fetch_add(&maint_throttled_ms, ms);
+}
+
+// Antes de processar 'bytes': ceder aos pedidos em curso e respeitar o ritmo
+// (balde de fichas com no máximo um segundo de crédito)
+static void maintenance_throttle(size_t bytes) {
+    for (int waited = 0; atomic_load(&active_requests) > 0 && waited < MAINT_IDLE_WAIT_MS &&
+         !atomic_load(&maintenance_stopping); waited += MAINT_SLEEP_MS) {
+        maintenance_sleep(MAINT_SLEEP_MS);
+    }
+    
+    double rate = (double)maintenance_mb * 1024 * 1024;  // Bytes por segundo
+    maintenance_tokens += elapsed_since_ms(&maintenance_refilled) * rate / 1000;
+    if (maintenance_tokens > rate) {
+        maintenance_tokens = rate;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &maintenance_refilled);
+    maintenance_tokens -= bytes;
+    
+    // Em dívida: esperar que o balde volte a encher
+    long wait_ms = maintenance_tokens < 0 ? (long)(-maintenance_tokens * 1000 / rate) : 0;
+    for (long waited = 0; waited < wait_ms && !atomic_load(&maintenance_stopping); waited += MAINT_SLEEP_MS) {
+        maintenance_sleep(MAINT_SLEEP_MS);
+    }
+}
+
+static void maintenance_request_compaction() {
+    if (atomic_exchange(&compaction_requested, 1) == 0) {
+        char reason = 'c';
+        write(maintenance_pipe[1], &reason, 1);
+    }
+}
+
+// O snapshot só precisa do lock de leitura: as pesquisas continuam, só as
+// adições e remoções esperam (e nenhuma pode acrescentar ao diário a meio)
+static void maintenance_compact() {
+    atomic_store(&compaction_requested, 0);
+    pthread_rwlock_rdlock(&metadata_lock);
+    if (journal_records() >= JOURNAL_COMPACT_RECORDS && save_data() == 0) {
+        atomic_fetch_add(&maint_compactions, 1);
+    }
+    pthread_rwlock_unlock(&metadata_lock);
+}
+
+// Documento a verificar: cópia do ID e do caminho, feita com o lock
+typedef struct {
+    int id;
+    char path[MAX_PATH_SIZE];
+} MaintenanceTarget;
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// Voltar a ler o ficheiro de um documento: reindexá-lo se existe, marcá-lo
+// como desaparecido se não. Com 'reindex' a 0 só trata dos desaparecidos (e
+// dos que voltaram a aparecer).
+static void maintenance_check(const MaintenanceTarget *target, int reindex) {
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, target->path);
+    
+    struct stat st;
+    if (stat(full_path, &st) == -1) {
+        if (errno != ENOENT) {
+            return;
+        }
+        int unused, marked = 0;
+        pthread_rwlock_wrlock(&metadata_lock);
+        // Sem memória para o marcar fica no índice: se saísse sem ficar
+        // marcado, nunca seria reindexado quando o ficheiro voltasse
+        if (store_find(target->id) != -1 && intmap_get(&missing_documents, target->id, &unused) < 0 &&
+            intmap_put(&missing_documents, target->id, 1) == 0) {
+            index_remove_document(target->id);
+            results_remove_document(target->id);
+            marked = 1;
+        }
+        pthread_rwlock_unlock(&metadata_lock);
+        if (marked) {
+            log_info("Documento %d: ficheiro %s desapareceu\n", target->id, target->path);
+        }
+        return;
+    }
+    
+    int unused;
+    pthread_rwlock_rdlock(&metadata_lock);
+    int was_missing = intmap_get(&missing_documents, target->id, &unused) == 0;
+    pthread_rwlock_unlock(&metadata_lock);
+    if (!reindex && !was_missing) {
+        return;
+    }
+    
+    // Tokenizar fora do lock, ao ritmo da manutenção
+    maintenance_throttle(st.st_size);
+    DocTerms *terms = index_tokenize_file(full_path);
+    ResultsCheck *check = results_check_document(new_document_contains, full_path);
+    
+    pthread_rwlock_wrlock(&metadata_lock);
+    int slot = store_find(target->id);
+    if (slot == -1 || strcmp(store_get(slot)->path, target->path) != 0) {
+        // Removido ou substituído entretanto
+        pthread_rwlock_unlock(&metadata_lock);
+        index_free_doc_terms(terms);
+        results_check_free(check);
+        return;
+    }
+    intmap_remove(&missing_documents, target->id);
+    index_remove_document(target->id);
+    if (terms) {
+        index_insert(target->id, terms);
+    }
+    // As pesquisas em cache passam a ter a resposta para o conteúdo novo
+    results_add_document(target->id, check);
+    pthread_rwlock_unlock(&metadata_lock);
+    
+    atomic_fetch_add(&maint_reindexed, 1);
+    log_info("Documento %d: ficheiro %s %s, reindexado\n", target->id, target->path,
+             was_missing ? "voltou a aparecer" : "alterado");
+}
+
+// Verificar os documentos em cache com caminho em paths[0..count) (ordenado),
+// ou todos se paths é NULL
+static void maintenance_scan(char **paths, int count, int reindex) {
+    pthread_rwlock_rdlock(&metadata_lock);
+    int num_documents = store_count();
+    MaintenanceTarget *targets = (MaintenanceTarget*)malloc(sizeof(MaintenanceTarget) * (num_documents + 1));
+    int num_targets = 0;
+    for (int i = 0; targets && i < num_documents; i++) {
+        Document doc;
+        store_peek(i, &doc);
+        const char *key = doc.path;
+        if (paths && !bsearch(&key, paths, count, sizeof(char*), compare_strings)) {
+            continue;
+        }
+        targets[num_targets].id = doc.id;
+        strcpy(targets[num_targets].path, doc.path);
+        num_targets++;
+    }
+    pthread_rwlock_unlock(&metadata_lock);
+    
+    for (int i = 0; i < num_targets && !atomic_load(&maintenance_stopping); i++) {
+        maintenance_check(&targets[i], reindex);
+    }
+    free(targets);
+}
+
+// Indexar um documento em cache que o índice não tem
+static void maintenance_index(const MaintenanceTarget *target) {
+    char full_path[MAX_PATH_SIZE * 2];
+    sprintf(full_path, "%s/%s", document_folder, target->path);
+    struct stat st;
+    if (stat(full_path, &st) == -1) {
+        return; // Desaparecido: maintenance_check trata dele
+    }
+    
+    maintenance_throttle(st.st_size);
+    DocTerms *terms = index_tokenize_file(full_path);
+    if (!terms) {
+        return;
+    }
+    
+    pthread_rwlock_wrlock(&metadata_lock);
+    int slot = store_find(target->id);
+    int unused;
+    if (slot == -1 || strcmp(store_get(slot)->path, target->path) != 0 ||
+        index_has_document(target->id) || intmap_get(&missing_documents, target->id, &unused) == 0) {
+        // Removido, substituído ou já indexado entretanto
+        index_free_doc_terms(terms);
+    } else {
+        index_insert(target->id, terms);
+        atomic_fetch_add(&maint_reindexed, 1);
+    }
+    pthread_rwlock_unlock(&metadata_lock);
+}
+
+// Indexar os documentos em cache que faltam no índice (ficheiro do índice
+// perdido, descartado ou atrasado em relação aos metadados)
+static void maintenance_index_missing() {
+    pthread_rwlock_rdlock(&metadata_lock);
+    int num_documents = store_count();
+    MaintenanceTarget *targets = index_loaded && index_num_documents() < num_documents ?
+        (MaintenanceTarget*)malloc(sizeof(MaintenanceTarget) * (num_documents + 1)) : NULL;
+    int num_targets = 0;
+    for (int i = 0; targets && i < num_documents; i++) {
+        if (index_has_document(store_id(i))) {
+            continue;
+        }
+        Document doc;
+        store_peek(i, &doc);
+        targets[num_targets].id = doc.id;
+        strcpy(targets[num_targets].path, doc.path);
+        num_targets++;
+    }
+    pthread_rwlock_unlock(&metadata_lock);
+    
+    if (num_targets > 0) {
+        log_info("Manutenção: a indexar %d documentos em falta no índice\n", num_targets);
+    }
+    for (int i = 0; i < num_targets && !atomic_load(&maintenance_stopping); i++) {
+        maintenance_index(&targets[i]);
+    }
+    free(targets);
+}
+
+static void maintenance_verify_snapshot(size_t bytes) {
+    if (!atomic_load(&maintenance_stopping)) {
+        maintenance_throttle(bytes);
+    }
+}
+
+static void *maintenance_thread_main(void *unused) {
+    (void)unused;
+    
+    // Arranque: o checksum que o arranque não verifica, e os ficheiros que
+    // desapareceram enquanto o servidor estava parado
+    if (snapshot_verify(maintenance_verify_snapshot) == 0 && !atomic_load(&maintenance_stopping)) {
+        fprintf(stderr, "Checksum do snapshot inválido: alguns metadados podem estar corrompidos\n");
+    }
+    maintenance_scan(NULL, 0, 0);
+    maintenance_index_missing();
+    
+    // Caminhos com eventos por tratar (podem repetir-se)
+    char **pending = NULL;
+    int num_pending = 0;
+    int cap_pending = 0;
+    int rescan_all = 0;
+    struct timespec first_event;
+    
+    while (!atomic_load(&maintenance_stopping)) {
+        struct pollfd pfds[2] = { { maintenance_pipe[0], POLLIN, 0 }, { watch_fd(), POLLIN, 0 } };
+        int waiting = num_pending > 0 || rescan_all;
+        int ready = poll(pfds, watch_fd() >= 0 ? 2 : 1, waiting ? MAINT_SETTLE_MS : -1);
+        if (ready < 0) {
+            continue; // EINTR
+        }
+        
+        if (pfds[0].revents & POLLIN) {
+            char reasons[64];
+            read(maintenance_pipe[0], reasons, sizeof(reasons));
+            if (atomic_load(&maintenance_stopping)) {
+                break;
+            }
+            if (atomic_load(&compaction_requested)) {
+                maintenance_compact();
+            }
+        }
+        
+        if (ready > 0 && (pfds[1].revents & POLLIN)) {
+            char path[MAX_PATH_SIZE];
+            int event;
+            while ((event = watch_next(path, sizeof(path))) != 0) {
+                if (!waiting) {
+                    clock_gettime(CLOCK_MONOTONIC, &first_event);
+                    waiting = 1;
+                }
+                if (event == WATCH_OVERFLOW) {
+                    rescan_all = 1;
+                    continue;
+                }
+                // Alterado ou removido: a verificação decide pelo estado atual
+                if (num_pending == cap_pending) {
+                    int capacity = cap_pending > 0 ? cap_pending * 2 : 64;
+                    char **grown = (char**)realloc(pending, sizeof(char*) * capacity);
+                    if (!grown) {
+                        rescan_all = 1;
+                        continue;
+                    }
+                    pending = grown;
+                    cap_pending = capacity;
+                }
+                if ((pending[num_pending] = strdup(path))) {
+                    num_pending++;
+                }
+            }
+            if (!waiting || elapsed_since_ms(&first_event) < MAINT_MAX_DELAY_MS) {
+                continue; // Esperar que os eventos acalmem
+            }
+        } else if (ready > 0 || !waiting) {
+            continue;
+        }
+        
+        if (rescan_all) {
+            // Eventos perdidos: qualquer ficheiro pode ter mudado
+            maintenance_scan(NULL, 0, 1);
+        } else if (num_pending > 0) {
+            qsort(pending, num_pending, sizeof(char*), compare_strings);
+            maintenance_scan(pending, num_pending, 1);
+        }
+        for (int i = 0; i < num_pending; i++) {
+            free(pending[i]);
+        }
+        num_pending = 0;
+        rescan_all = 0;
+    }
+    
+    for (int i = 0; i < num_pending; i++) {
+        free(pending[i]);
+    }
+    free(pending);
+    return NULL;
+}
+
+// Vigiar as diretorias dos documentos em cache e lançar a thread
+int maintenance_start() {
+    if (maintenance_mb <= 0) {
+        return 0;
+    }
+    if (pipe(maintenance_pipe) < 0) {
+        perror("Erro ao criar pipe de manutenção");
+        return -1;
+    }
+    if (watch_open(document_folder) == 0) {
+        pthread_rwlock_rdlock(&metadata_lock);
+        for (int i = 0; i < store_count(); i++) {
+            Document doc;
+            store_peek(i, &doc);
+            watch_add_path(doc.path);
+        }
+        pthread_rwlock_unlock(&metadata_lock);
+    } else {
+        fprintf(stderr, "Alterações aos ficheiros não vão ser detetadas\n");
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &maintenance_refilled);
+    if (pthread_create(&maintenance_thread, NULL, maintenance_thread_main, NULL) != 0) {
+        perror("Erro ao criar thread de manutenção");
+        watch_close();
+        close(maintenance_pipe[0]);
+        close(maintenance_pipe[1]);
+        return -1;
+    }
+    maintenance_running = 1;
+    return 0;
+}
+
+void maintenance_stop() {
+    if (!maintenance_running) {
+        return;
+    }
+    atomic_store(&maintenance_stopping, 1);
+    char reason = 'q';
+    write(maintenance_pipe[1], &reason, 1);
+    pthread_join(maintenance_thread, NULL);
+    maintenance_running = 0;
+    
+    watch_close();
+    close(maintenance_pipe[0]);
+    close(maintenance_pipe[1]);
+}
+
+// Opções adicionais, depois dos argumentos obrigatórios
+int parse_options(int argc, char *argv[]) {
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            search_threads = atoi(argv[++i]);
+            if (search_threads < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            ScanMode mode;
+            if (scan_parse_mode(argv[++i], &mode) < 0) {
+                return -1;
+            }
+            scan_set_mode(mode);
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            content_cache_mb = atoi(argv[++i]);
+            if (content_cache_mb < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            results_cache_mb = atoi(argv[++i]);
+            if (results_cache_mb < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            maintenance_mb = atoi(argv[++i]);
+            if (maintenance_mb < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            log_level = atoi(argv[++i]);
+            if (log_level < LOG_ERROR || log_level > LOG_DEBUG) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            request_threads = atoi(argv[++i]);
+            if (request_threads <= 0) {
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "Opção desconhecida: %s\n", argv[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Função principal
+int main(int argc, char *argv[]) {
+    // Verificar argumentos
+    if (argc < 3 || parse_options(argc - 3, argv + 3) < 0) {
+        fprintf(stderr, "Uso: %s document_folder cache_size [-w search_threads] [-t request_threads] [-m read|mmap|uring] [-C content_cache_mb] [-R results_cache_mb] [-B maintenance_mb_per_s] [-v 0|1|2]\n", argv[0]);
+        return 1;
+    }
+    
+    // Obter argumentos
+    strncpy(document_folder, argv[1], MAX_PATH_SIZE - 1);
+    document_folder[MAX_PATH_SIZE - 1] = '\0';  // Garantir terminação
+    
+    cache_size = atoi(argv[2]);
+    if (cache_size <= 0) {
+        fprintf(stderr, "Tamanho de cache inválido. Deve ser maior que zero.\n");
+        return 1;
+    }
+    
+    if (search_threads < 0) {
+        search_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (scan_get_mode() == SCAN_URING && !uring_available()) {
+        fprintf(stderr, "io_uring indisponível neste kernel: a usar read()\n");
+        scan_set_mode(SCAN_READ);
+    }
+    
+    log_info("Pasta de documentos: %s\n", document_folder);
+    log_info("Tamanho do cache: %d\n", cache_size);
+    log_info("Threads de pesquisa: %d\n", search_threads);
+    log_info("Threads de pedidos: %d\n", request_threads);
+    log_info("Pesquisa de subcadeias: %s (%s)\n", scan_kernel_name(), scan_mode_name(scan_get_mode()));
+    log_info("Cache de conteúdos: %d MB\n", content_cache_mb);
+    log_info("Cache de resultados: %d MB\n", results_cache_mb);
+    log_info("Manutenção em segundo plano: %d MB/s\n", maintenance_mb);
+    
+    // Inicializar servidor
+    if (initialize_server() < 0) {
+        return 1;
+    }
+    
+    // Configurar limpeza ao encerrar
+    atexit(cleanup);
+    
+    // Um cliente que desiste a meio de uma resposta não pode terminar o servidor
+    signal(SIGPIPE, SIG_IGN);
+    
+    // Abrir pipe para leitura
+    int server_pipe = open(SERVER_PIPE, O_RDONLY);
+    if (server_pipe == -1) {
+        perror("Erro ao abrir pipe do servidor");
+        return 1;
+    }
+    
+    // Manter uma extremidade de escrita aberta: sem clientes ligados, read()
+    // e poll() bloqueiam em vez de devolverem fim de ficheiro continuamente
+    int server_pipe_keepalive = open(SERVER_PIPE, O_WRONLY);
+    if (server_pipe_keepalive == -1) {
+        perror("Erro ao abrir pipe do servidor");
+        return 1;
+    }
+    
+    log_info("Aguardar conexões de clientes...\n");
+    
+    // Threads que atendem os pedidos: a thread principal só lê o pipe
+    if (dispatcher_start(request_threads) < 0) {
+        return 1;
+    }
+    
+    // Sem a thread de manutenção o servidor funciona na mesma: os ficheiros
+    // alterados não são detetados e a compactação volta a ser feita nos pedidos
+    maintenance_start();
     
     // Loop principal do servidor
     ClientMessage client_msg;
-    ServerMessage server_response;
-    char client_pipe_name[100];
-    int client_pipe;
 
     while(1) {
+        // Group commit: se há registos do diário por sincronizar, esperar por
+        // novos pedidos apenas até ao prazo do lote e sincronizar de seguida
+        int timeout = journal_sync_timeout();
+        if (timeout >= 0) {
+            struct pollfd pfd = { server_pipe, POLLIN, 0 };
+            if (poll(&pfd, 1, timeout) == 0) {
+                journal_sync(1);
+                continue;
+            }
+        }
+        
         // Ler mensagem do cliente
         ssize_t bytes_read = read(server_pipe, &client_msg, sizeof(ClientMessage));
         
         if (bytes_read > 0) {
-            printf("Mensagem recebida do cliente PID %d, operação %d\n", 
+            struct timespec received;
+            clock_gettime(CLOCK_MONOTONIC, &received);
+            log_debug("Mensagem recebida do cliente PID %d, operação %d\n", 
                 client_msg.pid, client_msg.operation);
             
-            // Configurar nome do pipe do cliente
-            sprintf(client_pipe_name, "%s%d", CLIENT_PIPE_PREFIX, client_msg.pid);
-            
-            // Inicializar resposta
-            memset(&server_response, 0, sizeof(ServerMessage));
-            
-            // Processar mensagem de acordo com a operação
-            switch(client_msg.operation) {
-                case OP_ADD:
-                    printf("A Adicionar documento: %s\n", client_msg.title);
-                    server_response.doc_id = add_document(&client_msg);
-                    
-                    if (server_response.doc_id > 0) {
-                        server_response.status = 0;
-                    } else if (server_response.doc_id == -1) {
-                        server_response.status = -1;
-                        strcpy(server_response.error_msg, "Cache cheio");
-                    } else {
-                        server_response.status = -1;
-                        strcpy(server_response.error_msg, "Arquivo não encontrado");
-                    }
-                    break;
-                    
-                case OP_CONSULT:
-                    printf("Consultar documento: %d\n", client_msg.doc_id);
-                    if (consult_document(client_msg.doc_id, &server_response.doc) == 0) {
-                        server_response.status = 0;
-                    } else {
-                        server_response.status = -1;
-                        strcpy(server_response.error_msg, "Documento não encontrado");
-                    }
-                    break;
-                    
-                case OP_DELETE:
-                    printf("Remover documento: %d\n", client_msg.doc_id);
-                    if (delete_document(client_msg.doc_id) == 0) {
-                        server_response.status = 0;
-                    } else {
-                        server_response.status = -1;
-                        strcpy(server_response.error_msg, "Documento não encontrado");
-                    }
-                    break;
-                    
-                case OP_LINES:
-                    printf("Contar linhas no documento %d com palavra-chave: %s\n", 
-                           client_msg.doc_id, client_msg.keyword);
-                    server_response.line_count = count_lines(client_msg.doc_id, client_msg.keyword);
-                    
-                    if (server_response.line_count >= 0) {
-                        server_response.status = 0;
-                    } else if (server_response.line_count == -1) {
-                        server_response.status = -1;
-                        strcpy(server_response.error_msg, "Documento não encontrado");
-                    } else {
-                        server_response.status = -1;
-                        strcpy(server_response.error_msg, "Erro ao contar linhas");
-                    }
-                    break;
-                    
-                case OP_SEARCH:
-                    printf("Pesquisar documentos com palavra-chave: %s (processos: %d)\n", 
-                           client_msg.keyword, client_msg.nr_processes);
-                    // [MODIFICADO] Adicionado parâmetro nr_processes para pesquisa paralela
-                    server_response.doc_count = search_documents(client_msg.keyword, 
-                                                                server_response.doc_ids, 
-                                                                1024,
-                                                                client_msg.nr_processes);
-                    server_response.status = 0;
-                    break;
-                    
-                case OP_SHUTDOWN:
-                    printf("Comando de desligamento recebido\n");
-                    server_response.status = 0;
-                    
-                    // Abrir pipe do cliente para enviar confirmação
-                    client_pipe = open(client_pipe_name, O_WRONLY);
-                    if (client_pipe != -1) {
-                        write(client_pipe, &server_response, sizeof(ServerMessage));
-                        close(client_pipe);
-                    }
-                    
-                    // Encerrar o servidor
-                    close(server_pipe);
-                    exit(0);
-                    break;
-                    
-                default:
-                    printf("Operação não reconhecida\n");
-                    server_response.status = -1;
-                    strcpy(server_response.error_msg, "Operação não reconhecida");
-                    break;
+            if (client_msg.operation == OP_SHUTDOWN) {
+                log_info("Comando de desligamento recebido\n");
+                
+                // Terminar os pedidos em curso antes de confirmar
+                dispatcher_stop();
+                journal_sync(1);
+                
+                ReplyChannel channel;
+                Session *session;
+                if (reply_open(&client_msg, &channel, &session) == 0) {
+                    send_frame(&channel, FRAME_OK, 0, NULL, 0);
+                    reply_close(&client_msg, &channel, session);
+                }
+                session_close_all();
+                
+                // Encerrar o servidor
+                close(server_pipe);
+                close(server_pipe_keepalive);
+                exit(0);
             }
             
-            // Enviar resposta (exceto para OP_SHUTDOWN, que já enviou)
-            if (client_msg.operation != OP_SHUTDOWN) {
-                client_pipe = open(client_pipe_name, O_WRONLY);
-                if (client_pipe != -1) {
-                    write(client_pipe, &server_response, sizeof(ServerMessage));
-                    close(client_pipe);
-                } else {
-                    perror("Erro ao abrir pipe do cliente");
-                }
+            // Entregar o pedido a uma thread de pedidos
+            if (dispatcher_submit(&client_msg, &received) < 0) {
+                serve_request(&client_msg, &received);
             }
         }
+        
+        // Com pedidos sempre a chegar o poll() nunca expira: o lote também é
+        // sincronizado aqui quando fica cheio ou passa o prazo
+        journal_sync(0);
     }
     
     close(server_pipe);
+    close(server_pipe_keepalive);
     
     return 0;
 }
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "gz.h"
+
+#define GZ_INPUT_SIZE (64 * 1024)
+
+struct GzReader {
+    int fd;                 // -1 = entrada toda em memória
+    z_stream zs;
+    unsigned char *input;   // Buffer de entrada (só com fd)
+    int input_eof;
+    int finished;           // Último membro terminado e sem mais entrada
+    int failed;
+};
+
+// Tamanho total do membro BGZF com cabeçalho em h, 0 se não é um cabeçalho BGZF
+static size_t bgzf_block_size(const unsigned char *h, size_t n) {
+    if (n < GZ_HEADER_SIZE || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4) ||
+        h[10] != 6 || h[11] != 0 || h[12] != 'B' || h[13] != 'C' || h[14] != 2 || h[15] != 0) {
+        return 0;
+    }
+    return (size_t)(h[16] | (h[17] << 8)) + 1;
+}
+
+int gz_detect(const void *head, size_t n) {
+    const unsigned char *h = (const unsigned char*)head;
+    if (n < 3 || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8) {
+        return GZ_NONE; // Só deflate (método 8)
+    }
+    return bgzf_block_size(h, n) > 0 ? GZ_BGZF : GZ_GZIP;
+}
+
+GzReader *gz_reader_new(int fd, const char *input, size_t input_len) {
+    GzReader *reader = (GzReader*)calloc(1, sizeof(GzReader));
+    if (!reader) {
+        return NULL;
+    }
+    reader->fd = fd;
+    if (fd >= 0) {
+        size_t size = input_len > GZ_INPUT_SIZE ? input_len : GZ_INPUT_SIZE;
+        reader->input = (unsigned char*)malloc(size);
+        if (!reader->input) {
+            free(reader);
+            return NULL;
+        }
+        memcpy(reader->input, input, input_len);
+        reader->zs.next_in = reader->input;
+    } else {
+        reader->zs.next_in = (unsigned char*)input;
+        reader->input_eof = 1;
+    }
+    reader->zs.avail_in = (uInt)input_len;
+
+    // 15 + 16: janela máxima, com cabeçalho e verificação gzip
+    if (inflateInit2(&reader->zs, 15 + 16) != Z_OK) {
+        free(reader->input);
+        free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+// Voltar a encher o buffer de entrada; 0 se já não há mais
+static int refill(GzReader *reader) {
+    if (reader->input_eof) {
+        return 0;
+    }
+    ssize_t bytes_read = read(reader->fd, reader->input, GZ_INPUT_SIZE);
+    if (bytes_read < 0) {
+        reader->failed = 1;
+        return 0;
+    }
+    if (bytes_read == 0) {
+        reader->input_eof = 1;
+        return 0;
+    }
+    reader->zs.next_in = reader->input;
+    reader->zs.avail_in = (uInt)bytes_read;
+    return 1;
+}
+
+ssize_t gz_read(GzReader *reader, char *buf, size_t n) {
+    reader->zs.next_out = (unsigned char*)buf;
+    reader->zs.avail_out = (uInt)n;
+
+    while (reader->zs.avail_out > 0 && !reader->finished && !reader->failed) {
+        if (reader->zs.avail_in == 0 && !refill(reader)) {
+            // Fim da entrada a meio de um membro: ficheiro truncado
+            reader->failed = 1;
+            break;
+        }
+        int ret = inflate(&reader->zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            // Vários membros seguidos (BGZF, cat a.gz b.gz) formam um só conteúdo
+            if (reader->zs.avail_in == 0 && !refill(reader)) {
+                reader->finished = 1;
+            } else if (reader->zs.next_in[0] != 0x1f) {
+                reader->finished = 1; // Lixo ou zeros depois do último membro
+            } else {
+                inflateReset(&reader->zs);
+            }
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            reader->failed = 1;
+        }
+    }
+
+    size_t produced = n - reader->zs.avail_out;
+    if (produced > 0) {
+        return (ssize_t)produced; // O erro, se houve, fica para a chamada seguinte
+    }
+    return reader->failed ? -1 : 0;
+}
+
+void gz_reader_free(GzReader *reader) {
+    if (!reader) {
+        return;
+    }
+    inflateEnd(&reader->zs);
+    free(reader->input);
+    free(reader);
+}
+
+off_t gz_bgzf_find(int fd, off_t from, off_t file_size) {
+    unsigned char *window = (unsigned char*)malloc(GZ_BGZF_MAX_BLOCK + GZ_HEADER_SIZE);
+    if (!window) {
+        return file_size;
+    }
+
+    // Um membro tem no máximo 64 KB: se há algum depois de 'from', começa nesta janela
+    ssize_t got = pread(fd, window, GZ_BGZF_MAX_BLOCK + GZ_HEADER_SIZE, from);
+    off_t result = file_size;
+    for (ssize_t i = 0; i + GZ_HEADER_SIZE <= got; i++) {
+        size_t size = bgzf_block_size(window + i, got - i);
+        if (size == 0) {
+            continue;
+        }
+        // Confirmar que não é uma coincidência nos dados comprimidos: o membro
+        // seguinte também tem de ter um cabeçalho BGZF (ou o ficheiro acaba ali)
+        off_t next = from + i + size;
+        unsigned char head[GZ_HEADER_SIZE];
+        if (next == file_size ||
+            (pread(fd, head, GZ_HEADER_SIZE, next) == GZ_HEADER_SIZE && bgzf_block_size(head, GZ_HEADER_SIZE) > 0)) {
+            result = from + i;
+            break;
+        }
+    }
+    free(window);
+    return result;
+}
+
+ssize_t gz_bgzf_inflate(int fd, off_t pos, char *out, size_t *block_size) {
+    unsigned char *block = (unsigned char*)malloc(GZ_BGZF_MAX_BLOCK);
+    if (!block) {
+        return -1;
+    }
+    ssize_t got = pread(fd, block, GZ_BGZF_MAX_BLOCK, pos);
+    size_t size = got > 0 ? bgzf_block_size(block, got) : 0;
+    if (size < GZ_HEADER_SIZE + 8 || (size_t)got < size) {
+        free(block);
+        return -1;
+    }
+
+    // Dados deflate sem cabeçalho: entre o cabeçalho e o CRC32 + ISIZE finais
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK) {
+        free(block);
+        return -1;
+    }
+    zs.next_in = block + GZ_HEADER_SIZE;
+    zs.avail_in = (uInt)(size - GZ_HEADER_SIZE - 8);
+    zs.next_out = (unsigned char*)out;
+    zs.avail_out = GZ_BGZF_MAX_BLOCK;
+    int ret = inflate(&zs, Z_FINISH);
+    ssize_t produced = GZ_BGZF_MAX_BLOCK - zs.avail_out;
+    inflateEnd(&zs);
+    free(block);
+
+    if (ret != Z_STREAM_END) {
+        return -1;
+    }
+    *block_size = size;
+    return produced;
+}
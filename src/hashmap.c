@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hashmap.h"
+
+// Dispersão de inteiros (multiplicativa, constante de Knuth)
+static unsigned int hash_int(int key) {
+    return (unsigned int)key * 2654435761u;
+}
+
+int intmap_init(IntMap *map, int initial_capacity) {
+    int capacity = 16;
+    while (capacity < initial_capacity * 2) {
+        capacity *= 2;
+    }
+
+    map->keys = (int*)calloc(capacity, sizeof(int));
+    map->values = (int*)malloc(sizeof(int) * capacity);
+    if (!map->keys || !map->values) {
+        free(map->keys);
+        free(map->values);
+        return -1;
+    }
+
+    map->capacity = capacity;
+    map->count = 0;
+    return 0;
+}
+
+void intmap_free(IntMap *map) {
+    free(map->keys);
+    free(map->values);
+    map->keys = NULL;
+    map->values = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+// Duplicar a capacidade e reinserir todas as entradas
+static int intmap_grow(IntMap *map) {
+    IntMap bigger;
+    if (intmap_init(&bigger, map->capacity) < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->keys[i] != 0) {
+            intmap_put(&bigger, map->keys[i], map->values[i]);
+        }
+    }
+
+    intmap_free(map);
+    *map = bigger;
+    return 0;
+}
+
+int intmap_get(const IntMap *map, int key, int *value) {
+    unsigned int mask = map->capacity - 1;
+    unsigned int i = hash_int(key) & mask;
+
+    while (map->keys[i] != 0) {
+        if (map->keys[i] == key) {
+            if (value) {
+                *value = map->values[i];
+            }
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+int intmap_put(IntMap *map, int key, int value) {
+    // Manter o fator de carga abaixo de 1/2
+    if ((map->count + 1) * 2 > map->capacity) {
+        if (intmap_grow(map) < 0) {
+            return -1;
+        }
+    }
+
+    unsigned int mask = map->capacity - 1;
+    unsigned int i = hash_int(key) & mask;
+
+    while (map->keys[i] != 0) {
+        if (map->keys[i] == key) {
+            map->values[i] = value;
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+
+    map->keys[i] = key;
+    map->values[i] = value;
+    map->count++;
+    return 0;
+}
+
+int intmap_remove(IntMap *map, int key) {
+    unsigned int mask = map->capacity - 1;
+    unsigned int i = hash_int(key) & mask;
+
+    while (map->keys[i] != key) {
+        if (map->keys[i] == 0) {
+            return -1;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Remoção com deslocamento para trás (sem marcas de remoção)
+    unsigned int j = i;
+    while (1) {
+        map->keys[i] = 0;
+        unsigned int home;
+        do {
+            j = (j + 1) & mask;
+            if (map->keys[j] == 0) {
+                map->count--;
+                return 0;
+            }
+            home = hash_int(map->keys[j]) & mask;
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+
+        map->keys[i] = map->keys[j];
+        map->values[i] = map->values[j];
+        i = j;
+    }
+}
@@ -0,0 +1,1508 @@
+#define _GNU_SOURCE  // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "gz.h"
+#include "hashmap.h"
+#include "index.h"
+#include "scan.h"
+#include "stats.h"
+
+#define INDEX_FILE ".index_terms"
+#define INDEX_MAGIC "IDX2"
+#define REC_ADD 'A'
+#define REC_DEL 'D'
+#define COMPACT_MIN_DEAD 1024  // Registos obsoletos antes de compactar o ficheiro
+
+// Termo do vocabulário global
+typedef struct {
+    char *text;
+    int len;
+    unsigned int hash;
+    int *postings;      // Versões de documentos que contêm o termo
+    int num_postings;
+    int cap_postings;
+} Term;
+
+// Versão indexada de um documento (índice direto: termos e linhas).
+// As linhas de cada termo formam um conjunto ao estilo dos roaring bitmaps:
+// lista ordenada de números de linha (uint16, ou uint32 em documentos com
+// mais de 65536 linhas) se o termo é raro, mapa de bits de num_lines bits se
+// a lista ocupasse o mesmo ou mais. O tipo deduz-se do tamanho (line_set_*).
+typedef struct {
+    int doc_id;         // 0 = versão removida
+    int num_lines;      // Total de linhas do documento
+    int num_terms;
+    int *term_ids;
+    uint32_t *line_start;       // Linhas do termo i: line_data[line_start[i] .. line_start[i + 1])
+    unsigned char *line_data;
+    uint32_t *line_offsets;     // Início de cada linha no ficheiro (num_lines + 1), NULL se > 4 GB
+} DocVersion;
+
+// Termo local a um documento, antes de ser fundido no índice global
+typedef struct {
+    char *text;
+    int len;
+    unsigned int hash;
+    int *lines;
+    int num_lines;
+    int cap_lines;
+} LocalTerm;
+
+struct DocTerms {
+    int num_lines;
+    uint32_t *offsets;  // Início de cada linha, como em DocVersion
+    int cap_offsets;
+    LocalTerm *terms;
+    int num_terms;
+    int cap_terms;
+    int *table;         // Índices em terms, -1 = livre
+    int table_cap;
+};
+
+// Buffer dinâmico para serializar registos
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+// Estado global do índice
+static Term *terms = NULL;
+static int num_terms = 0;
+static int cap_terms = 0;
+static int *term_table = NULL;   // Dispersão texto -> id do termo, -1 = livre
+static int term_table_cap = 0;
+
+static DocVersion *versions = NULL;
+static int num_versions = 0;
+static int cap_versions = 0;
+static IntMap doc_versions;      // doc_id -> versão atual
+static int live_docs = 0;
+
+static long total_postings = 0;
+static long dead_postings = 0;   // Entradas que apontam para versões removidas
+static int dead_versions = 0;    // Versões removidas ainda em versions
+
+// Trigramas do vocabulário: um termo só pode conter uma palavra-chave com 3
+// ou mais bytes se tiver todos os trigramas dela, por isso basta percorrer os
+// termos do trigrama mais raro em vez do vocabulário todo
+typedef struct {
+    int *term_ids;      // Por ordem crescente (os termos só são acrescentados)
+    int count;
+    int cap;
+} GramList;
+
+static IntMap gram_map;          // Trigrama -> posição em grams
+static GramList *grams = NULL;
+static int num_grams = 0;
+static int cap_grams = 0;
+static int grams_complete = 1;   // 0 se faltou memória: percorrer o vocabulário
+
+static char index_path[MAX_PATH_SIZE * 2];
+static int log_fd = -1;
+static int dead_records = 0;     // Registos do ficheiro que já não contam
+static int index_ready = 0;      // O índice só responde a consultas depois de carregado
+
+// Função de dispersão FNV-1a
+static unsigned int hash_bytes(const char *data, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int is_term_char(unsigned char c) {
+    return isalnum(c) || c == '_' || c >= 0x80;
+}
+
+static void *grow_array(void *array, int *cap, int needed, size_t elem_size) {
+    if (needed <= *cap) {
+        return array;
+    }
+    int new_cap = *cap > 0 ? *cap : 8;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+    void *bigger = realloc(array, new_cap * elem_size);
+    if (!bigger) {
+        return NULL;
+    }
+    *cap = new_cap;
+    return bigger;
+}
+
+static int buffer_put(Buffer *buf, const void *data, size_t len) {
+    if (buf->len + len > buf->cap) {
+        size_t new_cap = buf->cap > 0 ? buf->cap : 4096;
+        while (new_cap < buf->len + len) {
+            new_cap *= 2;
+        }
+        char *bigger = (char*)realloc(buf->data, new_cap);
+        if (!bigger) {
+            return -1;
+        }
+        buf->data = bigger;
+        buf->cap = new_cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written <= 0) {
+            return -1;
+        }
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Tokenização (estado local a um documento)
+// ---------------------------------------------------------------------------
+
+static DocTerms *doc_terms_new() {
+    DocTerms *dt = (DocTerms*)calloc(1, sizeof(DocTerms));
+    if (!dt) {
+        return NULL;
+    }
+    dt->table_cap = 256;
+    dt->table = (int*)malloc(sizeof(int) * dt->table_cap);
+    if (!dt->table) {
+        free(dt);
+        return NULL;
+    }
+    memset(dt->table, -1, sizeof(int) * dt->table_cap);
+    return dt;
+}
+
+void index_free_doc_terms(DocTerms *dt) {
+    if (!dt) {
+        return;
+    }
+    for (int i = 0; i < dt->num_terms; i++) {
+        free(dt->terms[i].text);
+        free(dt->terms[i].lines);
+    }
+    free(dt->offsets);
+    free(dt->terms);
+    free(dt->table);
+    free(dt);
+}
+
+// Acrescentar um termo novo ao documento (sem procurar duplicados)
+static LocalTerm *doc_terms_push(DocTerms *dt, const char *text, int len, unsigned int hash) {
+    LocalTerm *grown = (LocalTerm*)grow_array(dt->terms, &dt->cap_terms,
+                                              dt->num_terms + 1, sizeof(LocalTerm));
+    if (!grown) {
+        return NULL;
+    }
+    dt->terms = grown;
+
+    LocalTerm *term = &dt->terms[dt->num_terms];
+    memset(term, 0, sizeof(LocalTerm));
+    term->text = (char*)malloc(len);
+    if (!term->text) {
+        return NULL;
+    }
+    memcpy(term->text, text, len);
+    term->len = len;
+    term->hash = hash;
+    dt->num_terms++;
+    return term;
+}
+
+static int local_term_add_line(LocalTerm *term, int line) {
+    if (term->num_lines > 0 && term->lines[term->num_lines - 1] == line) {
+        return 0; // Linha já registada
+    }
+    int *grown = (int*)grow_array(term->lines, &term->cap_lines, term->num_lines + 1, sizeof(int));
+    if (!grown) {
+        return -1;
+    }
+    term->lines = grown;
+    term->lines[term->num_lines++] = line;
+    return 0;
+}
+
+static int doc_terms_rehash(DocTerms *dt) {
+    int new_cap = dt->table_cap * 2;
+    int *table = (int*)malloc(sizeof(int) * new_cap);
+    if (!table) {
+        return -1;
+    }
+    memset(table, -1, sizeof(int) * new_cap);
+    for (int i = 0; i < dt->num_terms; i++) {
+        unsigned int slot = dt->terms[i].hash & (new_cap - 1);
+        while (table[slot] != -1) {
+            slot = (slot + 1) & (new_cap - 1);
+        }
+        table[slot] = i;
+    }
+    free(dt->table);
+    dt->table = table;
+    dt->table_cap = new_cap;
+    return 0;
+}
+
+// Registar uma ocorrência de um termo numa linha
+static int doc_terms_add(DocTerms *dt, const char *text, int len, int line) {
+    if ((dt->num_terms + 1) * 2 > dt->table_cap && doc_terms_rehash(dt) < 0) {
+        return -1;
+    }
+
+    unsigned int hash = hash_bytes(text, len);
+    unsigned int slot = hash & (dt->table_cap - 1);
+    while (dt->table[slot] != -1) {
+        LocalTerm *term = &dt->terms[dt->table[slot]];
+        if (term->hash == hash && term->len == len && memcmp(term->text, text, len) == 0) {
+            return local_term_add_line(term, line);
+        }
+        slot = (slot + 1) & (dt->table_cap - 1);
+    }
+
+    LocalTerm *term = doc_terms_push(dt, text, len, hash);
+    if (!term) {
+        return -1;
+    }
+    dt->table[slot] = dt->num_terms - 1;
+    return local_term_add_line(term, line);
+}
+
+// Registar o início da linha 'line'; ficheiros com mais de 4 GB ficam sem tabela
+static int add_line_offset(DocTerms *dt, int line, long offset) {
+    if (offset > UINT32_MAX) {
+        free(dt->offsets);
+        dt->offsets = NULL;
+        return 0;
+    }
+    uint32_t *grown = (uint32_t*)grow_array(dt->offsets, &dt->cap_offsets, line + 1, sizeof(uint32_t));
+    if (!grown) {
+        return -1;
+    }
+    dt->offsets = grown;
+    dt->offsets[line] = (uint32_t)offset;
+    return 0;
+}
+
+DocTerms *index_tokenize_file(const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    stats_add(STAT_FILES_OPENED, 1);
+
+    DocTerms *dt = doc_terms_new();
+    if (!dt) {
+        close(fd);
+        return NULL;
+    }
+
+    char buffer[4096];
+    char *token = NULL;
+    int token_len = 0;
+    int token_cap = 0;
+    int line = 0;
+    char last_char = '\n';
+    int bytes_read;
+    int error = 0;
+    long offset = 0;    // Posição do início de buffer no ficheiro
+
+    dt->offsets = (uint32_t*)grow_array(NULL, &dt->cap_offsets, 1, sizeof(uint32_t));
+    error = !dt->offsets;
+    if (dt->offsets) {
+        dt->offsets[0] = 0;
+    }
+
+    // Ficheiros comprimidos são indexados pelo conteúdo descomprimido
+    GzReader *gz = NULL;
+    while (!error && (bytes_read = gz ? gz_read(gz, buffer, sizeof(buffer))
+                                      : read(fd, buffer, sizeof(buffer))) > 0) {
+        if (offset == 0 && !gz && gz_detect(buffer, bytes_read) != GZ_NONE) {
+            gz = gz_reader_new(fd, buffer, bytes_read);
+            error = !gz;
+            continue;
+        }
+        stats_add(STAT_BYTES_SCANNED, bytes_read);
+        for (int i = 0; i < bytes_read; i++) {
+            unsigned char c = buffer[i];
+            if (is_term_char(c)) {
+                char *grown = (char*)grow_array(token, &token_cap, token_len + 1, 1);
+                if (!grown) {
+                    error = 1;
+                    break;
+                }
+                token = grown;
+                token[token_len++] = c;
+                continue;
+            }
+
+            // Fim de um termo
+            if (token_len > 0) {
+                if (doc_terms_add(dt, token, token_len, line) < 0) {
+                    error = 1;
+                    break;
+                }
+                token_len = 0;
+            }
+            if (c == '\n') {
+                line++;
+                if (dt->offsets && add_line_offset(dt, line, offset + i + 1) < 0) {
+                    error = 1;
+                    break;
+                }
+            }
+        }
+        if (bytes_read > 0) {
+            last_char = buffer[bytes_read - 1];
+            offset += bytes_read;
+        }
+    }
+
+    if (!error && token_len > 0 && doc_terms_add(dt, token, token_len, line) < 0) {
+        error = 1;
+    }
+
+    free(token);
+    close(fd);
+    if (gz) {
+        // As posições das linhas seriam do conteúdo descomprimido, que não
+        // se pode ler com pread: as contagens percorrem o ficheiro
+        gz_reader_free(gz);
+        free(dt->offsets);
+        dt->offsets = NULL;
+    }
+
+    if (error || bytes_read < 0) {
+        index_free_doc_terms(dt);
+        return NULL;
+    }
+
+    // Uma última linha sem '\n' também conta
+    dt->num_lines = line + (last_char != '\n' ? 1 : 0);
+    if (dt->offsets && add_line_offset(dt, dt->num_lines, offset) < 0) {
+        index_free_doc_terms(dt);
+        return NULL;
+    }
+    return dt;
+}
+
+// ---------------------------------------------------------------------------
+// Conjuntos de linhas
+// ---------------------------------------------------------------------------
+
+static int line_entry_size(int num_lines) {
+    return num_lines > 65536 ? 4 : 2;
+}
+
+static uint32_t line_bitmap_size(int num_lines) {
+    return (uint32_t)((num_lines + 63) / 64) * 8;
+}
+
+// Bytes do conjunto com 'count' linhas: a lista só se for mais pequena
+static uint32_t line_set_size(int count, int num_lines) {
+    uint32_t list = (uint32_t)count * line_entry_size(num_lines);
+    uint32_t bitmap = line_bitmap_size(num_lines);
+    return list < bitmap ? list : bitmap;
+}
+
+static int line_set_is_bitmap(uint32_t size, int num_lines) {
+    return size > 0 && size == line_bitmap_size(num_lines);
+}
+
+static int line_entry(const unsigned char *data, int entry_size) {
+    if (entry_size == 2) {
+        uint16_t value;
+        memcpy(&value, data, 2);
+        return value;
+    }
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return (int)value;
+}
+
+// Escrever as linhas (ordenadas, distintas) no formato escolhido por line_set_size
+static void line_set_encode(const int *lines, int count, int num_lines, unsigned char *out) {
+    uint32_t size = line_set_size(count, num_lines);
+    if (line_set_is_bitmap(size, num_lines)) {
+        memset(out, 0, size);
+        for (int j = 0; j < count; j++) {
+            uint64_t word;
+            memcpy(&word, out + lines[j] / 64 * 8, 8);
+            word |= (uint64_t)1 << (lines[j] % 64);
+            memcpy(out + lines[j] / 64 * 8, &word, 8);
+        }
+        return;
+    }
+    int entry_size = line_entry_size(num_lines);
+    for (int j = 0; j < count; j++) {
+        if (entry_size == 2) {
+            uint16_t value = (uint16_t)lines[j];
+            memcpy(out + j * 2, &value, 2);
+        } else {
+            uint32_t value = (uint32_t)lines[j];
+            memcpy(out + j * 4, &value, 4);
+        }
+    }
+}
+
+// Linhas de um conjunto por ordem crescente; -1 se o conjunto é inválido
+static int line_set_decode(const unsigned char *data, uint32_t size, int num_lines, int *lines) {
+    int count = 0;
+    if (line_set_is_bitmap(size, num_lines)) {
+        for (uint32_t w = 0; w < size / 8; w++) {
+            uint64_t word;
+            memcpy(&word, data + w * 8, 8);
+            while (word) {
+                int line = w * 64 + __builtin_ctzll(word);
+                if (line >= num_lines) {
+                    return -1;
+                }
+                lines[count++] = line;
+                word &= word - 1;
+            }
+        }
+        return count;
+    }
+    int entry_size = line_entry_size(num_lines);
+    if (size % entry_size != 0) {
+        return -1;
+    }
+    for (uint32_t j = 0; j < size; j += entry_size) {
+        int line = line_entry(data + j, entry_size);
+        if (line >= num_lines || (count > 0 && line <= lines[count - 1])) {
+            return -1;
+        }
+        lines[count++] = line;
+    }
+    return count;
+}
+
+static int line_set_count(const DocVersion *dv, int i) {
+    const unsigned char *data = dv->line_data + dv->line_start[i];
+    uint32_t size = dv->line_start[i + 1] - dv->line_start[i];
+    if (!line_set_is_bitmap(size, dv->num_lines)) {
+        return size / line_entry_size(dv->num_lines);
+    }
+    int count = 0;
+    for (uint32_t w = 0; w < size / 8; w++) {
+        uint64_t word;
+        memcpy(&word, data + w * 8, 8);
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+// Acrescentar as linhas do termo i ao mapa de bits 'bits'
+static void line_set_or(const DocVersion *dv, int i, uint64_t *bits) {
+    const unsigned char *data = dv->line_data + dv->line_start[i];
+    uint32_t size = dv->line_start[i + 1] - dv->line_start[i];
+    if (line_set_is_bitmap(size, dv->num_lines)) {
+        for (uint32_t w = 0; w < size / 8; w++) {
+            uint64_t word;
+            memcpy(&word, data + w * 8, 8);
+            bits[w] |= word;
+        }
+        return;
+    }
+    int entry_size = line_entry_size(dv->num_lines);
+    for (uint32_t j = 0; j < size; j += entry_size) {
+        int line = line_entry(data + j, entry_size);
+        bits[line / 64] |= (uint64_t)1 << (line % 64);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Índice global
+// ---------------------------------------------------------------------------
+
+// Passar a usar 'table' (new_cap posições) como tabela de dispersão dos termos
+static void term_table_fill(int *table, int new_cap) {
+    memset(table, -1, sizeof(int) * new_cap);
+    for (int i = 0; i < num_terms; i++) {
+        unsigned int slot = terms[i].hash & (new_cap - 1);
+        while (table[slot] != -1) {
+            slot = (slot + 1) & (new_cap - 1);
+        }
+        table[slot] = i;
+    }
+    free(term_table);
+    term_table = table;
+    term_table_cap = new_cap;
+}
+
+static int term_table_rehash() {
+    int new_cap = term_table_cap > 0 ? term_table_cap * 2 : 1024;
+    int *table = (int*)malloc(sizeof(int) * new_cap);
+    if (!table) {
+        return -1;
+    }
+    term_table_fill(table, new_cap);
+    return 0;
+}
+
+// Chave de um trigrama no mapa (> 0)
+static int gram_key(const char *text) {
+    return ((unsigned char)text[0] << 16 | (unsigned char)text[1] << 8 | (unsigned char)text[2]) + 1;
+}
+
+static void gram_add_term(int term_id) {
+    const Term *term = &terms[term_id];
+    for (int i = 0; i + 3 <= term->len && grams_complete; i++) {
+        int key = gram_key(term->text + i);
+        int g;
+        if (intmap_get(&gram_map, key, &g) < 0) {
+            GramList *grown = (GramList*)grow_array(grams, &cap_grams, num_grams + 1, sizeof(GramList));
+            if (!grown) {
+                grams_complete = 0;
+                return;
+            }
+            grams = grown;
+            if (intmap_put(&gram_map, key, num_grams) < 0) {
+                grams_complete = 0;
+                return;
+            }
+            g = num_grams++;
+            memset(&grams[g], 0, sizeof(GramList));
+        }
+
+        GramList *list = &grams[g];
+        if (list->count > 0 && list->term_ids[list->count - 1] == term_id) {
+            continue; // Trigrama repetido no mesmo termo
+        }
+        int *ids = (int*)grow_array(list->term_ids, &list->cap, list->count + 1, sizeof(int));
+        if (!ids) {
+            grams_complete = 0;
+            return;
+        }
+        list->term_ids = ids;
+        list->term_ids[list->count++] = term_id;
+    }
+}
+
+// Obter o id de um termo, criando-o se ainda não existir
+static int term_lookup_or_create(const char *text, int len, unsigned int hash) {
+    if ((num_terms + 1) * 2 > term_table_cap && term_table_rehash() < 0) {
+        return -1;
+    }
+
+    unsigned int slot = hash & (term_table_cap - 1);
+    while (term_table[slot] != -1) {
+        Term *term = &terms[term_table[slot]];
+        if (term->hash == hash && term->len == len && memcmp(term->text, text, len) == 0) {
+            return term_table[slot];
+        }
+        slot = (slot + 1) & (term_table_cap - 1);
+    }
+
+    Term *grown = (Term*)grow_array(terms, &cap_terms, num_terms + 1, sizeof(Term));
+    if (!grown) {
+        return -1;
+    }
+    terms = grown;
+
+    Term *term = &terms[num_terms];
+    memset(term, 0, sizeof(Term));
+    term->text = (char*)malloc(len);
+    if (!term->text) {
+        return -1;
+    }
+    memcpy(term->text, text, len);
+    term->len = len;
+    term->hash = hash;
+    term_table[slot] = num_terms;
+    gram_add_term(num_terms);
+    return num_terms++;
+}
+
+// Eliminar do vocabulário os termos que ficaram sem documentos: os restantes
+// são renumerados nas versões, e a tabela de dispersão e as listas de
+// trigramas são reconstruídas. Sem memória para isso, ficam como estão.
+static void purge_terms() {
+    int num_live = 0;
+    for (int t = 0; t < num_terms; t++) {
+        num_live += terms[t].num_postings > 0;
+    }
+    if (num_live == num_terms) {
+        return;
+    }
+    int table_cap = 1024;
+    while (table_cap < num_live * 2) {
+        table_cap *= 2;
+    }
+    int *moved = (int*)malloc(sizeof(int) * (num_terms + 1));
+    int *table = (int*)malloc(sizeof(int) * table_cap);
+    if (!moved || !table) {
+        free(moved);
+        free(table);
+        return;
+    }
+
+    num_live = 0;
+    for (int t = 0; t < num_terms; t++) {
+        if (terms[t].num_postings > 0) {
+            moved[t] = num_live;
+            terms[num_live++] = terms[t];
+        } else {
+            moved[t] = -1;
+            free(terms[t].text);
+            free(terms[t].postings);
+        }
+    }
+    num_terms = num_live;
+    for (int v = 0; v < num_versions; v++) {
+        for (int i = 0; i < versions[v].num_terms; i++) {
+            versions[v].term_ids[i] = moved[versions[v].term_ids[i]];
+        }
+    }
+    free(moved);
+    term_table_fill(table, table_cap);
+
+    // As listas só encolhem; as que ficam vazias libertam a memória
+    for (int g = 0; g < num_grams; g++) {
+        grams[g].count = 0;
+    }
+    grams_complete = 1;
+    for (int t = 0; t < num_terms; t++) {
+        gram_add_term(t);
+    }
+    for (int g = 0; g < num_grams; g++) {
+        if (grams[g].count == 0) {
+            free(grams[g].term_ids);
+            grams[g].term_ids = NULL;
+            grams[g].cap = 0;
+        }
+    }
+}
+
+// Eliminar das listas de documentos as versões já removidas e, se houver
+// memória para a tabela de posições, as próprias versões: as vivas passam
+// para o início de versions e as listas e doc_versions são renumeradas
+static void purge_postings() {
+    int *moved = (int*)malloc(sizeof(int) * (num_versions + 1));
+    int num_live = 0;
+    for (int v = 0; v < num_versions && moved; v++) {
+        moved[v] = versions[v].doc_id != 0 ? num_live++ : -1;
+    }
+
+    for (int t = 0; t < num_terms; t++) {
+        int kept = 0;
+        for (int i = 0; i < terms[t].num_postings; i++) {
+            int ver = terms[t].postings[i];
+            if (versions[ver].doc_id != 0) {
+                terms[t].postings[kept++] = moved ? moved[ver] : ver;
+            }
+        }
+        terms[t].num_postings = kept;
+    }
+    total_postings -= dead_postings;
+    dead_postings = 0;
+
+    if (moved) {
+        for (int v = 0; v < num_versions; v++) {
+            if (moved[v] >= 0) {
+                versions[moved[v]] = versions[v];
+            }
+        }
+        for (int i = 0; i < doc_versions.capacity; i++) {
+            if (doc_versions.keys[i] != 0) {
+                doc_versions.values[i] = moved[doc_versions.values[i]];
+            }
+        }
+        num_versions = num_live;
+        dead_versions = 0;
+        free(moved);
+    }
+    purge_terms();
+}
+
+static int remove_version(int doc_id) {
+    int ver;
+    if (intmap_get(&doc_versions, doc_id, &ver) < 0) {
+        return -1;
+    }
+
+    DocVersion *dv = &versions[ver];
+    dead_postings += dv->num_terms;
+    free(dv->term_ids);
+    free(dv->line_start);
+    free(dv->line_data);
+    free(dv->line_offsets);
+    memset(dv, 0, sizeof(DocVersion));
+
+    intmap_remove(&doc_versions, doc_id);
+    live_docs--;
+    dead_versions++;
+
+    // Remoção preguiçosa: só limpar quando metade das listas ou das versões
+    // está obsoleta
+    if ((dead_postings > 4096 && dead_postings * 2 > total_postings) ||
+        (dead_versions > 1024 && dead_versions * 2 > num_versions)) {
+        purge_postings();
+    }
+    return 0;
+}
+
+// Desfazer uma versão que não chegou a ser inserida: as primeiras 'done'
+// entradas já foram acrescentadas (no fim) às listas dos seus termos
+static void rollback_version(DocVersion *dv, int done, DocTerms *dt) {
+    for (int i = 0; i < done; i++) {
+        terms[dv->term_ids[i]].num_postings--;
+    }
+    total_postings -= done;
+    free(dv->term_ids);
+    free(dv->line_start);
+    free(dv->line_data);
+    // A tabela de linhas volta para quem chamou, que a liberta
+    dt->offsets = dv->line_offsets;
+}
+
+static int insert_version(int doc_id, DocTerms *dt) {
+    if (index_has_document(doc_id)) {
+        remove_version(doc_id);
+    }
+
+    DocVersion *grown = (DocVersion*)grow_array(versions, &cap_versions,
+                                                num_versions + 1, sizeof(DocVersion));
+    if (!grown) {
+        return -1;
+    }
+    versions = grown;
+
+    size_t total_size = 0;
+    for (int i = 0; i < dt->num_terms; i++) {
+        total_size += line_set_size(dt->terms[i].num_lines, dt->num_lines);
+    }
+    if (total_size > UINT32_MAX) {
+        return -1;
+    }
+
+    DocVersion dv;
+    dv.doc_id = doc_id;
+    dv.num_lines = dt->num_lines;
+    dv.num_terms = dt->num_terms;
+    dv.term_ids = (int*)malloc(sizeof(int) * (dt->num_terms + 1));
+    dv.line_start = (uint32_t*)malloc(sizeof(uint32_t) * (dt->num_terms + 1));
+    dv.line_data = (unsigned char*)malloc(total_size + 1);
+    if (!dv.term_ids || !dv.line_start || !dv.line_data) {
+        free(dv.term_ids);
+        free(dv.line_start);
+        free(dv.line_data);
+        return -1;
+    }
+    // A tabela de linhas passa para a versão
+    dv.line_offsets = dt->offsets;
+    dt->offsets = NULL;
+
+    int ver = num_versions;
+    uint32_t pos = 0;
+    for (int i = 0; i < dt->num_terms; i++) {
+        LocalTerm *local = &dt->terms[i];
+        int term_id = term_lookup_or_create(local->text, local->len, local->hash);
+        Term *term = term_id < 0 ? NULL : &terms[term_id];
+        int *postings = term ? (int*)grow_array(term->postings, &term->cap_postings,
+                                                term->num_postings + 1, sizeof(int)) : NULL;
+        if (!postings) {
+            rollback_version(&dv, i, dt);
+            return -1;
+        }
+        term->postings = postings;
+        term->postings[term->num_postings++] = ver;
+        total_postings++;
+
+        dv.term_ids[i] = term_id;
+        dv.line_start[i] = pos;
+        line_set_encode(local->lines, local->num_lines, dt->num_lines, dv.line_data + pos);
+        pos += line_set_size(local->num_lines, dt->num_lines);
+    }
+    dv.line_start[dt->num_terms] = pos;
+
+    if (intmap_put(&doc_versions, doc_id, ver) < 0) {
+        rollback_version(&dv, dt->num_terms, dt);
+        return -1;
+    }
+    versions[num_versions++] = dv;
+    live_docs++;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Persistência: ficheiro só de acrescento, com compactação periódica
+// ---------------------------------------------------------------------------
+
+static int serialize_version(Buffer *buf, const DocVersion *dv) {
+    char type = REC_ADD;
+    int error = 0;
+    error |= buffer_put(buf, &type, 1);
+    error |= buffer_put(buf, &dv->doc_id, sizeof(int));
+    error |= buffer_put(buf, &dv->num_lines, sizeof(int));
+    int has_offsets = dv->line_offsets != NULL;
+    error |= buffer_put(buf, &has_offsets, sizeof(int));
+    if (has_offsets) {
+        error |= buffer_put(buf, dv->line_offsets, sizeof(uint32_t) * (dv->num_lines + 1));
+    }
+    error |= buffer_put(buf, &dv->num_terms, sizeof(int));
+    for (int i = 0; i < dv->num_terms && !error; i++) {
+        // Conjuntos de linhas gravados no formato em memória
+        const Term *term = &terms[dv->term_ids[i]];
+        int size = dv->line_start[i + 1] - dv->line_start[i];
+        error |= buffer_put(buf, &term->len, sizeof(int));
+        error |= buffer_put(buf, term->text, term->len);
+        error |= buffer_put(buf, &size, sizeof(int));
+        error |= buffer_put(buf, dv->line_data + dv->line_start[i], size);
+    }
+    return error ? -1 : 0;
+}
+
+// Reescrever o ficheiro apenas com as versões vivas
+static int compact_log() {
+    char tmp_path[MAX_PATH_SIZE * 2 + 8];
+    sprintf(tmp_path, "%s.tmp", index_path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("Erro ao compactar índice");
+        return -1;
+    }
+
+    Buffer buf = {0};
+    int error = buffer_put(&buf, INDEX_MAGIC, 4);
+    for (int v = 0; v < num_versions && !error; v++) {
+        if (versions[v].doc_id == 0) {
+            continue;
+        }
+        error = serialize_version(&buf, &versions[v]);
+        if (!error && buf.len >= (1 << 20)) {
+            error = write_all(fd, buf.data, buf.len);
+            buf.len = 0;
+        }
+    }
+    if (!error) {
+        error = write_all(fd, buf.data, buf.len);
+    }
+    free(buf.data);
+    close(fd);
+
+    if (error || rename(tmp_path, index_path) == -1) {
+        perror("Erro ao compactar índice");
+        unlink(tmp_path);
+        return -1;
+    }
+
+    if (log_fd != -1) {
+        close(log_fd);
+    }
+    log_fd = open(index_path, O_WRONLY | O_APPEND);
+    dead_records = 0;
+    return 0;
+}
+
+static void maybe_compact() {
+    if (dead_records > COMPACT_MIN_DEAD && dead_records > live_docs) {
+        compact_log();
+    }
+}
+
+static int append_record(const Buffer *buf) {
+    if (log_fd == -1) {
+        return -1;
+    }
+    if (write_all(log_fd, buf->data, buf->len) < 0) {
+        perror("Erro ao escrever índice");
+        return -1;
+    }
+    return 0;
+}
+
+// Ler um inteiro do registo, verificando os limites
+static int parse_int(const char *data, size_t size, size_t *pos, int *value) {
+    if (*pos + sizeof(int) > size) {
+        return -1;
+    }
+    memcpy(value, data + *pos, sizeof(int));
+    *pos += sizeof(int);
+    return 0;
+}
+
+// Reconstruir um registo de adição; devolve -1 se estiver incompleto
+static int replay_add(const char *data, size_t size, size_t *pos) {
+    int doc_id, num_lines, has_offsets, count;
+    if (parse_int(data, size, pos, &doc_id) < 0 ||
+        parse_int(data, size, pos, &num_lines) < 0 || num_lines < 0 ||
+        parse_int(data, size, pos, &has_offsets) < 0) {
+        return -1;
+    }
+
+    DocTerms *dt = doc_terms_new();
+    if (!dt) {
+        return -1;
+    }
+    dt->num_lines = num_lines;
+
+    if (has_offsets) {
+        size_t offsets_size = sizeof(uint32_t) * ((size_t)num_lines + 1);
+        dt->offsets = (uint32_t*)malloc(offsets_size);
+        if (!dt->offsets || *pos + offsets_size > size) {
+            index_free_doc_terms(dt);
+            return -1;
+        }
+        memcpy(dt->offsets, data + *pos, offsets_size);
+        *pos += offsets_size;
+    }
+    if (parse_int(data, size, pos, &count) < 0 || count < 0) {
+        index_free_doc_terms(dt);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int len, set_size;
+        if (parse_int(data, size, pos, &len) < 0 || len <= 0 || *pos + len > size) {
+            index_free_doc_terms(dt);
+            return -1;
+        }
+        const char *text = data + *pos;
+        *pos += len;
+        if (parse_int(data, size, pos, &set_size) < 0 || set_size < 0 ||
+            (uint32_t)set_size > line_bitmap_size(num_lines) || *pos + set_size > size) {
+            index_free_doc_terms(dt);
+            return -1;
+        }
+
+        LocalTerm *term = doc_terms_push(dt, text, len, hash_bytes(text, len));
+        if (!term) {
+            index_free_doc_terms(dt);
+            return -1;
+        }
+        int max_lines = line_set_is_bitmap(set_size, num_lines) ? num_lines : set_size / 2;
+        term->lines = (int*)malloc(sizeof(int) * (max_lines + 1));
+        int nlines = term->lines ? line_set_decode((const unsigned char*)data + *pos, set_size, num_lines, term->lines) : -1;
+        if (nlines < 0) {
+            index_free_doc_terms(dt);
+            return -1;
+        }
+        term->num_lines = term->cap_lines = nlines;
+        *pos += set_size;
+    }
+
+    if (index_has_document(doc_id)) {
+        dead_records++; // A versão anterior deixa de contar
+    }
+    int result = insert_version(doc_id, dt);
+    index_free_doc_terms(dt);
+    return result;
+}
+
+static int load_log() {
+    int fd = open(index_path, O_RDONLY);
+    if (fd == -1) {
+        return 0; // Ficheiro não existe, não é erro
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    char *data = (char*)malloc(size + 1);
+    if (!data) {
+        close(fd);
+        return -1;
+    }
+
+    size_t total = 0;
+    while (total < size) {
+        ssize_t bytes_read = read(fd, data + total, size - total);
+        if (bytes_read <= 0) {
+            break;
+        }
+        total += bytes_read;
+    }
+    close(fd);
+    size = total;
+
+    if (size < 4 || memcmp(data, INDEX_MAGIC, 4) != 0) {
+        free(data);
+        fprintf(stderr, "Ficheiro de índice inválido, a reconstruir\n");
+        return 0;
+    }
+
+    size_t pos = 4;
+    size_t good = pos;
+    while (pos < size) {
+        char type = data[pos++];
+        if (type == REC_ADD) {
+            if (replay_add(data, size, &pos) < 0) {
+                break;
+            }
+        } else if (type == REC_DEL) {
+            int doc_id;
+            if (parse_int(data, size, &pos, &doc_id) < 0) {
+                break;
+            }
+            remove_version(doc_id);
+            dead_records += 2;
+        } else {
+            break;
+        }
+        good = pos;
+    }
+    free(data);
+
+    // Registo final incompleto (ex.: falha a meio de uma escrita)
+    if (good < size) {
+        fprintf(stderr, "Índice truncado em %zu bytes\n", good);
+        if (truncate(index_path, good) == -1) {
+            perror("Erro ao truncar índice");
+        }
+    }
+    return 1;
+}
+
+int index_init(const char *document_folder) {
+    sprintf(index_path, "%s/%s", document_folder, INDEX_FILE);
+
+    if (intmap_init(&doc_versions, 1024) < 0 || intmap_init(&gram_map, 1024) < 0) {
+        return -1;
+    }
+
+    int loaded = load_log();
+    if (loaded < 0) {
+        return -1;
+    }
+
+    if (!loaded) {
+        // Criar ficheiro novo (ou substituir um inválido)
+        if (compact_log() < 0) {
+            return -1;
+        }
+    } else {
+        log_fd = open(index_path, O_WRONLY | O_APPEND);
+        if (log_fd == -1) {
+            perror("Erro ao abrir índice");
+            return -1;
+        }
+        maybe_compact();
+    }
+
+    index_ready = 1;
+    return 0;
+}
+
+void index_close() {
+    index_ready = 0;
+    if (log_fd != -1) {
+        close(log_fd);
+        log_fd = -1;
+    }
+
+    for (int t = 0; t < num_terms; t++) {
+        free(terms[t].text);
+        free(terms[t].postings);
+    }
+    free(terms);
+    free(term_table);
+    terms = NULL;
+    term_table = NULL;
+    num_terms = cap_terms = term_table_cap = 0;
+
+    for (int g = 0; g < num_grams; g++) {
+        free(grams[g].term_ids);
+    }
+    free(grams);
+    grams = NULL;
+    num_grams = cap_grams = 0;
+    grams_complete = 1;
+    intmap_free(&gram_map);
+
+    for (int v = 0; v < num_versions; v++) {
+        free(versions[v].term_ids);
+        free(versions[v].line_start);
+        free(versions[v].line_data);
+        free(versions[v].line_offsets);
+    }
+    free(versions);
+    versions = NULL;
+    num_versions = cap_versions = 0;
+    live_docs = 0;
+    total_postings = dead_postings = 0;
+    dead_versions = 0;
+    intmap_free(&doc_versions);
+}
+
+int index_insert(int doc_id, DocTerms *dt) {
+    int replaced = index_has_document(doc_id);
+    if (insert_version(doc_id, dt) < 0) {
+        index_free_doc_terms(dt);
+        return -1;
+    }
+    index_free_doc_terms(dt);
+
+    int ver;
+    intmap_get(&doc_versions, doc_id, &ver);
+
+    Buffer buf = {0};
+    if (serialize_version(&buf, &versions[ver]) == 0) {
+        append_record(&buf);
+    }
+    free(buf.data);
+
+    if (replaced) {
+        dead_records++;
+        maybe_compact();
+    }
+    return 0;
+}
+
+int index_add_document(int doc_id, const char *filepath) {
+    DocTerms *dt = index_tokenize_file(filepath);
+    if (!dt) {
+        return -1;
+    }
+    return index_insert(doc_id, dt);
+}
+
+int index_remove_document(int doc_id) {
+    if (!index_ready || remove_version(doc_id) < 0) {
+        return -1;
+    }
+
+    char record[1 + sizeof(int)];
+    record[0] = REC_DEL;
+    memcpy(record + 1, &doc_id, sizeof(int));
+    Buffer buf = { record, sizeof(record), sizeof(record) };
+    append_record(&buf);
+
+    dead_records += 2;
+    maybe_compact();
+    return 0;
+}
+
+void index_retain(int (*keep)(int doc_id)) {
+    for (int v = 0; v < num_versions; v++) {
+        if (versions[v].doc_id != 0 && !keep(versions[v].doc_id)) {
+            int before = num_versions;
+            index_remove_document(versions[v].doc_id);
+            if (num_versions != before) {
+                v = -1; // As versões foram compactadas: recomeçar
+            }
+        }
+    }
+}
+
+int index_has_document(int doc_id) {
+    return intmap_get(&doc_versions, doc_id, NULL) == 0;
+}
+
+int index_num_documents() {
+    return live_docs;
+}
+
+int index_max_doc_id() {
+    int max_id = 0;
+    for (int v = 0; v < num_versions; v++) {
+        if (versions[v].doc_id > max_id) {
+            max_id = versions[v].doc_id;
+        }
+    }
+    return max_id;
+}
+
+// ---------------------------------------------------------------------------
+// Consultas
+// ---------------------------------------------------------------------------
+
+int index_can_answer(const char *keyword) {
+    if (!index_ready || keyword[0] == '\0') {
+        return 0;
+    }
+    for (const char *p = keyword; *p; p++) {
+        if (!is_term_char((unsigned char)*p)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+int index_search(const char *keyword, int *doc_ids, int max_results) {
+    int len = strlen(keyword);
+    int *found = NULL;
+    int num_found = 0;
+    int cap_found = 0;
+
+    // Termos candidatos: os do trigrama mais raro da palavra-chave (entre
+    // eles o próprio termo, se existir), ou o vocabulário todo
+    const int *candidates = NULL;
+    int num_candidates = num_terms;
+    if (len >= 3 && grams_complete) {
+        for (int i = 0; i + 3 <= len; i++) {
+            int g;
+            if (intmap_get(&gram_map, gram_key(keyword + i), &g) < 0 || grams[g].count == 0) {
+                return 0; // Nenhum termo tem este trigrama
+            }
+            if (!candidates || grams[g].count < num_candidates) {
+                candidates = grams[g].term_ids;
+                num_candidates = grams[g].count;
+            }
+        }
+    }
+
+    // Todos os termos que contêm a palavra-chave
+    for (int c = 0; c < num_candidates; c++) {
+        Term *term = &terms[candidates ? candidates[c] : c];
+        if (term->len < len || !memmem(term->text, term->len, keyword, len)) {
+            continue;
+        }
+        for (int i = 0; i < term->num_postings; i++) {
+            int doc_id = versions[term->postings[i]].doc_id;
+            if (doc_id == 0) {
+                continue;
+            }
+            int *grown = (int*)grow_array(found, &cap_found, num_found + 1, sizeof(int));
+            if (!grown) {
+                free(found);
+                return -1;
+            }
+            found = grown;
+            found[num_found++] = doc_id;
+        }
+    }
+
+    // Ordenar e remover duplicados
+    qsort(found, num_found, sizeof(int), compare_ints);
+    int count = 0;
+    for (int i = 0; i < num_found && count < max_results; i++) {
+        if (i == 0 || found[i] != found[i - 1]) {
+            doc_ids[count++] = found[i];
+        }
+    }
+
+    free(found);
+    return count;
+}
+
+// O termo pode conter 'piece' tendo em conta os separadores à volta dele na
+// palavra-chave: um separador antes obriga o termo a começar por 'piece', um
+// separador depois obriga-o a terminar em 'piece'
+static int term_matches_piece(const Term *term, const char *piece, int len, int at_start, int at_end) {
+    if (term->len < len) {
+        return 0;
+    }
+    if (at_start && at_end) {
+        return term->len == len && memcmp(term->text, piece, len) == 0;
+    }
+    if (at_start) {
+        return memcmp(term->text, piece, len) == 0;
+    }
+    if (at_end) {
+        return memcmp(term->text + term->len - len, piece, len) == 0;
+    }
+    return memmem(term->text, term->len, piece, len) != NULL;
+}
+
+// União das linhas dos termos do documento que aceitam 'piece'; 0 se nenhum
+static int union_piece_lines(const DocVersion *dv, const char *piece, int len,
+                             int at_start, int at_end, uint64_t *bits) {
+    int matched = 0;
+    for (int i = 0; i < dv->num_terms; i++) {
+        if (term_matches_piece(&terms[dv->term_ids[i]], piece, len, at_start, at_end)) {
+            line_set_or(dv, i, bits);
+            matched = 1;
+        }
+    }
+    return matched;
+}
+
+static int count_bits(const uint64_t *bits, int words) {
+    int count = 0;
+    for (int w = 0; w < words; w++) {
+        count += __builtin_popcountll(bits[w]);
+    }
+    return count;
+}
+
+// Palavra-chave que é um termo: contagem exata a partir dos conjuntos de linhas
+static int count_term_lines(const DocVersion *dv, const char *keyword) {
+    int len = strlen(keyword);
+    int first = -1;
+    uint64_t *bits = NULL;
+    int words = (dv->num_lines + 63) / 64;
+
+    for (int i = 0; i < dv->num_terms; i++) {
+        Term *term = &terms[dv->term_ids[i]];
+        if (term->len < len || !memmem(term->text, term->len, keyword, len)) {
+            continue;
+        }
+        if (first == -1) {
+            // Caso comum: um único termo, as linhas já são distintas
+            first = i;
+            continue;
+        }
+        // Vários termos: união das linhas num mapa de bits
+        if (!bits) {
+            bits = (uint64_t*)calloc(words + 1, sizeof(uint64_t));
+            if (!bits) {
+                return INDEX_UNKNOWN;
+            }
+            line_set_or(dv, first, bits);
+        }
+        line_set_or(dv, i, bits);
+    }
+
+    if (first == -1) {
+        return 0;
+    }
+    if (!bits) {
+        return line_set_count(dv, first);
+    }
+    int count = count_bits(bits, words);
+    free(bits);
+    return count;
+}
+
+// Palavra-chave com separadores: as linhas candidatas são as que contêm um
+// termo compatível com cada pedaço alfanumérico; só essas linhas são lidas
+static int candidate_lines(const DocVersion *dv, const char *keyword, LineRanges *candidates) {
+    int len = strlen(keyword);
+    int words = (dv->num_lines + 63) / 64;
+    uint64_t *result = (uint64_t*)malloc(sizeof(uint64_t) * (words + 1));
+    uint64_t *piece_bits = (uint64_t*)malloc(sizeof(uint64_t) * (words + 1));
+    if (!result || !piece_bits) {
+        free(result);
+        free(piece_bits);
+        return INDEX_UNKNOWN;
+    }
+    memset(result, 0xff, sizeof(uint64_t) * words);
+
+    int pieces = 0;
+    int empty = 0;
+    for (int start = 0; start < len && !empty; ) {
+        if (!is_term_char((unsigned char)keyword[start])) {
+            start++;
+            continue;
+        }
+        int end = start;
+        while (end < len && is_term_char((unsigned char)keyword[end])) {
+            end++;
+        }
+        memset(piece_bits, 0, sizeof(uint64_t) * words);
+        if (!union_piece_lines(dv, keyword + start, end - start, start > 0, end < len, piece_bits)) {
+            empty = 1;
+        }
+        for (int w = 0; w < words; w++) {
+            result[w] &= piece_bits[w];
+        }
+        pieces++;
+        start = end;
+    }
+    free(piece_bits);
+
+    int count = pieces > 0 ? count_bits(result, words) : 0;
+    if (pieces == 0 || (count > 0 && (!dv->line_offsets || (count > 16 && count * 4 > dv->num_lines)))) {
+        // Sem pedaços alfanuméricos, ou demasiadas candidatas: ler o ficheiro todo
+        free(result);
+        return INDEX_UNKNOWN;
+    }
+    if (empty || count == 0) {
+        free(result);
+        return 0;
+    }
+
+    candidates->ranges = (uint32_t*)malloc(sizeof(uint32_t) * 2 * count);
+    if (!candidates->ranges) {
+        free(result);
+        return INDEX_UNKNOWN;
+    }
+    candidates->count = 0;
+    for (int w = 0; w < words; w++) {
+        uint64_t word = result[w];
+        while (word) {
+            int line = w * 64 + __builtin_ctzll(word);
+            candidates->ranges[2 * candidates->count] = dv->line_offsets[line];
+            candidates->ranges[2 * candidates->count + 1] = dv->line_offsets[line + 1];
+            candidates->count++;
+            word &= word - 1;
+        }
+    }
+    free(result);
+    return INDEX_VERIFY;
+}
+
+int index_count_lines(int doc_id, const char *keyword, LineRanges *candidates) {
+    int ver;
+    if (intmap_get(&doc_versions, doc_id, &ver) < 0) {
+        return -1;
+    }
+    if (!index_ready || keyword[0] == '\0' || strchr(keyword, '\n')) {
+        return INDEX_UNKNOWN;
+    }
+
+    DocVersion *dv = &versions[ver];
+    if (index_can_answer(keyword)) {
+        return count_term_lines(dv, keyword);
+    }
+    return candidate_lines(dv, keyword, candidates);
+}
+
+int index_verify_lines(const char *filepath, const char *keyword, LineRanges *candidates) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1) {
+        free(candidates->ranges);
+        return -2;
+    }
+    stats_add(STAT_FILES_OPENED, 1);
+
+    size_t len = strlen(keyword);
+    char *line = NULL;
+    size_t cap = 0;
+    int count = 0;
+    for (int i = 0; i < candidates->count; i++) {
+        uint32_t start = candidates->ranges[2 * i];
+        size_t size = candidates->ranges[2 * i + 1] - start;
+        if (size > cap) {
+            char *bigger = (char*)realloc(line, size);
+            if (!bigger) {
+                count = -2;
+                break;
+            }
+            line = bigger;
+            cap = size;
+        }
+        ssize_t got = pread(fd, line, size, start);
+        if (got <= 0) {
+            continue;
+        }
+        stats_add(STAT_BYTES_SCANNED, got);
+        if (scan_find(line, got, keyword, len)) {
+            count++;
+        }
+    }
+
+    close(fd);
+    free(line);
+    free(candidates->ranges);
+    candidates->ranges = NULL;
+    return count;
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "journal.h"
+
+#define JOURNAL_FILE ".index_journal"
+#define REC_ADD 'A'
+#define REC_DEL 'D'
+
+// Cabeçalho de cada registo, seguido de 'length' bytes de dados
+typedef struct {
+    int type;
+    int length;
+    unsigned int checksum;   // FNV-1a dos dados, deteta registos rasgados
+} RecordHeader;
+
+static char journal_path[MAX_PATH_SIZE * 2];
+static int journal_fd = -1;
+static int num_records = 0;
+static int pending_records = 0;        // Escritos mas ainda sem fsync
+static struct timespec first_pending;  // Instante do registo pendente mais antigo
+static long appended_seq = 0;          // Registos escritos desde o arranque
+static long synced_seq = 0;            // Registos escritos e já sincronizados
+static int sync_running = 0;           // Um fdatasync em curso, fora do mutex
+static int waiting_writers = 0;        // Pedidos em journal_commit
+static pthread_mutex_t journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_synced = PTHREAD_COND_INITIALIZER;
+
+static unsigned int checksum(const char *data, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+int journal_open(const char *document_folder) {
+    sprintf(journal_path, "%s/%s", document_folder, JOURNAL_FILE);
+
+    journal_fd = open(journal_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journal_fd == -1) {
+        perror("Erro ao abrir diário");
+        return -1;
+    }
+    return 0;
+}
+
+void journal_close() {
+    if (journal_fd != -1) {
+        journal_sync(1);
+        close(journal_fd);
+        journal_fd = -1;
+    }
+}
+
+int journal_replay(void (*on_add)(const Document *doc), void (*on_delete)(int doc_id)) {
+    int fd = open(journal_path, O_RDONLY);
+    if (fd == -1) {
+        return 0; // Sem diário, nada a reaplicar
+    }
+
+    off_t good = 0;
+    num_records = 0;
+
+    RecordHeader header;
+    char payload[sizeof(Document)];
+    while (read(fd, &header, sizeof(header)) == sizeof(header)) {
+        if (header.length < 0 || header.length > (int)sizeof(payload) ||
+            read(fd, payload, header.length) != header.length ||
+            checksum(payload, header.length) != header.checksum) {
+            break;
+        }
+
+        if (header.type == REC_ADD && header.length == sizeof(Document)) {
+            on_add((const Document*)payload);
+        } else if (header.type == REC_DEL && header.length == sizeof(int)) {
+            int doc_id;
+            memcpy(&doc_id, payload, sizeof(int));
+            on_delete(doc_id);
+        } else {
+            break;
+        }
+
+        num_records++;
+        good += sizeof(header) + header.length;
+    }
+
+    // Descartar um registo final incompleto (falha a meio de uma escrita)
+    off_t size = lseek(fd, 0, SEEK_END);
+    close(fd);
+    if (size > good) {
+        fprintf(stderr, "Diário truncado em %ld bytes\n", (long)good);
+        if (truncate(journal_path, good) == -1) {
+            perror("Erro ao truncar diário");
+        }
+    }
+    return num_records;
+}
+
+static int append_record(int type, const void *data, int length) {
+    if (journal_fd == -1) {
+        return -1;
+    }
+
+    // Cabeçalho e dados numa única escrita (O_APPEND)
+    char record[sizeof(RecordHeader) + sizeof(Document)];
+    RecordHeader header = { type, length, checksum((const char*)data, length) };
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), data, length);
+
+    ssize_t size = sizeof(header) + length;
+    pthread_mutex_lock(&journal_mutex);
+    if (write(journal_fd, record, size) != size) {
+        pthread_mutex_unlock(&journal_mutex);
+        perror("Erro ao escrever no diário");
+        return -1;
+    }
+
+    if (pending_records++ == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &first_pending);
+    }
+    num_records++;
+    appended_seq++;
+    pthread_mutex_unlock(&journal_mutex);
+    return 0;
+}
+
+int journal_append_add(const Document *doc) {
+    return append_record(REC_ADD, doc, sizeof(Document));
+}
+
+int journal_append_delete(int doc_id) {
+    return append_record(REC_DEL, &doc_id, sizeof(int));
+}
+
+int journal_records() {
+    pthread_mutex_lock(&journal_mutex);
+    int records = num_records;
+    pthread_mutex_unlock(&journal_mutex);
+    return records;
+}
+
+int journal_reset() {
+    if (journal_fd == -1) {
+        return -1;
+    }
+    pthread_mutex_lock(&journal_mutex);
+    if (ftruncate(journal_fd, 0) == -1) {
+        pthread_mutex_unlock(&journal_mutex);
+        perror("Erro ao esvaziar diário");
+        return -1;
+    }
+    fsync(journal_fd);
+    num_records = 0;
+    pending_records = 0;
+    // O snapshot acabado de gravar já contém todos os registos
+    synced_seq = appended_seq;
+    pthread_cond_broadcast(&journal_synced);
+    pthread_mutex_unlock(&journal_mutex);
+    return 0;
+}
+
+// O lote pendente já devia ser sincronizado (chamada com journal_mutex)
+static int batch_due() {
+    return pending_records >= JOURNAL_GROUP_RECORDS || elapsed_ms(&first_pending) >= JOURNAL_GROUP_MS;
+}
+
+// Sincronizar os registos pendentes; chamada com journal_mutex e sem outro
+// fdatasync em curso, que é feito fora do mutex
+static int sync_batch() {
+    // Os registos que chegarem durante o fsync ficam para o lote seguinte
+    int batch = pending_records;
+    long target = appended_seq;
+    int fd = journal_fd;
+    sync_running = 1;
+    pthread_mutex_unlock(&journal_mutex);
+
+    int result = fdatasync(fd);
+    if (result == -1) {
+        perror("Erro ao sincronizar diário");
+    }
+
+    pthread_mutex_lock(&journal_mutex);
+    sync_running = 0;
+    if (result == 0) {
+        if (target > synced_seq) {
+            synced_seq = target;
+        }
+        pending_records -= batch;
+        if (pending_records < 0) {
+            pending_records = 0; // O diário foi esvaziado entretanto
+        } else if (pending_records > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &first_pending);
+        }
+    }
+    pthread_cond_broadcast(&journal_synced);
+    return result;
+}
+
+int journal_sync(int force) {
+    pthread_mutex_lock(&journal_mutex);
+    while (force && sync_running) {
+        pthread_cond_wait(&journal_synced, &journal_mutex);
+    }
+    int result = 0;
+    if (journal_fd != -1 && pending_records > 0 && !sync_running && (force || batch_due())) {
+        result = sync_batch();
+    }
+    pthread_mutex_unlock(&journal_mutex);
+    return result;
+}
+
+int journal_commit(atomic_int *writers) {
+    pthread_mutex_lock(&journal_mutex);
+    long target = appended_seq;
+    int result = 0;
+    waiting_writers++;
+    while (synced_seq < target && journal_fd != -1) {
+        // Lote cheio ou expirado, ou todos os que podiam juntar-se já estão à espera
+        if (!sync_running && (batch_due() || waiting_writers >= atomic_load(writers))) {
+            if ((result = sync_batch()) < 0) {
+                break;
+            }
+            continue;
+        }
+        if (sync_running) {
+            pthread_cond_wait(&journal_synced, &journal_mutex);
+            continue;
+        }
+        // Esperar pelo prazo do lote (ou por quem sincronizar antes)
+        long remaining = JOURNAL_GROUP_MS - elapsed_ms(&first_pending);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (remaining > 0 ? remaining : 1) * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&journal_synced, &journal_mutex, &deadline);
+    }
+    waiting_writers--;
+    pthread_mutex_unlock(&journal_mutex);
+    return result;
+}
+
+int journal_sync_timeout() {
+    pthread_mutex_lock(&journal_mutex);
+    long remaining = -1;
+    if (pending_records > 0) {
+        remaining = JOURNAL_GROUP_MS - elapsed_ms(&first_pending);
+        if (remaining < 0) {
+            remaining = 0;
+        }
+    }
+    pthread_mutex_unlock(&journal_mutex);
+    return (int)remaining;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "manifest.h"
+
+#define MANIFEST_BUFFER_SIZE (64 * 1024)
+
+int manifest_open(ManifestReader *reader, int fd) {
+    reader->buffer = (char*)malloc(MANIFEST_BUFFER_SIZE + 1);
+    if (!reader->buffer) {
+        return -1;
+    }
+    reader->fd = fd;
+    reader->start = reader->end = 0;
+    reader->line_number = 0;
+    reader->eof = 0;
+    reader->skipping = 0;
+    return 0;
+}
+
+void manifest_close(ManifestReader *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
+
+// Ler mais dados para o fim do buffer, mantendo a linha incompleta no início
+static void fill_buffer(ManifestReader *reader) {
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+
+    ssize_t bytes_read;
+    do {
+        bytes_read = read(reader->fd, reader->buffer + reader->end, MANIFEST_BUFFER_SIZE - reader->end);
+    } while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read <= 0) {
+        reader->eof = 1;
+    } else {
+        reader->end += bytes_read;
+    }
+}
+
+// Próximo campo, terminado por 'delimiter'; campos CSV podem vir entre aspas
+static char *next_field(char **cursor, char delimiter) {
+    char *p = *cursor;
+    if (!p) {
+        return NULL;
+    }
+
+    char *field = p;
+    if (delimiter == ',' && *p == '"') {
+        // Campo entre aspas: "" representa uma aspa; o texto é compactado no lugar
+        char *out = field;
+        p++;
+        while (*p) {
+            if (*p == '"') {
+                if (p[1] == '"') {
+                    *out++ = '"';
+                    p += 2;
+                    continue;
+                }
+                p++;
+                break;
+            }
+            *out++ = *p++;
+        }
+        if (*p != '\0' && *p != delimiter) {
+            return NULL; // Texto depois das aspas finais
+        }
+        *cursor = *p ? p + 1 : NULL;
+        *out = '\0';
+        return field;
+    }
+
+    char *end = strchr(p, delimiter);
+    if (end) {
+        *end = '\0';
+        *cursor = end + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return field;
+}
+
+static int copy_field(char *dest, const char *field, size_t size) {
+    if (!field || strlen(field) >= size) {
+        return -1;
+    }
+    strcpy(dest, field);
+    return 0;
+}
+
+int manifest_parse_line(char *line, Document *doc) {
+    char delimiter = strchr(line, '\t') ? '\t' : ',';
+    char *cursor = line;
+    memset(doc, 0, sizeof(Document));
+
+    if (copy_field(doc->title, next_field(&cursor, delimiter), MAX_TITLE_SIZE) < 0 ||
+        copy_field(doc->authors, next_field(&cursor, delimiter), MAX_AUTHORS_SIZE) < 0 ||
+        copy_field(doc->year, next_field(&cursor, delimiter), MAX_YEAR_SIZE) < 0 ||
+        copy_field(doc->path, next_field(&cursor, delimiter), MAX_PATH_SIZE) < 0) {
+        return -1;
+    }
+    if (cursor != NULL || doc->path[0] == '\0') {
+        return -1; // Campos a mais ou caminho vazio
+    }
+    return 0;
+}
+
+int manifest_next(ManifestReader *reader, Document *doc, int *line_number) {
+    while (1) {
+        char *line = reader->buffer + reader->start;
+        char *newline = (char*)memchr(line, '\n', reader->end - reader->start);
+
+        if (reader->skipping) {
+            // Resto de uma linha longa já dada como inválida
+            if (newline) {
+                reader->start = newline + 1 - reader->buffer;
+                reader->skipping = 0;
+            } else if (reader->eof) {
+                return -1;
+            } else {
+                reader->start = reader->end;
+                fill_buffer(reader);
+            }
+            continue;
+        }
+
+        if (!newline) {
+            if (reader->end - reader->start >= MANIFEST_MAX_LINE) {
+                reader->line_number++;
+                *line_number = reader->line_number;
+                reader->skipping = 1;
+                return 0;
+            }
+            if (!reader->eof) {
+                fill_buffer(reader);
+                continue;
+            }
+            if (reader->start == reader->end) {
+                return -1;
+            }
+            // Última linha sem '\n'
+            newline = reader->buffer + reader->end;
+        }
+
+        *newline = '\0';
+        reader->start = (newline - reader->buffer) + (newline < reader->buffer + reader->end ? 1 : 0);
+        reader->line_number++;
+        *line_number = reader->line_number;
+
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r') {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        return manifest_parse_line(line, doc) == 0 ? 1 : 0;
+    }
+}
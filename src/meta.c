@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "meta.h"
+
+#define FIELD_TITLE 0
+#define FIELD_AUTHORS 1
+#define FIELD_ANY 2         // Só em consultas: título ou autores
+
+// Lista ordenada de IDs
+typedef struct {
+    int *ids;
+    int count;
+    int capacity;
+} IdList;
+
+typedef struct TokenEntry {
+    char *text;
+    uint32_t hash;
+    int field;
+    IdList docs;
+    struct TokenEntry *next;
+} TokenEntry;
+
+static TokenEntry **buckets = NULL;
+static int num_buckets = 0;         // Sempre uma potência de 2
+static int num_tokens = 0;
+
+// Índice dos anos: pares (ano, ID) ordenados
+typedef struct {
+    int year;
+    int id;
+} YearEntry;
+
+static YearEntry *years = NULL;
+static int num_years = 0;
+static int cap_years = 0;
+
+static int built = 0;
+static pthread_mutex_t meta_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ---------------------------------------------------------------------------
+// Listas de IDs
+// ---------------------------------------------------------------------------
+
+// Posição do primeiro ID >= id
+static int list_lower_bound(const IdList *list, int id) {
+    int lo = 0, hi = list->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (list->ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int list_insert(IdList *list, int id) {
+    int pos = list_lower_bound(list, id);
+    if (pos < list->count && list->ids[pos] == id) {
+        return 0; // Token repetido no mesmo documento
+    }
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 4;
+        int *grown = (int*)realloc(list->ids, sizeof(int) * capacity);
+        if (!grown) {
+            return -1;
+        }
+        list->ids = grown;
+        list->capacity = capacity;
+    }
+    memmove(list->ids + pos + 1, list->ids + pos, sizeof(int) * (list->count - pos));
+    list->ids[pos] = id;
+    list->count++;
+    return 0;
+}
+
+static void list_remove(IdList *list, int id) {
+    int pos = list_lower_bound(list, id);
+    if (pos < list->count && list->ids[pos] == id) {
+        memmove(list->ids + pos, list->ids + pos + 1, sizeof(int) * (list->count - pos - 1));
+        list->count--;
+    }
+}
+
+// result = result ∩ other (*all = ainda nenhum critério: todos os documentos)
+static int list_intersect(IdList *result, int *all, const int *other, int count) {
+    if (*all) {
+        result->ids = (int*)malloc(sizeof(int) * (count + 1));
+        if (!result->ids) {
+            return -1;
+        }
+        if (count > 0) {
+            memcpy(result->ids, other, sizeof(int) * count);
+        }
+        result->count = result->capacity = count;
+        *all = 0;
+        return 0;
+    }
+    int n = 0;
+    for (int i = 0, j = 0; i < result->count && j < count; ) {
+        if (result->ids[i] < other[j]) {
+            i++;
+        } else if (result->ids[i] > other[j]) {
+            j++;
+        } else {
+            result->ids[n++] = result->ids[i];
+            i++;
+            j++;
+        }
+    }
+    result->count = n;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Tokens
+// ---------------------------------------------------------------------------
+
+static int is_token_char(unsigned char c) {
+    return isalnum(c) || c >= 0x80;
+}
+
+// Função de dispersão FNV-1a
+static uint32_t hash_token(const char *text, int field) {
+    uint32_t hash = 2166136261u ^ (uint32_t)field;
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static TokenEntry *find_token(const char *text, int field, uint32_t hash) {
+    if (!buckets) {
+        return NULL;
+    }
+    for (TokenEntry *entry = buckets[hash & (num_buckets - 1)]; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->field == field && strcmp(entry->text, text) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void grow_buckets() {
+    int new_size = num_buckets * 2;
+    TokenEntry **new_buckets = (TokenEntry**)calloc(new_size, sizeof(TokenEntry*));
+    if (!new_buckets) {
+        return; // Continua a funcionar, só com cadeias mais longas
+    }
+    for (int i = 0; i < num_buckets; i++) {
+        TokenEntry *entry = buckets[i];
+        while (entry) {
+            TokenEntry *next = entry->next;
+            entry->next = new_buckets[entry->hash & (new_size - 1)];
+            new_buckets[entry->hash & (new_size - 1)] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_size;
+}
+
+static TokenEntry *add_token(const char *text, int field, uint32_t hash) {
+    TokenEntry *entry = (TokenEntry*)calloc(1, sizeof(TokenEntry));
+    if (!entry || !(entry->text = strdup(text))) {
+        free(entry);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->field = field;
+    if (num_tokens + 1 > num_buckets) {
+        grow_buckets();
+    }
+    TokenEntry **bucket = &buckets[hash & (num_buckets - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    num_tokens++;
+    return entry;
+}
+
+static void drop_token(TokenEntry *entry) {
+    TokenEntry **link = &buckets[entry->hash & (num_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    num_tokens--;
+    free(entry->text);
+    free(entry->docs.ids);
+    free(entry);
+}
+
+// Próximo token de *text em minúsculas (em 'token', com pelo menos
+// strlen(*text) + 1 bytes); 0 quando não há mais
+static int next_token(const char **text, char *token) {
+    const unsigned char *p = (const unsigned char*)*text;
+    while (*p && !is_token_char(*p)) {
+        p++;
+    }
+    int len = 0;
+    while (*p && is_token_char(*p)) {
+        token[len++] = (char)tolower(*p);
+        p++;
+    }
+    token[len] = '\0';
+    *text = (const char*)p;
+    return len;
+}
+
+typedef int (*TokenFn)(const char *token, int field, int id);
+
+static int for_each_token(const char *text, int field, int id, TokenFn fn) {
+    char token[MAX_TITLE_SIZE + MAX_AUTHORS_SIZE];
+    int error = 0;
+    while (next_token(&text, token) > 0) {
+        error |= fn(token, field, id);
+    }
+    return error;
+}
+
+static int index_token(const char *token, int field, int id) {
+    uint32_t hash = hash_token(token, field);
+    TokenEntry *entry = find_token(token, field, hash);
+    if (!entry && !(entry = add_token(token, field, hash))) {
+        return -1;
+    }
+    return list_insert(&entry->docs, id);
+}
+
+static int unindex_token(const char *token, int field, int id) {
+    uint32_t hash = hash_token(token, field);
+    TokenEntry *entry = find_token(token, field, hash);
+    if (entry) {
+        list_remove(&entry->docs, id);
+        if (entry->docs.count == 0) {
+            drop_token(entry);
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Anos
+// ---------------------------------------------------------------------------
+
+// Ano só com dígitos; -1 se não é um ano
+static int parse_year(const char *text, int len) {
+    if (len <= 0 || len > 9) {
+        return -1;
+    }
+    int year = 0;
+    for (int i = 0; i < len; i++) {
+        if (!isdigit((unsigned char)text[i])) {
+            return -1;
+        }
+        year = year * 10 + (text[i] - '0');
+    }
+    return year;
+}
+
+// Posição do primeiro par >= (year, id)
+static int year_lower_bound(int year, int id) {
+    int lo = 0, hi = num_years;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (years[mid].year < year || (years[mid].year == year && years[mid].id < id)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int index_year(int year, int id) {
+    if (num_years == cap_years) {
+        int capacity = cap_years > 0 ? cap_years * 2 : 256;
+        YearEntry *grown = (YearEntry*)realloc(years, sizeof(YearEntry) * capacity);
+        if (!grown) {
+            return -1;
+        }
+        years = grown;
+        cap_years = capacity;
+    }
+    int pos = year_lower_bound(year, id);
+    memmove(years + pos + 1, years + pos, sizeof(YearEntry) * (num_years - pos));
+    years[pos].year = year;
+    years[pos].id = id;
+    num_years++;
+    return 0;
+}
+
+static void unindex_year(int year, int id) {
+    int pos = year_lower_bound(year, id);
+    if (pos < num_years && years[pos].year == year && years[pos].id == id) {
+        memmove(years + pos, years + pos + 1, sizeof(YearEntry) * (num_years - pos - 1));
+        num_years--;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Manutenção
+// ---------------------------------------------------------------------------
+
+// Chamada com meta_mutex
+static int add_locked(const Document *doc) {
+    int error = for_each_token(doc->title, FIELD_TITLE, doc->id, index_token);
+    error |= for_each_token(doc->authors, FIELD_AUTHORS, doc->id, index_token);
+    int year = parse_year(doc->year, strlen(doc->year));
+    if (year >= 0) {
+        error |= index_year(year, doc->id);
+    }
+    return error ? -1 : 0;
+}
+
+static void free_locked() {
+    for (int i = 0; i < num_buckets; i++) {
+        TokenEntry *entry = buckets[i];
+        while (entry) {
+            TokenEntry *next = entry->next;
+            free(entry->text);
+            free(entry->docs.ids);
+            free(entry);
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = NULL;
+    num_buckets = 0;
+    num_tokens = 0;
+    free(years);
+    years = NULL;
+    num_years = cap_years = 0;
+    built = 0;
+}
+
+int meta_build(int num_documents, MetaDocFn get) {
+    pthread_mutex_lock(&meta_mutex);
+    if (built) {
+        pthread_mutex_unlock(&meta_mutex);
+        return 0;
+    }
+
+    num_buckets = 1024;
+    while (num_buckets < num_documents * 2) {
+        num_buckets *= 2;
+    }
+    buckets = (TokenEntry**)calloc(num_buckets, sizeof(TokenEntry*));
+    int error = !buckets;
+    for (int i = 0; i < num_documents && !error; i++) {
+        Document doc;
+        get(i, &doc);
+        error = add_locked(&doc) < 0;
+    }
+    if (error) {
+        perror("Erro ao construir os índices de metadados");
+        free_locked();
+        pthread_mutex_unlock(&meta_mutex);
+        return -1;
+    }
+    built = 1;
+    pthread_mutex_unlock(&meta_mutex);
+    return 0;
+}
+
+int meta_ready() {
+    pthread_mutex_lock(&meta_mutex);
+    int ready = built;
+    pthread_mutex_unlock(&meta_mutex);
+    return ready;
+}
+
+int meta_add_document(const Document *doc) {
+    pthread_mutex_lock(&meta_mutex);
+    int result = 0;
+    if (built && add_locked(doc) < 0) {
+        // Índices incompletos: reconstruir na próxima consulta
+        free_locked();
+        result = -1;
+    }
+    pthread_mutex_unlock(&meta_mutex);
+    return result;
+}
+
+void meta_remove_document(const Document *doc) {
+    pthread_mutex_lock(&meta_mutex);
+    if (built) {
+        for_each_token(doc->title, FIELD_TITLE, doc->id, unindex_token);
+        for_each_token(doc->authors, FIELD_AUTHORS, doc->id, unindex_token);
+        int year = parse_year(doc->year, strlen(doc->year));
+        if (year >= 0) {
+            unindex_year(year, doc->id);
+        }
+    }
+    pthread_mutex_unlock(&meta_mutex);
+}
+
+void meta_free() {
+    pthread_mutex_lock(&meta_mutex);
+    free_locked();
+    pthread_mutex_unlock(&meta_mutex);
+}
+
+// ---------------------------------------------------------------------------
+// Consultas
+// ---------------------------------------------------------------------------
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Documentos com o token no campo (título ou autores, com FIELD_ANY)
+static int match_token(const char *token, int field, IdList *result, int *all) {
+    if (field != FIELD_ANY) {
+        TokenEntry *entry = find_token(token, field, hash_token(token, field));
+        return entry ? list_intersect(result, all, entry->docs.ids, entry->docs.count)
+                     : list_intersect(result, all, NULL, 0);
+    }
+
+    TokenEntry *title = find_token(token, FIELD_TITLE, hash_token(token, FIELD_TITLE));
+    TokenEntry *authors = find_token(token, FIELD_AUTHORS, hash_token(token, FIELD_AUTHORS));
+    int count_title = title ? title->docs.count : 0;
+    int count_authors = authors ? authors->docs.count : 0;
+    int *merged = (int*)malloc(sizeof(int) * (count_title + count_authors + 1));
+    if (!merged) {
+        return -1;
+    }
+    int n = 0;
+    for (int i = 0, j = 0; i < count_title || j < count_authors; ) {
+        if (j == count_authors || (i < count_title && title->docs.ids[i] < authors->docs.ids[j])) {
+            merged[n++] = title->docs.ids[i++];
+        } else if (i == count_title || authors->docs.ids[j] < title->docs.ids[i]) {
+            merged[n++] = authors->docs.ids[j++];
+        } else {
+            merged[n++] = title->docs.ids[i++];
+            j++;
+        }
+    }
+    int result_code = list_intersect(result, all, merged, n);
+    free(merged);
+    return result_code;
+}
+
+// Documentos com o ano em [from, to]
+static int match_years(int from, int to, IdList *result, int *all) {
+    int start = year_lower_bound(from, 0);
+    int end = start;
+    while (end < num_years && years[end].year <= to) {
+        end++;
+    }
+    int *ids = (int*)malloc(sizeof(int) * (end - start + 1));
+    if (!ids) {
+        return -1;
+    }
+    for (int i = start; i < end; i++) {
+        ids[i - start] = years[i].id;
+    }
+    qsort(ids, end - start, sizeof(int), compare_ints);
+    int result_code = list_intersect(result, all, ids, end - start);
+    free(ids);
+    return result_code;
+}
+
+// "2010", "2000-2010", "2000-" ou "-1999"
+static int parse_year_range(const char *value, int *from, int *to) {
+    const char *dash = strchr(value, '-');
+    if (!dash) {
+        *from = *to = parse_year(value, strlen(value));
+        return *from < 0 ? -1 : 0;
+    }
+    *from = dash == value ? 0 : parse_year(value, dash - value);
+    *to = dash[1] == '\0' ? INT32_MAX : parse_year(dash + 1, strlen(dash + 1));
+    return *from < 0 || *to < 0 || *from > *to ? -1 : 0;
+}
+
+static int match_criterion(const char *criterion, IdList *result, int *all, char *error, size_t error_size) {
+    int field = FIELD_ANY;
+    const char *value = criterion;
+    const char *colon = strchr(criterion, ':');
+    if (colon) {
+        size_t name_len = colon - criterion;
+        value = colon + 1;
+        if (name_len == 4 && strncmp(criterion, "year", 4) == 0) {
+            int from, to;
+            if (parse_year_range(value, &from, &to) < 0) {
+                snprintf(error, error_size, "Intervalo de anos inválido: %s", value);
+                return -1;
+            }
+            return match_years(from, to, result, all);
+        } else if (name_len == 5 && strncmp(criterion, "title", 5) == 0) {
+            field = FIELD_TITLE;
+        } else if (name_len == 6 && strncmp(criterion, "author", 6) == 0) {
+            field = FIELD_AUTHORS;
+        } else {
+            snprintf(error, error_size, "Campo desconhecido: %.*s (author, title ou year)", (int)name_len, criterion);
+            return -1;
+        }
+    }
+
+    char token[MAX_QUERY_SIZE];
+    int tokens = 0;
+    while (next_token(&value, token) > 0) {
+        if (match_token(token, field, result, all) < 0) {
+            snprintf(error, error_size, "Sem memória");
+            return -1;
+        }
+        tokens++;
+    }
+    if (tokens == 0) {
+        snprintf(error, error_size, "Critério sem palavras: %s", criterion);
+        return -1;
+    }
+    return 0;
+}
+
+int meta_search(const char *expression, int **ids, char *error, size_t error_size) {
+    char copy[MAX_QUERY_SIZE];
+    strncpy(copy, expression, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    IdList result = { NULL, 0, 0 };
+    int all = 1;
+    int criteria = 0;
+    int failed = 0;
+
+    pthread_mutex_lock(&meta_mutex);
+    char *p = copy;
+    while (*p && !failed) {
+        if (*p == ' ' || *p == '\t') {
+            p++;
+            continue;
+        }
+        // Critério até ao próximo espaço fora de aspas
+        char *criterion = p;
+        int quoted = 0;
+        while (*p && (quoted || (*p != ' ' && *p != '\t'))) {
+            quoted ^= *p == '"';
+            p++;
+        }
+        if (*p) {
+            *p++ = '\0';
+        }
+        failed = match_criterion(criterion, &result, &all, error, error_size) < 0;
+        criteria++;
+    }
+    pthread_mutex_unlock(&meta_mutex);
+
+    if (!failed && criteria == 0) {
+        snprintf(error, error_size, "Consulta vazia");
+        failed = 1;
+    }
+    if (failed) {
+        free(result.ids);
+        return -1;
+    }
+    *ids = result.ids;
+    return result.count;
+}
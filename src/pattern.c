@@ -0,0 +1,646 @@
+#define _GNU_SOURCE  // memrchr()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "pattern.h"
+#include "scan.h"
+
+#define MAX_DFA_STATES 2048  // Acima disto a expressão é recusada
+
+// ---------------------------------------------------------------------------
+// NFA de Thompson
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    NODE_BYTES,     // Consome um byte de 'bytes'
+    NODE_BOL,       // Início de linha
+    NODE_EOL,       // Fim de linha
+    NODE_SPLIT,     // Transições vazias para 'out' e 'out1'
+    NODE_EPS,       // Transição vazia para 'out'
+    NODE_MATCH
+} NodeType;
+
+typedef struct {
+    NodeType type;
+    int out;
+    int out1;
+    uint8_t bytes[32];
+} Node;
+
+// Fragmento em construção: 'end' é um NODE_EPS com 'out' ainda por ligar
+typedef struct {
+    int start;
+    int end;
+} Fragment;
+
+typedef struct {
+    const char *text;
+    size_t pos;
+    int icase;
+    Node *nodes;
+    int num_nodes;
+    int capacity;
+    char *error;
+    size_t error_size;
+} Parser;
+
+static int parse_alternation(Parser *ps, Fragment *frag);
+
+static int fail(Parser *ps, const char *message) {
+    if (ps->error && ps->error_size > 0) {
+        snprintf(ps->error, ps->error_size, "%s", message);
+    }
+    return -1;
+}
+
+static int new_node(Parser *ps, NodeType type) {
+    if (ps->num_nodes == ps->capacity) {
+        int capacity = ps->capacity > 0 ? ps->capacity * 2 : 64;
+        Node *grown = (Node*)realloc(ps->nodes, sizeof(Node) * capacity);
+        if (!grown) {
+            return -1;
+        }
+        ps->nodes = grown;
+        ps->capacity = capacity;
+    }
+    Node *node = &ps->nodes[ps->num_nodes];
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    node->out = -1;
+    node->out1 = -1;
+    return ps->num_nodes++;
+}
+
+static void set_byte(Node *node, int c, int icase) {
+    node->bytes[c >> 3] |= (uint8_t)(1 << (c & 7));
+    if (icase && isalpha(c)) {
+        int other = islower(c) ? toupper(c) : tolower(c);
+        node->bytes[other >> 3] |= (uint8_t)(1 << (other & 7));
+    }
+}
+
+// Fragmento com um único nó 'node' seguido de um NODE_EPS
+static int single(Parser *ps, int node, Fragment *frag) {
+    int end = new_node(ps, NODE_EPS);
+    if (node < 0 || end < 0) {
+        return fail(ps, "Sem memória");
+    }
+    ps->nodes[node].out = end;
+    frag->start = node;
+    frag->end = end;
+    return 0;
+}
+
+// Escapes \d \w \s; outro carácter é literal
+static void set_escape(Node *node, int c, int icase) {
+    if (c == 'd' || c == 'w') {
+        for (int b = '0'; b <= '9'; b++) {
+            set_byte(node, b, 0);
+        }
+    }
+    if (c == 'w') {
+        for (int b = 'a'; b <= 'z'; b++) {
+            set_byte(node, b, 1);
+        }
+        set_byte(node, '_', 0);
+    } else if (c == 's') {
+        const char *spaces = " \t\r\f\v";
+        for (const char *s = spaces; *s; s++) {
+            set_byte(node, (unsigned char)*s, 0);
+        }
+    } else if (c != 'd') {
+        set_byte(node, c, icase);
+    }
+}
+
+// [abc], [a-z], [^...]; ']' logo no início é literal
+static int parse_class(Parser *ps, Fragment *frag) {
+    int node = new_node(ps, NODE_BYTES);
+    if (node < 0) {
+        return fail(ps, "Sem memória");
+    }
+    int negate = 0;
+    if (ps->text[ps->pos] == '^') {
+        negate = 1;
+        ps->pos++;
+    }
+    int first = 1;
+    while (ps->text[ps->pos] != ']' || first) {
+        unsigned char c = (unsigned char)ps->text[ps->pos];
+        if (c == '\0') {
+            return fail(ps, "Classe '[' sem ']'");
+        }
+        ps->pos++;
+        first = 0;
+        if (c == '\\' && ps->text[ps->pos] != '\0') {
+            set_escape(&ps->nodes[node], (unsigned char)ps->text[ps->pos++], ps->icase);
+            continue;
+        }
+        if (ps->text[ps->pos] == '-' && ps->text[ps->pos + 1] != ']' && ps->text[ps->pos + 1] != '\0') {
+            unsigned char last = (unsigned char)ps->text[ps->pos + 1];
+            ps->pos += 2;
+            if (last < c) {
+                return fail(ps, "Intervalo inválido na classe");
+            }
+            for (int b = c; b <= last; b++) {
+                set_byte(&ps->nodes[node], b, ps->icase);
+            }
+            continue;
+        }
+        set_byte(&ps->nodes[node], c, ps->icase);
+    }
+    ps->pos++;
+
+    if (negate) {
+        for (int i = 0; i < 32; i++) {
+            ps->nodes[node].bytes[i] = (uint8_t)~ps->nodes[node].bytes[i];
+        }
+    }
+    ps->nodes[node].bytes['\n' >> 3] &= (uint8_t)~(1 << ('\n' & 7));
+    return single(ps, node, frag);
+}
+
+static int parse_atom(Parser *ps, Fragment *frag) {
+    unsigned char c = (unsigned char)ps->text[ps->pos++];
+    int node;
+    switch (c) {
+        case '(':
+            if (parse_alternation(ps, frag) < 0) {
+                return -1;
+            }
+            if (ps->text[ps->pos] != ')') {
+                return fail(ps, "Parêntese '(' sem ')'");
+            }
+            ps->pos++;
+            return 0;
+        case '[':
+            return parse_class(ps, frag);
+        case '.':
+            node = new_node(ps, NODE_BYTES);
+            if (node >= 0) {
+                memset(ps->nodes[node].bytes, 0xff, 32);
+                ps->nodes[node].bytes['\n' >> 3] &= (uint8_t)~(1 << ('\n' & 7));
+            }
+            return single(ps, node, frag);
+        case '^':
+            return single(ps, new_node(ps, NODE_BOL), frag);
+        case '$':
+            return single(ps, new_node(ps, NODE_EOL), frag);
+        case '*':
+        case '+':
+        case '?':
+            return fail(ps, "Quantificador sem operando");
+        case '\\':
+            if (ps->text[ps->pos] == '\0') {
+                return fail(ps, "Expressão termina em '\\'");
+            }
+            node = new_node(ps, NODE_BYTES);
+            if (node >= 0) {
+                set_escape(&ps->nodes[node], (unsigned char)ps->text[ps->pos], ps->icase);
+            }
+            ps->pos++;
+            return single(ps, node, frag);
+        default:
+            node = new_node(ps, NODE_BYTES);
+            if (node >= 0) {
+                set_byte(&ps->nodes[node], c, ps->icase);
+            }
+            return single(ps, node, frag);
+    }
+}
+
+static int parse_repeat(Parser *ps, Fragment *frag) {
+    if (parse_atom(ps, frag) < 0) {
+        return -1;
+    }
+    char op;
+    while ((op = ps->text[ps->pos]) == '*' || op == '+' || op == '?') {
+        ps->pos++;
+        int split = new_node(ps, NODE_SPLIT);
+        int end = new_node(ps, NODE_EPS);
+        if (split < 0 || end < 0) {
+            return fail(ps, "Sem memória");
+        }
+        ps->nodes[split].out = frag->start;
+        ps->nodes[split].out1 = end;
+        // '*' e '+' voltam ao split; '?' segue para o fim
+        ps->nodes[frag->end].out = op == '?' ? end : split;
+        frag->start = op == '+' ? frag->start : split;
+        frag->end = end;
+    }
+    return 0;
+}
+
+static int parse_concat(Parser *ps, Fragment *frag) {
+    int empty = new_node(ps, NODE_EPS);
+    if (empty < 0) {
+        return fail(ps, "Sem memória");
+    }
+    frag->start = empty;
+    frag->end = empty;
+    while (ps->text[ps->pos] != '\0' && ps->text[ps->pos] != '|' && ps->text[ps->pos] != ')') {
+        Fragment next;
+        if (parse_repeat(ps, &next) < 0) {
+            return -1;
+        }
+        ps->nodes[frag->end].out = next.start;
+        frag->end = next.end;
+    }
+    return 0;
+}
+
+static int parse_alternation(Parser *ps, Fragment *frag) {
+    if (parse_concat(ps, frag) < 0) {
+        return -1;
+    }
+    while (ps->text[ps->pos] == '|') {
+        ps->pos++;
+        Fragment right;
+        if (parse_concat(ps, &right) < 0) {
+            return -1;
+        }
+        int split = new_node(ps, NODE_SPLIT);
+        int end = new_node(ps, NODE_EPS);
+        if (split < 0 || end < 0) {
+            return fail(ps, "Sem memória");
+        }
+        ps->nodes[split].out = frag->start;
+        ps->nodes[split].out1 = right.start;
+        ps->nodes[frag->end].out = end;
+        ps->nodes[right.end].out = end;
+        frag->start = split;
+        frag->end = end;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Autómato determinista
+// ---------------------------------------------------------------------------
+
+struct Pattern {
+    uint8_t byte_class[256];
+    int num_symbols;        // Classes de bytes + BOL + EOL
+    int sym_bol;
+    int sym_eol;
+    int *delta;             // num_states * num_symbols
+    uint8_t *accept;
+    int num_states;
+    int line_start;         // Estado depois de BOL
+    char prefix[MAX_KEYWORD_SIZE];  // Literal com que todas as ocorrências começam
+    size_t prefix_len;
+};
+
+typedef struct {
+    const Node *nodes;
+    int num_nodes;
+    int words;              // uint64_t por conjunto de nós
+    int *stack;
+    int *visited;
+    int stamp;
+} Closure;
+
+static void closure_add(Closure *cl, uint64_t *set, int node) {
+    int top = 0;
+    cl->stamp++;
+    cl->stack[top++] = node;
+    while (top > 0) {
+        int n = cl->stack[--top];
+        if (n < 0 || cl->visited[n] == cl->stamp) {
+            continue;
+        }
+        cl->visited[n] = cl->stamp;
+        const Node *node = &cl->nodes[n];
+        if (node->type == NODE_EPS) {
+            cl->stack[top++] = node->out;
+        } else if (node->type == NODE_SPLIT) {
+            cl->stack[top++] = node->out1;
+            cl->stack[top++] = node->out;
+        } else {
+            set[n >> 6] |= 1ULL << (n & 63);
+        }
+    }
+}
+
+// 'rep' tem um byte de cada classe: todos os bytes de uma classe pertencem aos
+// mesmos conjuntos, por isso basta testar esse
+static int node_accepts(const Pattern *p, const Node *node, int symbol, const int *rep) {
+    if (node->type == NODE_BOL) {
+        return symbol == p->sym_bol;
+    }
+    if (node->type == NODE_EOL) {
+        return symbol == p->sym_eol;
+    }
+    if (node->type != NODE_BYTES || symbol >= p->sym_bol) {
+        return 0;
+    }
+    int b = rep[symbol];
+    return (node->bytes[b >> 3] >> (b & 7)) & 1;
+}
+
+// Agrupar os bytes que nenhum nó distingue
+static void build_byte_classes(Pattern *p, const Node *nodes, int num_nodes) {
+    int classes = 1;
+    memset(p->byte_class, 0, sizeof(p->byte_class));
+    int remap[512];
+    for (int n = 0; n < num_nodes; n++) {
+        if (nodes[n].type != NODE_BYTES) {
+            continue;
+        }
+        for (int i = 0; i < 2 * classes; i++) {
+            remap[i] = -1;
+        }
+        int next = 0;
+        for (int b = 0; b < 256; b++) {
+            int in = (nodes[n].bytes[b >> 3] >> (b & 7)) & 1;
+            int key = p->byte_class[b] * 2 + in;
+            if (remap[key] < 0) {
+                remap[key] = next++;
+            }
+            p->byte_class[b] = (uint8_t)remap[key];
+        }
+        classes = next;
+    }
+    p->sym_bol = classes;
+    p->sym_eol = classes + 1;
+    p->num_symbols = classes + 2;
+}
+
+static uint32_t hash_set(const uint64_t *set, int words) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < words; i++) {
+        hash = (hash ^ (uint32_t)set[i]) * 16777619u;
+        hash = (hash ^ (uint32_t)(set[i] >> 32)) * 16777619u;
+    }
+    return hash;
+}
+
+static int build_dfa(Pattern *p, const Node *nodes, int num_nodes, int start, int match,
+                     char *error, size_t error_size) {
+    build_byte_classes(p, nodes, num_nodes);
+    int rep[256];
+    for (int b = 255; b >= 0; b--) {
+        rep[p->byte_class[b]] = b;
+    }
+
+    int words = (num_nodes + 63) / 64;
+    int table_size = MAX_DFA_STATES * 2;
+    uint64_t *sets = (uint64_t*)calloc((size_t)MAX_DFA_STATES * words, sizeof(uint64_t));
+    int *table = (int*)malloc(sizeof(int) * table_size);
+    uint64_t *initial = (uint64_t*)calloc(words, sizeof(uint64_t));
+    uint64_t *next = (uint64_t*)calloc(words, sizeof(uint64_t));
+    Closure cl = { nodes, num_nodes, words, (int*)malloc(sizeof(int) * (2 * num_nodes + 2)),
+                   (int*)calloc(num_nodes, sizeof(int)), 0 };
+    p->delta = (int*)malloc(sizeof(int) * MAX_DFA_STATES * p->num_symbols);
+    p->accept = (uint8_t*)calloc(MAX_DFA_STATES, 1);
+    if (!sets || !table || !initial || !next || !cl.stack || !cl.visited || !p->delta || !p->accept) {
+        snprintf(error, error_size, "Sem memória");
+        free(sets); free(table); free(initial); free(next); free(cl.stack); free(cl.visited);
+        return -1;
+    }
+    for (int i = 0; i < table_size; i++) {
+        table[i] = -1;
+    }
+
+    // Pesquisa sem âncora: todos os estados incluem o fecho do início
+    closure_add(&cl, initial, start);
+    memcpy(sets, initial, sizeof(uint64_t) * words);
+    table[hash_set(initial, words) & (table_size - 1)] = 0;
+    p->num_states = 1;
+
+    int result = 0;
+    for (int s = 0; s < p->num_states && result == 0; s++) {
+        const uint64_t *set = sets + (size_t)s * words;
+        p->accept[s] = (set[match >> 6] >> (match & 63)) & 1;
+        for (int sym = 0; sym < p->num_symbols; sym++) {
+            if (p->accept[s]) {
+                p->delta[s * p->num_symbols + sym] = s; // Linha já aceite
+                continue;
+            }
+            memcpy(next, initial, sizeof(uint64_t) * words);
+            for (int n = 0; n < num_nodes; n++) {
+                if (((set[n >> 6] >> (n & 63)) & 1) && node_accepts(p, &nodes[n], sym, rep)) {
+                    closure_add(&cl, next, nodes[n].out);
+                }
+            }
+
+            uint32_t slot = hash_set(next, words) & (table_size - 1);
+            int target = -1;
+            while (table[slot] >= 0) {
+                if (memcmp(sets + (size_t)table[slot] * words, next, sizeof(uint64_t) * words) == 0) {
+                    target = table[slot];
+                    break;
+                }
+                slot = (slot + 1) & (table_size - 1);
+            }
+            if (target < 0) {
+                if (p->num_states == MAX_DFA_STATES) {
+                    snprintf(error, error_size, "Expressão demasiado complexa");
+                    result = -1;
+                    break;
+                }
+                target = p->num_states++;
+                memcpy(sets + (size_t)target * words, next, sizeof(uint64_t) * words);
+                table[slot] = target;
+            }
+            p->delta[s * p->num_symbols + sym] = target;
+        }
+    }
+    if (result == 0) {
+        p->line_start = p->delta[p->sym_bol];
+    }
+
+    free(sets);
+    free(table);
+    free(initial);
+    free(next);
+    free(cl.stack);
+    free(cl.visited);
+    return result;
+}
+
+// Literal obrigatório no início de todas as ocorrências (vazio se não há)
+static void find_prefix(Pattern *p, const char *text, int mode) {
+    p->prefix_len = 0;
+    if (mode != MATCH_REGEX || strchr(text, '|')) {
+        return;
+    }
+    for (const char *s = text; *s && !strchr(".[]()*+?^$\\", *s); s++) {
+        if (s[1] == '*' || s[1] == '?') {
+            break; // Este carácter é opcional
+        }
+        p->prefix[p->prefix_len++] = *s;
+        if (s[1] == '+') {
+            break;
+        }
+    }
+    p->prefix[p->prefix_len] = '\0';
+}
+
+Pattern *pattern_compile(const char *text, int mode, char *error, size_t error_size) {
+    Parser ps = { text, 0, (mode & MATCH_ICASE) != 0, NULL, 0, 0, error, error_size };
+    Fragment frag;
+    int ok;
+    if (mode & MATCH_REGEX) {
+        ok = parse_alternation(&ps, &frag) == 0;
+        if (ok && ps.text[ps.pos] != '\0') {
+            ok = fail(&ps, "Parêntese ')' sem '('") == 0;
+        }
+    } else {
+        // Palavra-chave literal: um nó por carácter
+        int node = new_node(&ps, NODE_EPS);
+        frag.start = frag.end = node;
+        ok = node >= 0;
+        for (const char *s = text; *s && ok; s++) {
+            Fragment next;
+            node = new_node(&ps, NODE_BYTES);
+            if (node < 0 || single(&ps, node, &next) < 0) {
+                ok = 0;
+                break;
+            }
+            set_byte(&ps.nodes[node], (unsigned char)*s, ps.icase);
+            ps.nodes[frag.end].out = next.start;
+            frag.end = next.end;
+        }
+    }
+    int match = ok ? new_node(&ps, NODE_MATCH) : -1;
+    if (!ok || match < 0) {
+        if (ok) {
+            fail(&ps, "Sem memória");
+        }
+        free(ps.nodes);
+        return NULL;
+    }
+    ps.nodes[frag.end].out = match;
+
+    Pattern *p = (Pattern*)calloc(1, sizeof(Pattern));
+    if (!p) {
+        fail(&ps, "Sem memória");
+        free(ps.nodes);
+        return NULL;
+    }
+    if (build_dfa(p, ps.nodes, ps.num_nodes, frag.start, match, error, error_size) < 0) {
+        free(ps.nodes);
+        pattern_free(p);
+        return NULL;
+    }
+    free(ps.nodes);
+    find_prefix(p, text, mode);
+    return p;
+}
+
+void pattern_free(Pattern *pattern) {
+    if (!pattern) {
+        return;
+    }
+    free(pattern->delta);
+    free(pattern->accept);
+    free(pattern);
+}
+
+// ---------------------------------------------------------------------------
+// Correspondência linha a linha
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const Pattern *p;
+    int state;
+    int line_open;      // A linha em curso tem conteúdo
+    int line_done;      // A linha em curso já foi contada
+    int first_only;     // Parar na primeira linha
+    long count;
+} Matcher;
+
+static void matcher_init(Matcher *m, const Pattern *p, int first_only) {
+    m->p = p;
+    m->state = p->line_start;
+    m->line_open = 0;
+    m->line_done = 0;
+    m->first_only = first_only;
+    m->count = 0;
+}
+
+static int matcher_block(const char *buf, size_t len, size_t overlap, void *arg) {
+    (void)overlap; // Blocos pedidos sem sobreposição
+    Matcher *m = (Matcher*)arg;
+    const Pattern *p = m->p;
+    const char *pos = buf;
+    const char *end = buf + len;
+
+    while (pos < end) {
+        if (m->line_done) {
+            const char *nl = (const char*)memchr(pos, '\n', end - pos);
+            if (!nl) {
+                break;
+            }
+            pos = nl + 1;
+            m->line_done = 0;
+            m->line_open = 0;
+            m->state = p->line_start;
+            continue;
+        }
+
+        // Início de linha: saltar as linhas sem o prefixo literal
+        if (p->prefix_len > 0 && !m->line_open) {
+            const char *hit = scan_find(pos, end - pos, p->prefix, p->prefix_len);
+            const char *nl = (const char*)memrchr(pos, '\n', (hit ? hit : end) - pos);
+            if (nl) {
+                pos = nl + 1;
+            }
+        }
+
+        int state = m->state;
+        while (pos < end) {
+            unsigned char c = (unsigned char)*pos++;
+            if (c == '\n') {
+                if (p->accept[p->delta[state * p->num_symbols + p->sym_eol]]) {
+                    m->count++;
+                }
+                state = p->line_start;
+                m->line_open = 0;
+                break;
+            }
+            state = p->delta[state * p->num_symbols + p->byte_class[c]];
+            m->line_open = 1;
+            if (p->accept[state]) {
+                m->count++;
+                m->line_done = 1;
+                break;
+            }
+        }
+        m->state = state;
+        if (m->first_only && m->count > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static long matcher_finish(Matcher *m) {
+    const Pattern *p = m->p;
+    if (m->line_open && !m->line_done &&
+        p->accept[p->delta[m->state * p->num_symbols + p->sym_eol]]) {
+        m->count++;
+    }
+    return m->count;
+}
+
+int pattern_match_file(const Pattern *pattern, const char *filepath) {
+    Matcher m;
+    matcher_init(&m, pattern, 1);
+    if (scan_file_blocks(filepath, 0, matcher_block, &m) < 0) {
+        return -1;
+    }
+    return matcher_finish(&m) > 0 ? 1 : 0;
+}
+
+int pattern_count_lines(const Pattern *pattern, const char *filepath) {
+    Matcher m;
+    matcher_init(&m, pattern, 0);
+    if (scan_file_blocks(filepath, 0, matcher_block, &m) < 0) {
+        return -2;
+    }
+    return (int)matcher_finish(&m);
+}
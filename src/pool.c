@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "pool.h"
+
+typedef struct Job {
+    PoolTask task;
+    void *arg;
+    int n;
+    atomic_int next;         // Próximo índice por atribuir
+    int completed;           // Tarefas terminadas (protegido por pool_mutex)
+    int active_workers;      // Threads do conjunto a trabalhar neste trabalho
+    int max_workers;         // Limite de threads do conjunto (sem contar quem submeteu)
+    pthread_cond_t done;
+    struct Job *next_job;
+} Job;
+
+static pthread_t *threads = NULL;
+static int num_threads = 0;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_available = PTHREAD_COND_INITIALIZER;
+static Job *queue_head = NULL;
+static Job *queue_tail = NULL;
+static int stopping = 0;
+static atomic_long busy_ns = 0;  // Tempo das threads do conjunto a executar tarefas
+
+// Retirar um trabalho da fila (chamada com pool_mutex)
+static void dequeue(Job *job) {
+    Job **link = &queue_head;
+    Job *prev = NULL;
+    while (*link && *link != job) {
+        prev = *link;
+        link = &(*link)->next_job;
+    }
+    if (*link) {
+        *link = job->next_job;
+        if (queue_tail == job) {
+            queue_tail = prev;
+        }
+    }
+}
+
+// Primeiro trabalho com tarefas por atribuir e lugar para mais uma thread
+static Job *find_job() {
+    for (Job *job = queue_head; job; job = job->next_job) {
+        if (atomic_load(&job->next) < job->n && job->active_workers < job->max_workers) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+// Executar tarefas do trabalho até não haver mais; devolve quantas executou
+static int drain(Job *job) {
+    int executed = 0;
+    int i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->n) {
+        job->task(i, job->arg);
+        executed++;
+    }
+    return executed;
+}
+
+static void *worker_main(void *unused) {
+    (void)unused;
+    pthread_mutex_lock(&pool_mutex);
+    while (1) {
+        Job *job;
+        while (!stopping && (job = find_job()) == NULL) {
+            pthread_cond_wait(&work_available, &pool_mutex);
+        }
+        if (stopping) {
+            break;
+        }
+
+        job->active_workers++;
+        pthread_mutex_unlock(&pool_mutex);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int executed = drain(job);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        atomic_fetch_add_explicit(&busy_ns, (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec),
+                                  memory_order_relaxed);
+
+        pthread_mutex_lock(&pool_mutex);
+        job->active_workers--;
+        dequeue(job); // Já não há tarefas por atribuir
+        job->completed += executed;
+        if (job->completed == job->n && job->active_workers == 0) {
+            pthread_cond_signal(&job->done);
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    return NULL;
+}
+
+int pool_start(int num_workers) {
+    threads = (pthread_t*)malloc(sizeof(pthread_t) * (num_workers > 0 ? num_workers : 1));
+    if (!threads) {
+        return -1;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, NULL) != 0) {
+            perror("Erro ao criar thread de pesquisa");
+            break;
+        }
+        num_threads++;
+    }
+    return 0;
+}
+
+void pool_stop() {
+    pthread_mutex_lock(&pool_mutex);
+    stopping = 1;
+    pthread_cond_broadcast(&work_available);
+    pthread_mutex_unlock(&pool_mutex);
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    threads = NULL;
+    num_threads = 0;
+}
+
+int pool_size() {
+    return num_threads;
+}
+
+long pool_busy_ms() {
+    return atomic_load_explicit(&busy_ns, memory_order_relaxed) / 1000000;
+}
+
+void pool_run(int n, int max_workers, PoolTask task, void *arg) {
+    if (n <= 0) {
+        return;
+    }
+
+    // Sem threads disponíveis ou sem paralelismo pedido: executar diretamente
+    if (num_threads == 0 || max_workers <= 1 || n == 1) {
+        for (int i = 0; i < n; i++) {
+            task(i, arg);
+        }
+        return;
+    }
+
+    Job job;
+    job.task = task;
+    job.arg = arg;
+    job.n = n;
+    atomic_init(&job.next, 0);
+    job.completed = 0;
+    job.active_workers = 0;
+    job.max_workers = max_workers - 1;
+    pthread_cond_init(&job.done, NULL);
+    job.next_job = NULL;
+
+    pthread_mutex_lock(&pool_mutex);
+    if (queue_tail) {
+        queue_tail->next_job = &job;
+    } else {
+        queue_head = &job;
+    }
+    queue_tail = &job;
+    pthread_cond_broadcast(&work_available);
+    pthread_mutex_unlock(&pool_mutex);
+
+    // A thread que submete também trabalha
+    int executed = drain(&job);
+
+    pthread_mutex_lock(&pool_mutex);
+    dequeue(&job);
+    job.completed += executed;
+    // Esperar também pelas threads que ainda referenciam o trabalho
+    while (job.completed < job.n || job.active_workers > 0) {
+        pthread_cond_wait(&job.done, &pool_mutex);
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    pthread_cond_destroy(&job.done);
+}
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include "protocol.h"
+
+int write_frame(int fd, int request_id, int type, int status, const void *data, int length) {
+    if (length < 0 || length > FRAME_MAX_DATA) {
+        return -1;
+    }
+
+    // Cabeçalho e dados numa única escrita (atómica, por não exceder PIPE_BUF)
+    char buffer[PIPE_BUF];
+    FrameHeader header = { request_id, type, status, length };
+    memcpy(buffer, &header, sizeof(FrameHeader));
+    if (length > 0) {
+        memcpy(buffer + sizeof(FrameHeader), data, length);
+    }
+
+    size_t size = sizeof(FrameHeader) + length;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t written = write(fd, buffer + done, size - done);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        done += written;
+    }
+    return 0;
+}
+
+// Com o mutex da sessão, os frames de pedidos diferentes nunca se misturam
+int send_frame(ReplyChannel *channel, int type, int status, const void *data, int length) {
+    if (channel->failed) {
+        return -1;
+    }
+    if (channel->lock) {
+        pthread_mutex_lock(channel->lock);
+    }
+    int result = write_frame(channel->fd, channel->request_id, type, status, data, length);
+    if (channel->lock) {
+        pthread_mutex_unlock(channel->lock);
+    }
+    if (result < 0) {
+        channel->failed = 1;
+    }
+    return result;
+}
+
+int send_frame_nowait(ReplyChannel *channel, int type, int status, const void *data, int length) {
+    if (channel->failed) {
+        return -1;
+    }
+    // Outro pedido da sessão pode estar bloqueado a escrever no mesmo pipe
+    // (cheio): como o pipe cheio, fica para depois
+    if (channel->lock && pthread_mutex_trylock(channel->lock) != 0) {
+        return 0;
+    }
+    // POLLOUT num pipe: há pelo menos uma página livre, que chega para um
+    // frame (até PIPE_BUF bytes) sem bloquear
+    struct pollfd pfd = { channel->fd, POLLOUT, 0 };
+    int ready = poll(&pfd, 1, 0);
+    int result = 0;
+    if (ready > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+        result = -1; // O cliente fechou o pipe
+    } else if (ready > 0) {
+        result = write_frame(channel->fd, channel->request_id, type, status, data, length) == 0 ? 1 : -1;
+    }
+    if (channel->lock) {
+        pthread_mutex_unlock(channel->lock);
+    }
+    if (result < 0) {
+        channel->failed = 1;
+    }
+    return result;
+}
+
+static int read_exact(int fd, void *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t bytes_read = read(fd, (char*)data + done, size - done);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            return -1;
+        }
+        done += bytes_read;
+    }
+    return 0;
+}
+
+int read_frame(int fd, FrameHeader *header, void *data, int max_length) {
+    if (read_exact(fd, header, sizeof(FrameHeader)) < 0) {
+        return -1;
+    }
+    if (header->length < 0 || header->length > max_length) {
+        return -1;
+    }
+    return read_exact(fd, data, header->length);
+}
+
+// ---------------------------------------------------------------------------
+// Envio progressivo de resultados
+// ---------------------------------------------------------------------------
+
+void stream_init(ResultStream *stream, ReplyChannel *channel) {
+    stream->channel = channel;
+    pthread_mutex_init(&stream->mutex, NULL);
+    stream->ids = stream->initial_ids;
+    stream->ids_capacity = FRAME_MAX_IDS;
+    stream->pending = 0;
+    stream->total = 0;
+    stream->last_flush.tv_sec = 0;
+    stream->last_flush.tv_nsec = 0;
+    stream->collected = NULL;
+    stream->capacity = 0;
+    stream->collect_failed = 0;
+    stream->limit = 0;
+    atomic_init(&stream->full, 0);
+}
+
+void stream_set_limit(ResultStream *stream, int limit) {
+    stream->limit = limit > 0 ? limit : 0;
+}
+
+int stream_full(ResultStream *stream) {
+    return atomic_load_explicit(&stream->full, memory_order_relaxed);
+}
+
+// Enviar os IDs pendentes (chamada com o mutex do stream). Sem 'wait' só
+// envia enquanto o pipe tem espaço: quem pesquisa tem o lock dos metadados e
+// um cliente que não lê não o pode prender; o resto segue em stream_finish.
+static void flush_ids(ResultStream *stream, int wait) {
+    int sent = 0;
+    while (sent < stream->pending) {
+        int count = stream->pending - sent < FRAME_MAX_IDS ? stream->pending - sent : FRAME_MAX_IDS;
+        int length = count * (int)sizeof(int);
+        int result = wait ? (send_frame(stream->channel, FRAME_IDS, 0, stream->ids + sent, length) == 0 ? 1 : -1)
+                          : send_frame_nowait(stream->channel, FRAME_IDS, 0, stream->ids + sent, length);
+        if (result < 0) {
+            // Ninguém vai receber os resultados: a pesquisa pode parar
+            atomic_store_explicit(&stream->full, 1, memory_order_relaxed);
+            sent = stream->pending;
+            break;
+        }
+        if (result == 0) {
+            break; // Pipe cheio
+        }
+        sent += count;
+    }
+    memmove(stream->ids, stream->ids + sent, sizeof(int) * (stream->pending - sent));
+    stream->pending -= sent;
+    clock_gettime(CLOCK_MONOTONIC, &stream->last_flush);
+}
+
+// Lugar para mais um ID pendente; 0 se faltou memória
+static int reserve_id(ResultStream *stream) {
+    if (stream->pending < stream->ids_capacity) {
+        return 1;
+    }
+    int capacity = stream->ids_capacity * 2;
+    int *grown = stream->ids == stream->initial_ids ? (int*)malloc(sizeof(int) * capacity)
+                                                    : (int*)realloc(stream->ids, sizeof(int) * capacity);
+    if (!grown) {
+        return 0;
+    }
+    if (stream->ids == stream->initial_ids) {
+        memcpy(grown, stream->initial_ids, sizeof(int) * stream->pending);
+    }
+    stream->ids = grown;
+    stream->ids_capacity = capacity;
+    return 1;
+}
+
+void stream_add(ResultStream *stream, int doc_id) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&stream->mutex);
+    if (stream->limit > 0 && stream->total >= stream->limit) {
+        pthread_mutex_unlock(&stream->mutex);
+        return;
+    }
+    if (stream->collected && !stream->collect_failed) {
+        if (stream->total == stream->capacity) {
+            int *grown = (int*)realloc(stream->collected, sizeof(int) * stream->capacity * 2);
+            if (grown) {
+                stream->collected = grown;
+                stream->capacity *= 2;
+            } else {
+                stream->collect_failed = 1;
+            }
+        }
+        if (!stream->collect_failed) {
+            stream->collected[stream->total] = doc_id;
+        }
+    }
+    if (!reserve_id(stream)) {
+        flush_ids(stream, 1); // Sem memória para esperar pelo cliente
+    }
+    stream->ids[stream->pending++] = doc_id;
+    stream->total++;
+    if (stream->total == stream->limit) {
+        atomic_store_explicit(&stream->full, 1, memory_order_relaxed);
+    }
+    long elapsed_ms = (now.tv_sec - stream->last_flush.tv_sec) * 1000 +
+                      (now.tv_nsec - stream->last_flush.tv_nsec) / 1000000;
+    if (stream->pending % FRAME_MAX_IDS == 0 || elapsed_ms >= STREAM_FLUSH_MS) {
+        flush_ids(stream, 0);
+    }
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+int stream_finish(ResultStream *stream) {
+    pthread_mutex_lock(&stream->mutex);
+    flush_ids(stream, 1);
+    send_frame(stream->channel, FRAME_END, 0, &stream->total, sizeof(int));
+    int total = stream->total;
+    pthread_mutex_unlock(&stream->mutex);
+    return total;
+}
+
+void stream_destroy(ResultStream *stream) {
+    if (stream->ids != stream->initial_ids) {
+        free(stream->ids);
+    }
+    free(stream->collected);
+    pthread_mutex_destroy(&stream->mutex);
+}
+
+int stream_collect(ResultStream *stream) {
+    stream->capacity = 256;
+    stream->collected = (int*)malloc(sizeof(int) * stream->capacity);
+    return stream->collected ? 0 : -1;
+}
+
+const int *stream_collected(ResultStream *stream, int *count) {
+    if (!stream->collected || stream->collect_failed) {
+        return NULL;
+    }
+    *count = stream->total;
+    return stream->collected;
+}
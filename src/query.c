@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "query.h"
+#include "scan.h"
+
+#define MAX_QUERY_PROGRAM 256
+
+typedef enum { INSTR_TERM, INSTR_AND, INSTR_OR, INSTR_NOT } InstrType;
+
+typedef struct {
+    InstrType type;
+    int term;
+} Instr;
+
+struct Query {
+    char terms[MAX_QUERY_TERMS][MAX_KEYWORD_SIZE];
+    int num_terms;
+    Instr program[MAX_QUERY_PROGRAM];  // Expressão em notação pós-fixa
+    int program_len;
+    int monotone;       // Sem NOT: uma vez verdadeira, continua verdadeira
+    uint64_t all_terms;
+
+    // Autómato Aho-Corasick determinístico (transições completas)
+    int num_states;
+    int *next;          // next[estado * 256 + byte]
+    uint64_t *output;   // Termos reconhecidos ao chegar a cada estado
+};
+
+// ---------------------------------------------------------------------------
+// Análise da expressão
+// ---------------------------------------------------------------------------
+
+typedef enum { TOK_TERM, TOK_AND, TOK_OR, TOK_NOT, TOK_LPAREN, TOK_RPAREN, TOK_END, TOK_ERROR } TokenType;
+
+typedef struct {
+    const char *input;
+    TokenType type;
+    char text[MAX_KEYWORD_SIZE];
+    Query *query;
+    char *error;
+    size_t error_size;
+} Parser;
+
+static void next_token(Parser *p) {
+    while (*p->input == ' ' || *p->input == '\t') {
+        p->input++;
+    }
+
+    char c = *p->input;
+    if (c == '\0') {
+        p->type = TOK_END;
+        return;
+    }
+    if (c == '(' || c == ')') {
+        p->type = c == '(' ? TOK_LPAREN : TOK_RPAREN;
+        p->input++;
+        return;
+    }
+
+    const char *start;
+    size_t len;
+    int quoted = (c == '"');
+    if (quoted) {
+        start = ++p->input;
+        const char *end = strchr(start, '"');
+        if (!end) {
+            snprintf(p->error, p->error_size, "Aspas por fechar");
+            p->type = TOK_ERROR;
+            return;
+        }
+        len = end - start;
+        p->input = end + 1;
+    } else {
+        start = p->input;
+        while (*p->input && *p->input != ' ' && *p->input != '\t' &&
+               *p->input != '(' && *p->input != ')' && *p->input != '"') {
+            p->input++;
+        }
+        len = p->input - start;
+    }
+
+    if (len == 0 || len >= MAX_KEYWORD_SIZE) {
+        snprintf(p->error, p->error_size, "Termo vazio ou demasiado longo");
+        p->type = TOK_ERROR;
+        return;
+    }
+    memcpy(p->text, start, len);
+    p->text[len] = '\0';
+
+    p->type = TOK_TERM;
+    if (!quoted) {
+        if (strcmp(p->text, "AND") == 0) {
+            p->type = TOK_AND;
+        } else if (strcmp(p->text, "OR") == 0) {
+            p->type = TOK_OR;
+        } else if (strcmp(p->text, "NOT") == 0) {
+            p->type = TOK_NOT;
+        }
+    }
+}
+
+static int emit(Parser *p, InstrType type, int term) {
+    Query *q = p->query;
+    if (q->program_len >= MAX_QUERY_PROGRAM) {
+        snprintf(p->error, p->error_size, "Expressão demasiado longa");
+        return -1;
+    }
+    q->program[q->program_len].type = type;
+    q->program[q->program_len].term = term;
+    q->program_len++;
+    return 0;
+}
+
+// Índice do termo (termos repetidos partilham o mesmo bit)
+static int add_term(Parser *p, const char *text) {
+    Query *q = p->query;
+    for (int i = 0; i < q->num_terms; i++) {
+        if (strcmp(q->terms[i], text) == 0) {
+            return i;
+        }
+    }
+    if (q->num_terms >= MAX_QUERY_TERMS) {
+        snprintf(p->error, p->error_size, "Demasiados termos (máximo %d)", MAX_QUERY_TERMS);
+        return -1;
+    }
+    if (strchr(text, '\n')) {
+        snprintf(p->error, p->error_size, "Termos não podem conter mudanças de linha");
+        return -1;
+    }
+    strcpy(q->terms[q->num_terms], text);
+    return q->num_terms++;
+}
+
+static int parse_or(Parser *p);
+
+// primary := TERMO | "(" expr ")" | NOT primary
+static int parse_unary(Parser *p) {
+    if (p->type == TOK_NOT) {
+        p->query->monotone = 0;
+        next_token(p);
+        if (parse_unary(p) < 0) {
+            return -1;
+        }
+        return emit(p, INSTR_NOT, 0);
+    }
+
+    if (p->type == TOK_LPAREN) {
+        next_token(p);
+        if (parse_or(p) < 0) {
+            return -1;
+        }
+        if (p->type != TOK_RPAREN) {
+            snprintf(p->error, p->error_size, "Falta ')'");
+            return -1;
+        }
+        next_token(p);
+        return 0;
+    }
+
+    if (p->type == TOK_TERM) {
+        int term = add_term(p, p->text);
+        if (term < 0) {
+            return -1;
+        }
+        next_token(p);
+        return emit(p, INSTR_TERM, term);
+    }
+
+    if (p->type != TOK_ERROR) {
+        snprintf(p->error, p->error_size, "Termo esperado");
+    }
+    return -1;
+}
+
+// and := unary ((AND)? unary)*
+static int parse_and(Parser *p) {
+    if (parse_unary(p) < 0) {
+        return -1;
+    }
+    while (p->type == TOK_AND || p->type == TOK_TERM || p->type == TOK_NOT || p->type == TOK_LPAREN) {
+        if (p->type == TOK_AND) {
+            next_token(p);
+        }
+        if (parse_unary(p) < 0 || emit(p, INSTR_AND, 0) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// or := and (OR and)*
+static int parse_or(Parser *p) {
+    if (parse_and(p) < 0) {
+        return -1;
+    }
+    while (p->type == TOK_OR) {
+        next_token(p);
+        if (parse_and(p) < 0 || emit(p, INSTR_OR, 0) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Autómato Aho-Corasick
+// ---------------------------------------------------------------------------
+
+static int build_automaton(Query *q) {
+    int max_states = 1;
+    for (int i = 0; i < q->num_terms; i++) {
+        max_states += strlen(q->terms[i]);
+    }
+
+    q->next = (int*)malloc(sizeof(int) * 256 * max_states);
+    q->output = (uint64_t*)calloc(max_states, sizeof(uint64_t));
+    int *fail = (int*)malloc(sizeof(int) * max_states);
+    int *queue = (int*)malloc(sizeof(int) * max_states);
+    if (!q->next || !q->output || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return -1;
+    }
+    memset(q->next, -1, sizeof(int) * 256 * max_states);
+
+    // Árvore de prefixos dos termos
+    q->num_states = 1;
+    for (int i = 0; i < q->num_terms; i++) {
+        int state = 0;
+        for (const unsigned char *c = (const unsigned char*)q->terms[i]; *c; c++) {
+            if (q->next[state * 256 + *c] == -1) {
+                q->next[state * 256 + *c] = q->num_states++;
+            }
+            state = q->next[state * 256 + *c];
+        }
+        q->output[state] |= (uint64_t)1 << i;
+    }
+
+    // Ligações de falha por largura, completando as transições em falta
+    int head = 0, tail = 0;
+    for (int c = 0; c < 256; c++) {
+        int child = q->next[c];
+        if (child == -1) {
+            q->next[c] = 0;
+        } else {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        int state = queue[head++];
+        q->output[state] |= q->output[fail[state]];
+        for (int c = 0; c < 256; c++) {
+            int child = q->next[state * 256 + c];
+            if (child == -1) {
+                q->next[state * 256 + c] = q->next[fail[state] * 256 + c];
+            } else {
+                fail[child] = q->next[fail[state] * 256 + c];
+                queue[tail++] = child;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Interface pública
+// ---------------------------------------------------------------------------
+
+Query *query_compile(const char *expression, char *error, size_t error_size) {
+    Query *q = (Query*)calloc(1, sizeof(Query));
+    if (!q) {
+        snprintf(error, error_size, "Sem memória");
+        return NULL;
+    }
+    q->monotone = 1;
+
+    Parser p;
+    p.input = expression;
+    p.query = q;
+    p.error = error;
+    p.error_size = error_size;
+    next_token(&p);
+
+    if (p.type == TOK_END) {
+        snprintf(error, error_size, "Consulta vazia");
+        query_free(q);
+        return NULL;
+    }
+    if (parse_or(&p) < 0) {
+        query_free(q);
+        return NULL;
+    }
+    if (p.type != TOK_END) {
+        snprintf(error, error_size, "Símbolo inesperado na consulta");
+        query_free(q);
+        return NULL;
+    }
+
+    q->all_terms = q->num_terms == 64 ? ~(uint64_t)0 : (((uint64_t)1 << q->num_terms) - 1);
+    if (build_automaton(q) < 0) {
+        snprintf(error, error_size, "Sem memória");
+        query_free(q);
+        return NULL;
+    }
+    return q;
+}
+
+void query_free(Query *q) {
+    if (!q) {
+        return;
+    }
+    free(q->next);
+    free(q->output);
+    free(q);
+}
+
+int query_num_terms(const Query *q) {
+    return q->num_terms;
+}
+
+const char *query_term(const Query *q, int term) {
+    return q->terms[term];
+}
+
+int query_eval(const Query *q, uint64_t present) {
+    int stack[MAX_QUERY_PROGRAM];
+    int top = 0;
+    for (int i = 0; i < q->program_len; i++) {
+        const Instr *ins = &q->program[i];
+        switch (ins->type) {
+            case INSTR_TERM:
+                stack[top++] = (present >> ins->term) & 1;
+                break;
+            case INSTR_NOT:
+                stack[top - 1] = !stack[top - 1];
+                break;
+            case INSTR_AND:
+                top--;
+                stack[top - 1] = stack[top - 1] && stack[top];
+                break;
+            case INSTR_OR:
+                top--;
+                stack[top - 1] = stack[top - 1] || stack[top];
+                break;
+        }
+    }
+    return top > 0 ? stack[0] : 0;
+}
+
+typedef struct {
+    const Query *query;
+    int state;
+    uint64_t present;
+    int decided;
+} MatchState;
+
+static int match_block(const char *buf, size_t len, size_t overlap, void *arg) {
+    (void)overlap; // O autómato guarda o estado entre blocos, não precisa de sobreposição
+    MatchState *ms = (MatchState*)arg;
+    const Query *q = ms->query;
+    const unsigned char *p = (const unsigned char*)buf;
+    int state = ms->state;
+
+    for (size_t i = 0; i < len; i++) {
+        state = q->next[state * 256 + p[i]];
+        uint64_t found = q->output[state] & ~ms->present;
+        if (found) {
+            ms->present |= found;
+            // Todos os termos encontrados, ou expressão sem NOT já verdadeira
+            if (ms->present == q->all_terms || (q->monotone && query_eval(q, ms->present))) {
+                ms->decided = 1;
+                return 1;
+            }
+        }
+    }
+    ms->state = state;
+    return 0;
+}
+
+int query_match_file(const Query *q, const char *filepath) {
+    MatchState ms = { q, 0, 0, 0 };
+    if (scan_file_blocks(filepath, 0, match_block, &ms) < 0) {
+        return -1;
+    }
+    return query_eval(q, ms.present);
+}
+
+typedef struct {
+    const Query *query;
+    int state;
+    uint64_t line_terms;
+    int line_open;
+    long count;
+} LinesState;
+
+static int lines_block(const char *buf, size_t len, size_t overlap, void *arg) {
+    (void)overlap;
+    LinesState *ls = (LinesState*)arg;
+    const Query *q = ls->query;
+    const unsigned char *p = (const unsigned char*)buf;
+
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '\n') {
+            if (query_eval(q, ls->line_terms)) {
+                ls->count++;
+            }
+            ls->line_terms = 0;
+            ls->line_open = 0;
+            ls->state = 0;
+            continue;
+        }
+        ls->line_open = 1;
+        ls->state = q->next[ls->state * 256 + p[i]];
+        ls->line_terms |= q->output[ls->state];
+    }
+    return 0;
+}
+
+int query_count_lines(const Query *q, const char *filepath) {
+    LinesState ls = { q, 0, 0, 0, 0 };
+    if (scan_file_blocks(filepath, 0, lines_block, &ls) < 0) {
+        return -2;
+    }
+    // Última linha sem '\n'
+    if (ls.line_open && query_eval(q, ls.line_terms)) {
+        ls.count++;
+    }
+    return (int)ls.count;
+}
@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "results.h"
+
+typedef struct ResultsEntry {
+    char *keyword;
+    uint32_t hash;
+    unsigned long generation;       // Geração da coleção a que os IDs correspondem
+    int *ids;                       // Ordenados
+    int count;
+    int capacity;
+    struct ResultsEntry *hash_next;
+    struct ResultsEntry *lru_prev;  // Cabeça = mais recente
+    struct ResultsEntry *lru_next;
+} ResultsEntry;
+
+static ResultsEntry **buckets = NULL;
+static int num_buckets = 0;         // Sempre uma potência de 2
+static ResultsEntry *lru_head = NULL;
+static ResultsEntry *lru_tail = NULL;
+static size_t budget = 0;
+static unsigned long generation = 0;
+static ResultsStats stats;
+static pthread_mutex_t results_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Função de dispersão FNV-1a
+static uint32_t hash_keyword(const char *keyword) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)keyword; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t entry_bytes(const ResultsEntry *entry) {
+    return sizeof(ResultsEntry) + strlen(entry->keyword) + 1 + sizeof(int) * entry->capacity;
+}
+
+int results_init(size_t size) {
+    memset(&stats, 0, sizeof(stats));
+    budget = size;
+    stats.budget = size;
+    if (size == 0) {
+        return 0;
+    }
+
+    num_buckets = 64;
+    buckets = (ResultsEntry**)calloc(num_buckets, sizeof(ResultsEntry*));
+    if (!buckets) {
+        budget = 0;
+        return -1;
+    }
+    return 0;
+}
+
+static void destroy_entry(ResultsEntry *entry) {
+    free(entry->keyword);
+    free(entry->ids);
+    free(entry);
+}
+
+void results_free() {
+    pthread_mutex_lock(&results_mutex);
+    ResultsEntry *entry = lru_head;
+    while (entry) {
+        ResultsEntry *next = entry->lru_next;
+        destroy_entry(entry);
+        entry = next;
+    }
+    free(buckets);
+    buckets = NULL;
+    num_buckets = 0;
+    lru_head = lru_tail = NULL;
+    budget = 0;
+    pthread_mutex_unlock(&results_mutex);
+}
+
+int results_enabled() {
+    return budget > 0;
+}
+
+unsigned long results_generation() {
+    pthread_mutex_lock(&results_mutex);
+    unsigned long current = generation;
+    pthread_mutex_unlock(&results_mutex);
+    return current;
+}
+
+static void lru_unlink(ResultsEntry *entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        lru_tail = entry->lru_prev;
+    }
+}
+
+static void lru_push_front(ResultsEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = lru_head;
+    if (lru_head) {
+        lru_head->lru_prev = entry;
+    } else {
+        lru_tail = entry;
+    }
+    lru_head = entry;
+}
+
+static ResultsEntry *find_entry(const char *keyword, uint32_t hash) {
+    for (ResultsEntry *entry = buckets[hash & (num_buckets - 1)]; entry; entry = entry->hash_next) {
+        if (entry->hash == hash && strcmp(entry->keyword, keyword) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void remove_entry(ResultsEntry *entry) {
+    ResultsEntry **link = &buckets[entry->hash & (num_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    lru_unlink(entry);
+    stats.bytes -= entry_bytes(entry);
+    stats.entries--;
+    destroy_entry(entry);
+}
+
+static void grow_buckets() {
+    int new_size = num_buckets * 2;
+    ResultsEntry **new_buckets = (ResultsEntry**)calloc(new_size, sizeof(ResultsEntry*));
+    if (!new_buckets) {
+        return; // Continua a funcionar, só com cadeias mais longas
+    }
+    for (int i = 0; i < num_buckets; i++) {
+        ResultsEntry *entry = buckets[i];
+        while (entry) {
+            ResultsEntry *next = entry->hash_next;
+            entry->hash_next = new_buckets[entry->hash & (new_size - 1)];
+            new_buckets[entry->hash & (new_size - 1)] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_size;
+}
+
+int results_lookup(const char *keyword, int **ids) {
+    if (budget == 0) {
+        return -1;
+    }
+
+    uint32_t hash = hash_keyword(keyword);
+    pthread_mutex_lock(&results_mutex);
+    ResultsEntry *entry = find_entry(keyword, hash);
+    if (entry && entry->generation != generation) {
+        remove_entry(entry);
+        stats.invalidations++;
+        entry = NULL;
+    }
+    if (!entry) {
+        stats.misses++;
+        pthread_mutex_unlock(&results_mutex);
+        return -1;
+    }
+
+    // Copiar, para enviar os IDs ao cliente sem o mutex
+    *ids = (int*)malloc(sizeof(int) * (entry->count + 1));
+    if (!*ids) {
+        pthread_mutex_unlock(&results_mutex);
+        return -1;
+    }
+    memcpy(*ids, entry->ids, sizeof(int) * entry->count);
+    int count = entry->count;
+    lru_unlink(entry);
+    lru_push_front(entry);
+    stats.hits++;
+    pthread_mutex_unlock(&results_mutex);
+    return count;
+}
+
+static int compare_ids(const void *a, const void *b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+void results_store(const char *keyword, unsigned long search_generation, const int *ids, int count) {
+    if (budget == 0) {
+        return;
+    }
+
+    ResultsEntry *entry = (ResultsEntry*)calloc(1, sizeof(ResultsEntry));
+    if (!entry) {
+        return;
+    }
+    entry->keyword = strdup(keyword);
+    entry->ids = (int*)malloc(sizeof(int) * (count + 1));
+    if (!entry->keyword || !entry->ids) {
+        destroy_entry(entry);
+        return;
+    }
+    memcpy(entry->ids, ids, sizeof(int) * count);
+    qsort(entry->ids, count, sizeof(int), compare_ids);
+    entry->count = count;
+    entry->capacity = count + 1;
+    entry->hash = hash_keyword(keyword);
+    entry->generation = search_generation;
+
+    // Resultados maiores que metade do orçamento não entram
+    size_t bytes = entry_bytes(entry);
+    pthread_mutex_lock(&results_mutex);
+    if (search_generation != generation || bytes > budget / 2) {
+        pthread_mutex_unlock(&results_mutex);
+        destroy_entry(entry);
+        return;
+    }
+
+    // Outra pesquisa pela mesma palavra-chave pode ter terminado primeiro
+    ResultsEntry *existing = find_entry(keyword, entry->hash);
+    if (existing) {
+        remove_entry(existing);
+    }
+    if (stats.entries + 1 > num_buckets) {
+        grow_buckets();
+    }
+    ResultsEntry **bucket = &buckets[entry->hash & (num_buckets - 1)];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    lru_push_front(entry);
+    stats.bytes += bytes;
+    stats.entries++;
+
+    while (stats.bytes > budget && lru_tail && lru_tail != entry) {
+        remove_entry(lru_tail);
+        stats.evictions++;
+    }
+    pthread_mutex_unlock(&results_mutex);
+}
+
+// Acrescentar um ID mantendo a ordem; -1 se não houver memória
+static int entry_insert_id(ResultsEntry *entry, int doc_id) {
+    if (entry->count == entry->capacity) {
+        int capacity = entry->capacity * 2;
+        int *grown = (int*)realloc(entry->ids, sizeof(int) * capacity);
+        if (!grown) {
+            return -1;
+        }
+        stats.bytes += sizeof(int) * (capacity - entry->capacity);
+        entry->ids = grown;
+        entry->capacity = capacity;
+    }
+    // Os IDs novos são sempre os maiores, mas não depender disso
+    int pos = entry->count;
+    while (pos > 0 && entry->ids[pos - 1] > doc_id) {
+        entry->ids[pos] = entry->ids[pos - 1];
+        pos--;
+    }
+    entry->ids[pos] = doc_id;
+    entry->count++;
+    return 0;
+}
+
+// Resultado da verificação de um documento contra uma palavra-chave em cache
+typedef struct {
+    char *keyword;
+    int found;          // 1/0, -1 se não se sabe
+} CheckedKeyword;
+
+struct ResultsCheck {
+    unsigned long generation;   // Geração em que as palavras-chave foram copiadas
+    CheckedKeyword *keywords;   // Ordenadas
+    int count;
+};
+
+static int compare_checked(const void *a, const void *b) {
+    return strcmp(((const CheckedKeyword*)a)->keyword, ((const CheckedKeyword*)b)->keyword);
+}
+
+void results_check_free(ResultsCheck *check) {
+    if (!check) {
+        return;
+    }
+    for (int i = 0; i < check->count; i++) {
+        free(check->keywords[i].keyword);
+    }
+    free(check->keywords);
+    free(check);
+}
+
+ResultsCheck *results_check_document(int (*contains)(const char *keyword, void *arg), void *arg) {
+    if (budget == 0) {
+        return NULL;
+    }
+    ResultsCheck *check = (ResultsCheck*)calloc(1, sizeof(ResultsCheck));
+    if (!check) {
+        return NULL;
+    }
+
+    // Copiar as palavras-chave; os ficheiros são percorridos sem o mutex
+    pthread_mutex_lock(&results_mutex);
+    check->generation = generation;
+    check->keywords = (CheckedKeyword*)malloc(sizeof(CheckedKeyword) * (stats.entries > 0 ? stats.entries : 1));
+    for (ResultsEntry *entry = lru_head; entry && check->keywords; entry = entry->lru_next) {
+        char *keyword = strdup(entry->keyword);
+        if (!keyword) {
+            break; // As restantes entradas são descartadas ao aplicar
+        }
+        check->keywords[check->count].keyword = keyword;
+        check->keywords[check->count].found = -1;
+        check->count++;
+    }
+    pthread_mutex_unlock(&results_mutex);
+
+    for (int i = 0; i < check->count; i++) {
+        check->keywords[i].found = contains(check->keywords[i].keyword, arg);
+    }
+    qsort(check->keywords, check->count, sizeof(CheckedKeyword), compare_checked);
+    return check;
+}
+
+// Retirar o ID de uma entrada; 1 se estava lá
+static int entry_remove_id(ResultsEntry *entry, int doc_id) {
+    int *found = (int*)bsearch(&doc_id, entry->ids, entry->count, sizeof(int), compare_ids);
+    if (!found) {
+        return 0;
+    }
+    memmove(found, found + 1, sizeof(int) * (entry->ids + entry->count - found - 1));
+    entry->count--;
+    return 1;
+}
+
+void results_add_document(int doc_id, ResultsCheck *check) {
+    if (budget == 0) {
+        results_check_free(check);
+        return;
+    }
+
+    pthread_mutex_lock(&results_mutex);
+    // Se a coleção mudou desde a verificação, as respostas podem já não valer
+    int current = check && check->generation == generation;
+    generation++;
+    ResultsEntry *entry = lru_head;
+    while (entry) {
+        ResultsEntry *next = entry->lru_next;
+        int found = -1;
+        if (current) {
+            CheckedKeyword key = { entry->keyword, 0 };
+            CheckedKeyword *checked = (CheckedKeyword*)bsearch(&key, check->keywords, check->count,
+                                                              sizeof(CheckedKeyword), compare_checked);
+            found = checked ? checked->found : -1;  // Guardada depois da cópia: não verificada
+        }
+        // Um documento alterado pode já estar na entrada
+        int removed = found >= 0 ? entry_remove_id(entry, doc_id) : 0;
+        if (found < 0 || (found > 0 && entry_insert_id(entry, doc_id) < 0)) {
+            remove_entry(entry);
+            stats.invalidations++;
+        } else {
+            entry->generation = generation;
+            stats.updates += found || removed;
+        }
+        entry = next;
+    }
+    // Entradas que cresceram para lá do orçamento
+    while (stats.bytes > budget && lru_tail) {
+        remove_entry(lru_tail);
+        stats.evictions++;
+    }
+    pthread_mutex_unlock(&results_mutex);
+    results_check_free(check);
+}
+
+void results_remove_document(int doc_id) {
+    if (budget == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&results_mutex);
+    generation++;
+    for (ResultsEntry *entry = lru_head; entry; entry = entry->lru_next) {
+        stats.updates += entry_remove_id(entry, doc_id);
+        entry->generation = generation;
+    }
+    pthread_mutex_unlock(&results_mutex);
+}
+
+void results_invalidate() {
+    if (budget == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&results_mutex);
+    generation++;
+    while (lru_head) {
+        remove_entry(lru_head);
+        stats.invalidations++;
+    }
+    pthread_mutex_unlock(&results_mutex);
+}
+
+void results_stats(ResultsStats *out) {
+    pthread_mutex_lock(&results_mutex);
+    *out = stats;
+    pthread_mutex_unlock(&results_mutex);
+}
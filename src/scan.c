@@ -0,0 +1,579 @@
+#define _GNU_SOURCE  // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "content.h"
+#include "gz.h"
+#include "scan.h"
+#include "stats.h"
+#include "uring.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+#define SCAN_BLOCK_SIZE (64 * 1024)
+
+typedef const char *(*FindKernel)(const char *s, size_t n, const char *needle, size_t m);
+
+static const char *find_scalar(const char *s, size_t n, const char *needle, size_t m) {
+    return (const char*)memmem(s, n, needle, m);
+}
+
+#ifdef SCAN_X86
+// Candidatos: posições onde coincidem o primeiro e o último byte da palavra-chave
+__attribute__((target("sse2")))
+static const char *find_sse2(const char *s, size_t n, const char *needle, size_t m) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i*)(s + i + m - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                                            _mm_cmpeq_epi8(last, block_last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(s + i + bit + 1, needle + 1, m - 2) == 0) {
+                return s + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(s + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *s, size_t n, const char *needle, size_t m) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i*)(s + i + m - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                             _mm256_cmpeq_epi8(last, block_last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(s + i + bit + 1, needle + 1, m - 2) == 0) {
+                return s + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_sse2(s + i, n - i, needle, m);
+}
+#endif
+
+static FindKernel kernel = NULL;
+static const char *kernel_name = "scalar";
+static ScanMode scan_mode = SCAN_READ;
+
+// Escolher a implementação conforme o processador (uma vez, no primeiro uso)
+static FindKernel select_kernel() {
+    FindKernel selected = find_scalar;
+    const char *name = "scalar";
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        selected = find_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        selected = find_sse2;
+        name = "sse2";
+    }
+#endif
+    kernel_name = name;
+    kernel = selected;
+    return selected;
+}
+
+const char *scan_kernel_name() {
+    if (!kernel) {
+        select_kernel();
+    }
+    return kernel_name;
+}
+
+const char *scan_find(const char *haystack, size_t n, const char *needle, size_t m) {
+    if (m == 0) {
+        return haystack;
+    }
+    if (m > n) {
+        return NULL;
+    }
+    if (m == 1) {
+        return (const char*)memchr(haystack, needle[0], n);
+    }
+
+    FindKernel find = kernel ? kernel : select_kernel();
+    return find(haystack, n, needle, m);
+}
+
+// ---------------------------------------------------------------------------
+// Contagem de linhas
+// ---------------------------------------------------------------------------
+
+void line_counter_init(LineCounter *lc, const char *keyword) {
+    lc->keyword = keyword;
+    lc->len = strlen(keyword);
+    lc->line_counted = 0;
+    lc->line_open = 0;
+    lc->count = 0;
+}
+
+void line_counter_feed(LineCounter *lc, const char *buf, size_t len, size_t overlap) {
+    const char *end = buf + len;
+
+    // Uma palavra-chave vazia ocorre em todas as linhas com conteúdo ou '\n'
+    if (lc->len == 0) {
+        const char *p = buf + overlap;
+        const char *nl;
+        while (p < end && (nl = (const char*)memchr(p, '\n', end - p)) != NULL) {
+            lc->count++;
+            p = nl + 1;
+        }
+        if (len > overlap) {
+            lc->line_open = (end[-1] != '\n');
+        }
+        return;
+    }
+
+    // Uma palavra-chave com '\n' nunca cabe numa linha
+    if (memchr(lc->keyword, '\n', lc->len)) {
+        return;
+    }
+
+    const char *p = buf;
+    if (lc->line_counted) {
+        // Saltar o resto da linha já contada
+        const char *nl = (const char*)memchr(buf + overlap, '\n', len - overlap);
+        if (!nl) {
+            return;
+        }
+        p = nl + 1;
+        lc->line_counted = 0;
+    }
+
+    while (p < end) {
+        const char *hit = scan_find(p, end - p, lc->keyword, lc->len);
+        if (!hit) {
+            break;
+        }
+
+        // Uma ocorrência conta a sua linha uma vez; continuar na linha seguinte
+        lc->count++;
+        const char *after = hit + lc->len;
+        const char *nl = (const char*)memchr(after, '\n', end - after);
+        if (!nl) {
+            lc->line_counted = 1;
+            break;
+        }
+        p = nl + 1;
+    }
+}
+
+long line_counter_finish(LineCounter *lc) {
+    if (lc->len == 0 && lc->line_open) {
+        lc->count++; // Última linha sem '\n'
+        lc->line_open = 0;
+    }
+    return lc->count;
+}
+
+// ---------------------------------------------------------------------------
+// Modo de leitura
+// ---------------------------------------------------------------------------
+
+void scan_set_mode(ScanMode mode) {
+    scan_mode = mode;
+}
+
+ScanMode scan_get_mode() {
+    return scan_mode;
+}
+
+const char *scan_mode_name(ScanMode mode) {
+    return mode == SCAN_MMAP ? "mmap" : mode == SCAN_URING ? "uring" : "read";
+}
+
+int scan_parse_mode(const char *name, ScanMode *mode) {
+    if (strcmp(name, "read") == 0) {
+        *mode = SCAN_READ;
+    } else if (strcmp(name, "mmap") == 0) {
+        *mode = SCAN_MMAP;
+    } else if (strcmp(name, "uring") == 0) {
+        *mode = SCAN_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Mapear o ficheiro inteiro para leitura sequencial; NULL se não compensar
+// (modo read, ficheiro pequeno ou mmap() indisponível)
+static const char *map_file(int fd, size_t *size) {
+    if (scan_mode != SCAN_MMAP) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size < SCAN_MMAP_MIN_SIZE) {
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    *size = st.st_size;
+    return (const char*)map;
+}
+
+// ---------------------------------------------------------------------------
+// Varrimento de ficheiros
+// ---------------------------------------------------------------------------
+
+// Ler o bloco seguinte mantendo no início os últimos 'overlap' bytes do anterior,
+// para encontrar ocorrências que atravessam a fronteira entre blocos (do
+// ficheiro ou, se está comprimido, do descompressor)
+static ssize_t read_block(int fd, GzReader *gz, char *buffer, size_t *filled, size_t overlap) {
+    if (*filled > overlap) {
+        memmove(buffer, buffer + *filled - overlap, overlap);
+    } else {
+        overlap = *filled;
+    }
+
+    ssize_t bytes_read = gz ? gz_read(gz, buffer + overlap, SCAN_BLOCK_SIZE)
+                            : read(fd, buffer + overlap, SCAN_BLOCK_SIZE);
+    if (bytes_read > 0) {
+        *filled = overlap + bytes_read;
+    }
+    return bytes_read;
+}
+
+// Entregar o conteúdo em blocos lidos de fd ou, com gz, descomprimidos. Sem
+// gz, um primeiro bloco comprimido passa a ser descomprimido em fluxo.
+static void feed_blocks(int fd, GzReader *gz, size_t overlap, ScanBlockFn fn, void *arg) {
+    if (overlap > MAX_KEYWORD_SIZE) {
+        overlap = MAX_KEYWORD_SIZE;
+    }
+    char *buffer = (char*)malloc(SCAN_BLOCK_SIZE + MAX_KEYWORD_SIZE);
+    if (!buffer) {
+        return;
+    }
+
+    GzReader *own = NULL;
+    size_t filled = 0;
+    int first = 1;
+    while (1) {
+        size_t kept = filled < overlap ? filled : overlap;
+        if (read_block(fd, gz, buffer, &filled, overlap) <= 0) {
+            break;
+        }
+        if (first && !gz && gz_detect(buffer, filled) != GZ_NONE) {
+            // O bloco lido passa a ser a entrada do descompressor
+            gz = own = gz_reader_new(fd, buffer, filled);
+            if (!gz) {
+                break;
+            }
+            filled = 0;
+            first = 0;
+            continue;
+        }
+        first = 0;
+        stats_add(STAT_BYTES_SCANNED, filled - kept);
+        if (fn(buffer, filled, kept, arg)) {
+            break; // Quem consome já tem a resposta
+        }
+    }
+
+    gz_reader_free(own);
+    free(buffer);
+}
+
+// Conteúdo já em memória (cache ou mapeamento): um único bloco, ou
+// descomprimido em blocos se é gzip
+static void feed_memory(const char *data, size_t size, size_t overlap, ScanBlockFn fn, void *arg) {
+    if (gz_detect(data, size) == GZ_NONE) {
+        stats_add(STAT_BYTES_SCANNED, size);
+        fn(data, size, 0, arg);
+        return;
+    }
+    GzReader *gz = gz_reader_new(-1, data, size);
+    if (gz) {
+        feed_blocks(-1, gz, overlap, fn, arg);
+        gz_reader_free(gz);
+    }
+}
+
+int scan_file_blocks(const char *filepath, size_t overlap, ScanBlockFn fn, void *arg) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    stats_add(STAT_FILES_OPENED, 1);
+
+    // Conteúdo em memória: sem acessos ao disco
+    size_t cached_size;
+    ContentEntry *entry;
+    const char *cached = content_acquire(filepath, fd, &cached_size, &entry);
+    if (cached) {
+        close(fd);
+        feed_memory(cached, cached_size, overlap, fn, arg);
+        content_release(entry);
+        return 0;
+    }
+
+    // Ficheiro mapeado: o conteúdo todo de uma vez
+    size_t map_size;
+    const char *map = map_file(fd, &map_size);
+    if (map) {
+        feed_memory(map, map_size, overlap, fn, arg);
+        munmap((void*)map, map_size);
+        close(fd);
+        return 0;
+    }
+
+    feed_blocks(fd, NULL, overlap, fn, arg);
+    close(fd);
+    return 0;
+}
+
+int scan_file_splittable(const char *filepath) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1) {
+        return 0;
+    }
+    unsigned char head[GZ_HEADER_SIZE];
+    ssize_t got = pread(fd, head, sizeof(head), 0);
+    close(fd);
+    return got > 0 && gz_detect(head, got) != GZ_GZIP;
+}
+
+typedef struct {
+    const char *keyword;
+    size_t len;
+    int found;
+} ContainsState;
+
+static int contains_block(const char *buf, size_t len, size_t overlap, void *arg) {
+    (void)overlap;
+    ContainsState *state = (ContainsState*)arg;
+    if (scan_find(buf, len, state->keyword, state->len)) {
+        state->found = 1;
+        return 1;
+    }
+    return 0;
+}
+
+int scan_file_contains(const char *filepath, const char *keyword) {
+    ContainsState state = { keyword, strlen(keyword), 0 };
+    size_t overlap = state.len > 0 ? state.len - 1 : 0;
+    if (scan_file_blocks(filepath, overlap, contains_block, &state) < 0) {
+        return -1;
+    }
+    return state.found;
+}
+
+// Estado de um varrimento de vários ficheiros com io_uring
+typedef struct {
+    const char *const *paths;
+    const char *keyword;
+    size_t len;
+    ScanResultFn fn;
+    void *arg;
+    char *found;        // Por ficheiro: a palavra-chave já apareceu
+    char *compressed;   // Por ficheiro: gzip, percorrido depois com read()
+    char *finished;     // Por ficheiro: fn já foi chamada
+    int stopped;        // fn pediu para parar
+} UringScan;
+
+static int uring_opened(int file, int fd, void *arg) {
+    UringScan *scan = (UringScan*)arg;
+    stats_add(STAT_FILES_OPENED, 1);
+
+    // Só o que já está na cache de conteúdos: encher a cache leria o
+    // ficheiro aqui, sem nada em curso ao mesmo tempo
+    size_t cached_size;
+    ContentEntry *entry;
+    const char *cached = content_lookup(scan->paths[file], fd, &cached_size, &entry);
+    if (!cached) {
+        return 0;
+    }
+    ContainsState state = { scan->keyword, scan->len, 0 };
+    feed_memory(cached, cached_size, scan->len > 0 ? scan->len - 1 : 0, contains_block, &state);
+    content_release(entry);
+    scan->found[file] = (char)state.found;
+    return 1;
+}
+
+static int uring_block(int file, const char *buf, size_t len, size_t overlap, void *arg) {
+    UringScan *scan = (UringScan*)arg;
+    // A descompressão não é assíncrona: os ficheiros gzip ficam para o fim
+    if (overlap == 0 && gz_detect(buf, len) != GZ_NONE) {
+        scan->compressed[file] = 1;
+        return 1;
+    }
+    stats_add(STAT_BYTES_SCANNED, len - overlap);
+    if (scan_find(buf, len, scan->keyword, scan->len)) {
+        scan->found[file] = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int uring_done(int file, int error, void *arg) {
+    UringScan *scan = (UringScan*)arg;
+    if (scan->compressed[file]) {
+        return 0;
+    }
+    scan->finished[file] = 1;
+    errno = error;
+    scan->stopped = scan->fn(file, error ? -1 : scan->found[file], scan->arg) != 0;
+    return scan->stopped;
+}
+
+static const UringCallbacks uring_callbacks = { uring_opened, uring_block, uring_done };
+
+void scan_files_contains(const char *const *paths, int count, const char *keyword, ScanResultFn fn, void *arg) {
+    UringScan scan = { paths, keyword, strlen(keyword), fn, arg, NULL, NULL, NULL, 0 };
+    char *flags = scan_mode == SCAN_URING && count > 0 ? (char*)calloc(3, count) : NULL;
+    if (flags) {
+        scan.found = flags;
+        scan.compressed = flags + count;
+        scan.finished = flags + 2 * count;
+        uring_scan_files(paths, count, scan.len > 0 ? scan.len - 1 : 0, &uring_callbacks, &scan);
+        // Comprimidos, ou o que o io_uring não chegou a percorrer
+        for (int i = 0; i < count && !scan.stopped; i++) {
+            if (!scan.finished[i]) {
+                scan.stopped = fn(i, scan_file_contains(paths[i], keyword), arg) != 0;
+            }
+        }
+        free(flags);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (fn(i, scan_file_contains(paths[i], keyword), arg)) {
+            break;
+        }
+    }
+}
+
+// Intervalo de um ficheiro BGZF: os membros que começam em [start, end), mais
+// o início do membro seguinte para as ocorrências que atravessam o fim
+static int bgzf_range_contains(int fd, off_t start, off_t end, const char *keyword, atomic_int *stop) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return 0;
+    }
+    size_t len = strlen(keyword);
+    size_t overlap = len > 0 ? len - 1 : 0;
+    char *buffer = (char*)malloc(GZ_BGZF_MAX_BLOCK + MAX_KEYWORD_SIZE);
+    if (!buffer) {
+        return 0;
+    }
+
+    // Cada membro é procurado a seguir aos últimos 'overlap' bytes do anterior
+    int found = 0;
+    size_t kept = 0;
+    off_t pos = start == 0 ? 0 : gz_bgzf_find(fd, start, st.st_size);
+    while (pos < st.st_size && !found && !atomic_load_explicit(stop, memory_order_relaxed)) {
+        size_t block_size;
+        ssize_t produced = gz_bgzf_inflate(fd, pos, buffer + kept, &block_size);
+        if (produced < 0) {
+            break; // Membro corrompido
+        }
+        stats_add(STAT_BYTES_SCANNED, produced);
+        found = scan_find(buffer, kept + produced, keyword, len) != NULL;
+        int past_end = pos >= end;
+        pos += block_size;
+        if (past_end && produced > 0) {
+            break; // Já há bytes suficientes depois do intervalo
+        }
+        size_t total = kept + produced;
+        kept = total < overlap ? total : overlap;
+        memmove(buffer, buffer + total - kept, kept);
+    }
+
+    free(buffer);
+    return found;
+}
+
+int scan_range_contains(const char *filepath, off_t start, off_t end, const char *keyword,
+                        atomic_int *stop) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    stats_add(STAT_FILES_OPENED, 1);
+
+    // Ficheiros comprimidos: só BGZF se pode começar a meio
+    unsigned char head[GZ_HEADER_SIZE];
+    ssize_t got = pread(fd, head, sizeof(head), 0);
+    int format = got > 0 ? gz_detect(head, got) : GZ_NONE;
+    if (format != GZ_NONE) {
+        int found = 0;
+        if (format == GZ_BGZF) {
+            found = bgzf_range_contains(fd, start, end, keyword, stop);
+        }
+        close(fd);
+        if (format == GZ_GZIP && start == 0) {
+            found = scan_file_contains(filepath, keyword) > 0;
+        }
+        return found;
+    }
+
+    size_t len = strlen(keyword);
+    size_t overlap = len > 0 ? len - 1 : 0;
+    char *buffer = (char*)malloc(SCAN_BLOCK_SIZE + overlap);
+    if (!buffer) {
+        close(fd);
+        return -1;
+    }
+
+    // Cada bloco volta a ler os últimos 'overlap' bytes do anterior
+    int found = 0;
+    for (off_t pos = start; pos < end && !found && !atomic_load_explicit(stop, memory_order_relaxed);
+         pos += SCAN_BLOCK_SIZE) {
+        size_t want = end - pos < SCAN_BLOCK_SIZE ? (size_t)(end - pos) : SCAN_BLOCK_SIZE;
+        ssize_t bytes_read = pread(fd, buffer, want + overlap, pos);
+        if (bytes_read <= 0) {
+            break;
+        }
+        stats_add(STAT_BYTES_SCANNED, bytes_read);
+        found = scan_find(buffer, bytes_read, keyword, len) != NULL;
+    }
+
+    free(buffer);
+    close(fd);
+    return found;
+}
+
+static int count_lines_block(const char *buf, size_t len, size_t overlap, void *arg) {
+    line_counter_feed((LineCounter*)arg, buf, len, overlap);
+    return 0;
+}
+
+int scan_file_count_lines(const char *filepath, const char *keyword) {
+    LineCounter lc;
+    line_counter_init(&lc, keyword);
+    size_t overlap = lc.len > 0 ? lc.len - 1 : 0;
+    if (scan_file_blocks(filepath, overlap, count_lines_block, &lc) < 0) {
+        return -2;
+    }
+    return (int)line_counter_finish(&lc);
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "session.h"
+
+struct Session {
+    pid_t pid;
+    int fd;                     // Pipe do cliente, aberto para escrita
+    int refs;                   // Tabela + pedidos em curso
+    pthread_mutex_t write_lock; // Um frame de cada vez no pipe
+    struct Session *next;
+};
+
+// Poucas sessões em simultâneo: uma lista chega
+static Session *sessions = NULL;
+static pthread_mutex_t sessions_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Chamada com sessions_mutex
+static Session *find_session(pid_t pid, Session ***link) {
+    Session **p = &sessions;
+    while (*p && (*p)->pid != pid) {
+        p = &(*p)->next;
+    }
+    if (link) {
+        *link = p;
+    }
+    return *p;
+}
+
+// Chamada com sessions_mutex
+static void unref(Session *session) {
+    if (--session->refs == 0) {
+        close(session->fd);
+        pthread_mutex_destroy(&session->write_lock);
+        free(session);
+    }
+}
+
+int session_open(pid_t pid, const char *pipe_name) {
+    Session *session = (Session*)malloc(sizeof(Session));
+    if (!session) {
+        return -1;
+    }
+
+    // Bloqueia até o cliente abrir o pipe para leitura (já o está a fazer)
+    session->fd = open(pipe_name, O_WRONLY);
+    if (session->fd == -1) {
+        perror("Erro ao abrir pipe do cliente");
+        free(session);
+        return -1;
+    }
+    session->pid = pid;
+    session->refs = 1;
+    pthread_mutex_init(&session->write_lock, NULL);
+
+    pthread_mutex_lock(&sessions_mutex);
+    // Um processo só tem uma sessão: a anterior (abandonada) é substituída
+    Session **link;
+    Session *old = find_session(pid, &link);
+    if (old) {
+        *link = old->next;
+        unref(old);
+    }
+    session->next = sessions;
+    sessions = session;
+    pthread_mutex_unlock(&sessions_mutex);
+    return 0;
+}
+
+int session_close(pid_t pid) {
+    pthread_mutex_lock(&sessions_mutex);
+    Session **link;
+    Session *session = find_session(pid, &link);
+    if (session) {
+        *link = session->next;
+        unref(session);
+    }
+    pthread_mutex_unlock(&sessions_mutex);
+    return session ? 0 : -1;
+}
+
+void session_close_all() {
+    pthread_mutex_lock(&sessions_mutex);
+    while (sessions) {
+        Session *session = sessions;
+        sessions = session->next;
+        unref(session);
+    }
+    pthread_mutex_unlock(&sessions_mutex);
+}
+
+Session *session_acquire(pid_t pid) {
+    pthread_mutex_lock(&sessions_mutex);
+    Session *session = find_session(pid, NULL);
+    if (session) {
+        session->refs++;
+    }
+    pthread_mutex_unlock(&sessions_mutex);
+    return session;
+}
+
+void session_release(Session *session) {
+    pthread_mutex_lock(&sessions_mutex);
+    unref(session);
+    pthread_mutex_unlock(&sessions_mutex);
+}
+
+void session_channel(Session *session, int request_id, ReplyChannel *channel) {
+    channel->fd = session->fd;
+    channel->request_id = request_id;
+    channel->lock = &session->write_lock;
+    channel->failed = 0;
+}
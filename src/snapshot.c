@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+
+// Função de dispersão FNV-1a
+static uint32_t fnv1a(uint32_t hash, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// ---------------------------------------------------------------------------
+// Arena de cadeias com interning
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    uint32_t *slots;        // Deslocamento + 1 das cadeias internadas (0 = livre)
+    size_t num_slots;       // Potência de 2
+    size_t num_interned;
+} Arena;
+
+static int arena_init(Arena *arena) {
+    arena->size = 0;
+    arena->capacity = 64 * 1024;
+    arena->data = (char*)malloc(arena->capacity);
+    arena->num_slots = 1024;
+    arena->num_interned = 0;
+    arena->slots = (uint32_t*)calloc(arena->num_slots, sizeof(uint32_t));
+    if (!arena->data || !arena->slots) {
+        free(arena->data);
+        free(arena->slots);
+        return -1;
+    }
+    return 0;
+}
+
+static void arena_free(Arena *arena) {
+    free(arena->data);
+    free(arena->slots);
+}
+
+// Acrescentar uma cadeia sem procurar repetições; -1 se não houver memória
+static int64_t arena_append(Arena *arena, const char *s, size_t len) {
+    if (arena->size + len + 1 > arena->capacity) {
+        size_t capacity = arena->capacity * 2;
+        while (arena->size + len + 1 > capacity) {
+            capacity *= 2;
+        }
+        char *data = (char*)realloc(arena->data, capacity);
+        if (!data) {
+            return -1;
+        }
+        arena->data = data;
+        arena->capacity = capacity;
+    }
+    int64_t offset = arena->size;
+    memcpy(arena->data + offset, s, len);
+    arena->data[offset + len] = '\0';
+    arena->size += len + 1;
+    return offset;
+}
+
+static int arena_grow_slots(Arena *arena) {
+    size_t num_slots = arena->num_slots * 2;
+    uint32_t *slots = (uint32_t*)calloc(num_slots, sizeof(uint32_t));
+    if (!slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < arena->num_slots; i++) {
+        if (!arena->slots[i]) {
+            continue;
+        }
+        const char *s = arena->data + arena->slots[i] - 1;
+        size_t pos = fnv1a(2166136261u, s, strlen(s)) & (num_slots - 1);
+        while (slots[pos]) {
+            pos = (pos + 1) & (num_slots - 1);
+        }
+        slots[pos] = arena->slots[i];
+    }
+    free(arena->slots);
+    arena->slots = slots;
+    arena->num_slots = num_slots;
+    return 0;
+}
+
+// Deslocamento de uma cadeia igual já guardada, ou acrescentá-la
+static int64_t arena_intern(Arena *arena, const char *s, size_t len) {
+    if (arena->num_interned * 2 >= arena->num_slots && arena_grow_slots(arena) < 0) {
+        return -1;
+    }
+
+    size_t pos = fnv1a(2166136261u, s, len) & (arena->num_slots - 1);
+    while (arena->slots[pos]) {
+        const char *existing = arena->data + arena->slots[pos] - 1;
+        if (strncmp(existing, s, len) == 0 && existing[len] == '\0') {
+            return arena->slots[pos] - 1;
+        }
+        pos = (pos + 1) & (arena->num_slots - 1);
+    }
+
+    int64_t offset = arena_append(arena, s, len);
+    if (offset < 0) {
+        return -1;
+    }
+    arena->slots[pos] = (uint32_t)offset + 1;
+    arena->num_interned++;
+    return offset;
+}
+
+// ---------------------------------------------------------------------------
+// Gravação
+// ---------------------------------------------------------------------------
+
+static int write_all(int fd, const void *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t written = write(fd, (const char*)data + done, size - done);
+        if (written <= 0) {
+            return -1;
+        }
+        done += written;
+    }
+    return 0;
+}
+
+// Sincronizar a pasta que contém 'path' (as entradas criadas ou renomeadas)
+static int sync_parent_dir(const char *path) {
+    char dir[MAX_PATH_SIZE * 2];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == dir) {
+        dir[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return -1;
+    }
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+int snapshot_save(const char *path, int next_id, int num_documents, SnapshotGetFn get) {
+    SnapshotRecord *records = (SnapshotRecord*)malloc(sizeof(SnapshotRecord) * (num_documents + 1));
+    Arena arena;
+    if (!records || arena_init(&arena) < 0) {
+        perror("Erro ao alocar memória para snapshot");
+        free(records);
+        return -1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < num_documents && !failed; i++) {
+        Document doc;
+        get(i, &doc);
+        const char *slash = strrchr(doc.path, '/');
+        size_t dir_len = slash ? (size_t)(slash - doc.path + 1) : 0;
+
+        int64_t title = arena_append(&arena, doc.title, strlen(doc.title));
+        int64_t authors = arena_intern(&arena, doc.authors, strlen(doc.authors));
+        int64_t year = arena_intern(&arena, doc.year, strlen(doc.year));
+        int64_t dir = arena_intern(&arena, doc.path, dir_len);
+        int64_t name = arena_append(&arena, doc.path + dir_len, strlen(doc.path + dir_len));
+        if (title < 0 || authors < 0 || year < 0 || dir < 0 || name < 0 || arena.size > UINT32_MAX) {
+            failed = 1;
+            break;
+        }
+
+        records[i].id = doc.id;
+        records[i].title = (uint32_t)title;
+        records[i].authors = (uint32_t)authors;
+        records[i].year = (uint32_t)year;
+        records[i].dir = (uint32_t)dir;
+        records[i].name = (uint32_t)name;
+    }
+    if (failed) {
+        perror("Erro ao alocar memória para snapshot");
+        free(records);
+        arena_free(&arena);
+        return -1;
+    }
+
+    SnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.num_documents = num_documents;
+    header.next_id = next_id;
+    header.arena_size = (uint32_t)arena.size;
+    header.checksum = fnv1a(fnv1a(2166136261u, (const char*)records, sizeof(SnapshotRecord) * num_documents),
+                            arena.data, arena.size);
+
+    char tmp_path[MAX_PATH_SIZE * 2 + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("Erro ao abrir arquivo de dados");
+        free(records);
+        arena_free(&arena);
+        return -1;
+    }
+
+    int result = 0;
+    if (write_all(fd, &header, sizeof(header)) < 0 ||
+        write_all(fd, records, sizeof(SnapshotRecord) * num_documents) < 0 ||
+        write_all(fd, arena.data, arena.size) < 0 || fsync(fd) == -1) {
+        perror("Erro ao gravar snapshot");
+        result = -1;
+    }
+    close(fd);
+    free(records);
+    arena_free(&arena);
+
+    if (result == 0 && rename(tmp_path, path) == -1) {
+        perror("Erro ao gravar snapshot");
+        unlink(tmp_path);
+        return -1;
+    }
+    if (result < 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    // Até a pasta ser sincronizada, uma falha de energia pode deixar o
+    // snapshot anterior, e o diário vai ser esvaziado a seguir
+    if (sync_parent_dir(path) < 0) {
+        perror("Erro ao sincronizar a pasta do snapshot");
+        return -1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Leitura
+// ---------------------------------------------------------------------------
+
+// Snapshot mapeado durante toda a execução
+static const char *mapped = NULL;
+static size_t mapped_size = 0;
+static const SnapshotRecord *mapped_records = NULL;
+static const char *mapped_arena = NULL;
+
+static const char *map_snapshot(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)(2 * sizeof(int))) {
+        close(fd);
+        return NULL;
+    }
+
+    const char *map = (const char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Erro ao mapear snapshot");
+        return NULL;
+    }
+    *size = st.st_size;
+    return map;
+}
+
+// Formato antigo: int num_documents, int next_id e os Documents em bruto.
+// Só é aceite se o tamanho do ficheiro bater certo com o cabeçalho.
+static int is_legacy(const char *map, size_t size) {
+    int header[2];
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    memcpy(header, map, sizeof(header));
+    return header[0] >= 0 && size == sizeof(header) + (size_t)header[0] * sizeof(Document);
+}
+
+int snapshot_map(const char *path, int *next_id) {
+    size_t size;
+    const char *map = map_snapshot(path, &size);
+    if (!map) {
+        return -1;
+    }
+
+    SnapshotHeader header;
+    if (size >= sizeof(header)) {
+        memcpy(&header, map, sizeof(header));
+    }
+    if (size < sizeof(header) || header.magic != SNAPSHOT_MAGIC) {
+        int legacy = is_legacy(map, size);
+        munmap((void*)map, size);
+        if (!legacy) {
+            fprintf(stderr, "Snapshot inválido: %s\n", path);
+            return SNAPSHOT_INVALID;
+        }
+        return SNAPSHOT_LEGACY;
+    }
+
+    // Validação estrutural: tamanhos e deslocamentos de todos os registos.
+    // O checksum obrigaria a ler a arena inteira no arranque; a gravação por
+    // rename garante que nunca fica um snapshot rasgado.
+    size_t records_size = (size_t)header.num_documents * sizeof(SnapshotRecord);
+    int valid = header.version == SNAPSHOT_VERSION &&
+                sizeof(header) + records_size + header.arena_size == size &&
+                (header.arena_size == 0 || map[size - 1] == '\0');
+    const SnapshotRecord *records = (const SnapshotRecord*)(map + sizeof(header));
+    for (uint32_t i = 0; valid && i < header.num_documents; i++) {
+        const SnapshotRecord *r = &records[i];
+        valid = r->title < header.arena_size && r->authors < header.arena_size &&
+                r->year < header.arena_size && r->dir < header.arena_size && r->name < header.arena_size;
+    }
+    if (!valid) {
+        fprintf(stderr, "Snapshot inválido: %s\n", path);
+        munmap((void*)map, size);
+        if (header.next_id > *next_id && header.next_id < INT_MAX) {
+            *next_id = header.next_id;
+        }
+        return SNAPSHOT_INVALID;
+    }
+
+    snapshot_unmap();
+    mapped = map;
+    mapped_size = size;
+    mapped_records = records;
+    mapped_arena = map + sizeof(header) + records_size;
+    *next_id = header.next_id;
+    return (int)header.num_documents;
+}
+
+int snapshot_record_id(int record) {
+    return mapped_records[record].id;
+}
+
+// Copiar uma cadeia da arena, truncando ao tamanho do campo
+static void copy_string(char *dest, size_t size, uint32_t offset) {
+    strncpy(dest, mapped_arena + offset, size - 1);
+    dest[size - 1] = '\0';
+}
+
+void snapshot_read_record(int record, Document *doc) {
+    const SnapshotRecord *r = &mapped_records[record];
+    doc->id = r->id;
+    copy_string(doc->title, MAX_TITLE_SIZE, r->title);
+    copy_string(doc->authors, MAX_AUTHORS_SIZE, r->authors);
+    copy_string(doc->year, MAX_YEAR_SIZE, r->year);
+    snprintf(doc->path, MAX_PATH_SIZE, "%s%s", mapped_arena + r->dir, mapped_arena + r->name);
+}
+
+int snapshot_verify(SnapshotThrottleFn throttle) {
+    if (!mapped) {
+        return -1;
+    }
+    SnapshotHeader header;
+    memcpy(&header, mapped, sizeof(header));
+
+    // Registos e arena são contíguos no ficheiro
+    const char *data = mapped + sizeof(header);
+    size_t size = mapped_size - sizeof(header);
+    uint32_t hash = 2166136261u;
+    for (size_t done = 0; done < size; ) {
+        size_t chunk = size - done < SNAPSHOT_VERIFY_CHUNK ? size - done : SNAPSHOT_VERIFY_CHUNK;
+        hash = fnv1a(hash, data + done, chunk);
+        done += chunk;
+        if (throttle) {
+            throttle(chunk);
+        }
+    }
+    return hash == header.checksum;
+}
+
+void snapshot_unmap() {
+    if (mapped) {
+        munmap((void*)mapped, mapped_size);
+    }
+    mapped = NULL;
+    mapped_records = NULL;
+    mapped_arena = NULL;
+}
+
+// Formato anterior: número de documentos, próximo ID e Documents em bruto
+int snapshot_load_legacy(const char *path, int *next_id, int max_documents, SnapshotDocFn on_document) {
+    size_t size;
+    const char *map = map_snapshot(path, &size);
+    if (!map) {
+        return -1;
+    }
+    if (!is_legacy(map, size)) {
+        munmap((void*)map, size);
+        return -1;
+    }
+    madvise((void*)map, size, MADV_SEQUENTIAL);
+
+    int header[2];
+    memcpy(header, map, sizeof(header));
+    *next_id = header[1];
+
+    // Se não cabem todos, ficam os últimos (os mais recentes), como no
+    // formato novo
+    int count = header[0];
+    int first = count > max_documents ? count - max_documents : 0;
+    for (int i = first; i < count; i++) {
+        Document doc;
+        memcpy(&doc, map + sizeof(header) + sizeof(Document) * i, sizeof(Document));
+        // As cadeias do ficheiro podem não estar terminadas
+        doc.title[MAX_TITLE_SIZE - 1] = '\0';
+        doc.authors[MAX_AUTHORS_SIZE - 1] = '\0';
+        doc.year[MAX_YEAR_SIZE - 1] = '\0';
+        doc.path[MAX_PATH_SIZE - 1] = '\0';
+        on_document(&doc);
+    }
+
+    munmap((void*)map, size);
+    return 0;
+}
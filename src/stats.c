@@ -0,0 +1,119 @@
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "stats.h"
+
+#define SUB_BUCKETS 8                       // Intervalos por potência de 2
+#define MAX_BITS 40                         // Latências até 2^40 us (~12 dias)
+#define NUM_BUCKETS (2 * SUB_BUCKETS + (MAX_BITS - 4) * SUB_BUCKETS)
+
+typedef struct {
+    atomic_long requests;
+    atomic_long max_us;
+    atomic_long buckets[NUM_BUCKETS];
+} OpHistogram;
+
+static OpHistogram histograms[NUM_OPERATIONS];
+static atomic_long counters[STAT_NUM_COUNTERS];
+static struct timespec started;
+
+// Valores abaixo de 16 têm um intervalo cada; a partir daí cada potência de 2
+// é dividida em SUB_BUCKETS intervalos iguais
+static int bucket_of(long us) {
+    if (us < 2 * SUB_BUCKETS) {
+        return us < 0 ? 0 : (int)us;
+    }
+    int msb = 63 - __builtin_clzl((unsigned long)us);
+    if (msb >= MAX_BITS) {
+        return NUM_BUCKETS - 1;
+    }
+    int sub = (int)((us >> (msb - 3)) & (SUB_BUCKETS - 1));
+    return 2 * SUB_BUCKETS + (msb - 4) * SUB_BUCKETS + sub;
+}
+
+// Maior valor que cabe no intervalo
+static long bucket_limit(int bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return bucket;
+    }
+    int msb = (bucket - 2 * SUB_BUCKETS) / SUB_BUCKETS + 4;
+    long sub = (bucket - 2 * SUB_BUCKETS) % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << (msb - 3)) - 1;
+}
+
+void stats_init() {
+    memset(histograms, 0, sizeof(histograms));
+    memset(counters, 0, sizeof(counters));
+    clock_gettime(CLOCK_MONOTONIC, &started);
+}
+
+void stats_add(StatCounter counter, long n) {
+    atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+void stats_record(int operation, long elapsed_us) {
+    if (operation <= 0 || operation >= NUM_OPERATIONS) {
+        return;
+    }
+    OpHistogram *h = &histograms[operation];
+    atomic_fetch_add_explicit(&h->requests, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->buckets[bucket_of(elapsed_us)], 1, memory_order_relaxed);
+
+    long max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (elapsed_us > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max_us, &max, elapsed_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Menor limite de intervalo que cobre a fração 'quantile' dos pedidos
+static long percentile(const long *buckets, long total, double quantile, long max) {
+    long rank = (long)(quantile * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    long seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            long limit = bucket_limit(b);
+            return limit < max ? limit : max;
+        }
+    }
+    return max;
+}
+
+void stats_collect(ServerStats *stats) {
+    memset(stats, 0, sizeof(ServerStats));
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    stats->uptime_ms = (now.tv_sec - started.tv_sec) * 1000 + (now.tv_nsec - started.tv_nsec) / 1000000;
+
+    for (int op = 1; op < NUM_OPERATIONS; op++) {
+        OpHistogram *h = &histograms[op];
+        // Cópia dos intervalos: o total é o da cópia, não o contador de pedidos
+        // (podem estar a ser registados pedidos entretanto)
+        long buckets[NUM_BUCKETS];
+        long total = 0;
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            buckets[b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            total += buckets[b];
+        }
+
+        OpStats *op_stats = &stats->ops[op];
+        op_stats->requests = atomic_load_explicit(&h->requests, memory_order_relaxed);
+        op_stats->max_us = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+        if (total > 0) {
+            op_stats->p50_us = percentile(buckets, total, 0.50, op_stats->max_us);
+            op_stats->p99_us = percentile(buckets, total, 0.99, op_stats->max_us);
+            op_stats->p999_us = percentile(buckets, total, 0.999, op_stats->max_us);
+        }
+    }
+
+    stats->bytes_scanned = atomic_load(&counters[STAT_BYTES_SCANNED]);
+    stats->files_opened = atomic_load(&counters[STAT_FILES_OPENED]);
+    stats->doc_hits = atomic_load(&counters[STAT_DOC_HITS]);
+    stats->doc_misses = atomic_load(&counters[STAT_DOC_MISSES]);
+    stats->doc_evictions = atomic_load(&counters[STAT_DOC_EVICTIONS]);
+}
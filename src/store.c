@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "common.h"
+#include "hashmap.h"
+#include "store.h"
+
+static Document *documents = NULL;  // Documentos em posições contíguas
+static int *ids = NULL;             // ID de cada posição, mesmo por carregar
+static int *records = NULL;         // Registo do snapshot de cada posição por carregar
+static unsigned char *loaded = NULL;
+static StoreLoadFn loader = NULL;
+static int *lru_prev = NULL;        // Lista LRU: cabeça = mais recente, cauda = menos recente
+static int *lru_next = NULL;
+static int lru_head = -1;
+static int lru_tail = -1;
+static int num_documents = 0;
+static int capacity = 0;
+static IntMap slots;                // doc_id -> posição
+
+// As consultas atualizam a ordem LRU com o lock de leitura dos metadados,
+// por isso a lista tem o seu próprio mutex
+static pthread_mutex_t lru_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Várias threads de leitura podem pedir o mesmo documento por carregar
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int store_init(int size) {
+    documents = (Document*)malloc(sizeof(Document) * size);
+    lru_prev = (int*)malloc(sizeof(int) * size);
+    lru_next = (int*)malloc(sizeof(int) * size);
+    ids = (int*)malloc(sizeof(int) * size);
+    records = (int*)malloc(sizeof(int) * size);
+    loaded = (unsigned char*)malloc(size);
+    if (!documents || !lru_prev || !lru_next || !ids || !records || !loaded ||
+        intmap_init(&slots, size) < 0) {
+        store_free();
+        return -1;
+    }
+
+    capacity = size;
+    num_documents = 0;
+    lru_head = lru_tail = -1;
+    return 0;
+}
+
+void store_free() {
+    free(documents);
+    free(lru_prev);
+    free(lru_next);
+    free(ids);
+    free(records);
+    free(loaded);
+    documents = NULL;
+    lru_prev = lru_next = NULL;
+    ids = records = NULL;
+    loaded = NULL;
+    if (slots.keys) {
+        intmap_free(&slots);
+    }
+    num_documents = capacity = 0;
+    lru_head = lru_tail = -1;
+}
+
+int store_count() {
+    return num_documents;
+}
+
+int store_capacity() {
+    return capacity;
+}
+
+void store_set_loader(StoreLoadFn load) {
+    loader = load;
+}
+
+Document *store_get(int slot) {
+    if (!__atomic_load_n(&loaded[slot], __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&load_mutex);
+        if (!loaded[slot]) {
+            loader(records[slot], &documents[slot]);
+            __atomic_store_n(&loaded[slot], 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&load_mutex);
+    }
+    return &documents[slot];
+}
+
+int store_id(int slot) {
+    return ids[slot];
+}
+
+void store_peek(int slot, Document *doc) {
+    if (__atomic_load_n(&loaded[slot], __ATOMIC_ACQUIRE)) {
+        *doc = documents[slot];
+    } else {
+        loader(records[slot], doc);
+    }
+}
+
+int store_find(int doc_id) {
+    int slot;
+    if (intmap_get(&slots, doc_id, &slot) < 0) {
+        return -1;
+    }
+    return slot;
+}
+
+static void lru_unlink(int slot) {
+    if (lru_prev[slot] != -1) {
+        lru_next[lru_prev[slot]] = lru_next[slot];
+    } else {
+        lru_head = lru_next[slot];
+    }
+    if (lru_next[slot] != -1) {
+        lru_prev[lru_next[slot]] = lru_prev[slot];
+    } else {
+        lru_tail = lru_prev[slot];
+    }
+}
+
+static void lru_push_front(int slot) {
+    lru_prev[slot] = -1;
+    lru_next[slot] = lru_head;
+    if (lru_head != -1) {
+        lru_prev[lru_head] = slot;
+    }
+    lru_head = slot;
+    if (lru_tail == -1) {
+        lru_tail = slot;
+    }
+}
+
+int store_insert(const Document *doc) {
+    if (num_documents >= capacity) {
+        return -1;
+    }
+
+    int slot = num_documents++;
+    documents[slot] = *doc;
+    ids[slot] = doc->id;
+    loaded[slot] = 1;
+    intmap_put(&slots, doc->id, slot);
+    pthread_mutex_lock(&lru_mutex);
+    lru_push_front(slot);
+    pthread_mutex_unlock(&lru_mutex);
+    return slot;
+}
+
+int store_insert_lazy(int doc_id, int record) {
+    if (num_documents >= capacity) {
+        return -1;
+    }
+
+    int slot = num_documents++;
+    ids[slot] = doc_id;
+    records[slot] = record;
+    loaded[slot] = 0;
+    intmap_put(&slots, doc_id, slot);
+    pthread_mutex_lock(&lru_mutex);
+    lru_push_front(slot);
+    pthread_mutex_unlock(&lru_mutex);
+    return slot;
+}
+
+void store_remove(int slot) {
+    intmap_remove(&slots, ids[slot]);
+    pthread_mutex_lock(&lru_mutex);
+    lru_unlink(slot);
+
+    // Mover o último documento para a posição libertada
+    int last = num_documents - 1;
+    if (slot != last) {
+        if (loaded[last]) {
+            documents[slot] = documents[last];
+        }
+        ids[slot] = ids[last];
+        records[slot] = records[last];
+        loaded[slot] = loaded[last];
+        intmap_put(&slots, ids[slot], slot);
+
+        lru_prev[slot] = lru_prev[last];
+        lru_next[slot] = lru_next[last];
+        if (lru_prev[slot] != -1) {
+            lru_next[lru_prev[slot]] = slot;
+        } else {
+            lru_head = slot;
+        }
+        if (lru_next[slot] != -1) {
+            lru_prev[lru_next[slot]] = slot;
+        } else {
+            lru_tail = slot;
+        }
+    }
+    pthread_mutex_unlock(&lru_mutex);
+    num_documents--;
+}
+
+void store_touch(int slot) {
+    pthread_mutex_lock(&lru_mutex);
+    if (lru_head != slot) {
+        lru_unlink(slot);
+        lru_push_front(slot);
+    }
+    pthread_mutex_unlock(&lru_mutex);
+}
+
+int store_lru() {
+    pthread_mutex_lock(&lru_mutex);
+    int slot = lru_tail;
+    pthread_mutex_unlock(&lru_mutex);
+    return slot;
+}
+
+int store_lru_order(int *order) {
+    pthread_mutex_lock(&lru_mutex);
+    int count = 0;
+    for (int slot = lru_tail; slot != -1; slot = lru_prev[slot]) {
+        order[count++] = slot;
+    }
+    pthread_mutex_unlock(&lru_mutex);
+    return count;
+}
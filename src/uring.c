@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "common.h"
+#include "uring.h"
+
+// Espaço antes de cada bloco para os últimos bytes do bloco anterior
+#define URING_PREFIX 4096
+#define URING_SLOT_SIZE (URING_PREFIX + URING_BLOCK_SIZE)
+
+#define SLOT_FREE 0
+#define SLOT_OPENING 1
+#define SLOT_READING 2
+
+typedef struct {
+    int fd;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    void *cq_map;
+    size_t sq_map_size;
+    size_t cq_map_size;
+    size_t sqes_size;
+    unsigned to_submit;     // Pedidos preparados e ainda não entregues ao kernel
+} Ring;
+
+// Um ficheiro em curso
+typedef struct {
+    int state;
+    int file;
+    int fd;
+    off_t offset;
+    size_t kept;            // Bytes do bloco anterior antes do buffer de leitura
+    char *buffer;           // Início do prefixo; a leitura vai para buffer + URING_PREFIX
+} Slot;
+
+static int available = -1;  // Ainda não verificado
+
+static int ring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int ring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_close(Ring *ring) {
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    if (ring->fd != -1) {
+        close(ring->fd);
+    }
+}
+
+// Os pedidos usados (abrir e ler) só existem a partir do Linux 5.6
+static int ring_supports_ops(int fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe*)calloc(1, size);
+    if (!probe) {
+        return 0;
+    }
+    int supported = 0;
+    if (ring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        int ops[3] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED };
+        supported = 1;
+        for (int i = 0; i < 3; i++) {
+            if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = 0;
+            }
+        }
+    }
+    free(probe);
+    return supported;
+}
+
+static int ring_open(Ring *ring, unsigned entries) {
+    memset(ring, 0, sizeof(Ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = ring_setup(entries, &params);
+    if (ring->fd == -1) {
+        return -1;
+    }
+    if (!ring_supports_ops(ring->fd)) {
+        ring_close(ring);
+        return -1;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map && ring->cq_map_size > ring->sq_map_size) {
+        ring->sq_map_size = ring->cq_map_size;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        ring_close(ring);
+        return -1;
+    }
+    ring->cq_map = single_map ? ring->sq_map
+                              : mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                     ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_map == MAP_FAILED) {
+        ring->cq_map = NULL;
+        ring_close(ring);
+        return -1;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        ring_close(ring);
+        return -1;
+    }
+
+    char *sq = (char*)ring->sq_map;
+    char *cq = (char*)ring->cq_map;
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+// Próxima entrada livre da fila de submissão. Há no máximo um pedido por
+// ficheiro em curso, por isso a fila (URING_DEPTH entradas) nunca enche.
+static struct io_uring_sqe *ring_get_sqe(Ring *ring, unsigned long long user_data) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+    return sqe;
+}
+
+// Entregar os pedidos preparados e esperar por pelo menos min_complete
+static int ring_submit(Ring *ring, unsigned min_complete) {
+    while (1) {
+        int submitted = ring_enter(ring->fd, ring->to_submit, min_complete,
+                                   min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted >= 0) {
+            ring->to_submit -= submitted;
+            return 0;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+int uring_available() {
+    if (available == -1) {
+        Ring ring;
+        available = ring_open(&ring, 1) == 0;
+        if (available) {
+            ring_close(&ring);
+        }
+    }
+    return available;
+}
+
+static void prepare_open(Ring *ring, Slot *slot, int index, const char *path) {
+    struct io_uring_sqe *sqe = ring_get_sqe(ring, index);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long long)(uintptr_t)path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    slot->state = SLOT_OPENING;
+}
+
+static void prepare_read(Ring *ring, Slot *slot, int index, int fixed) {
+    struct io_uring_sqe *sqe = ring_get_sqe(ring, index);
+    sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->addr = (unsigned long long)(uintptr_t)(slot->buffer + URING_PREFIX);
+    sqe->len = URING_BLOCK_SIZE;
+    sqe->off = slot->offset;
+    sqe->buf_index = fixed ? index : 0;
+    slot->state = SLOT_READING;
+}
+
+static void release_slot(Slot *slot) {
+    if (slot->fd != -1) {
+        close(slot->fd);
+    }
+    slot->fd = -1;
+    slot->state = SLOT_FREE;
+}
+
+// Depois de uma falha: recolher as respostas de todos os pedidos em curso,
+// sem as tratar. Até lá o kernel ainda pode escrever nos buffers, que só então
+// podem ser libertados. 0 ou -1 se o anel deixou de responder
+static int ring_drain(Ring *ring, Slot *slots, int active) {
+    int retries = 0;
+    while (1) {
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            Slot *slot = &slots[cqe->user_data];
+            if (slot->state == SLOT_OPENING && cqe->res >= 0) {
+                slot->fd = cqe->res;
+            }
+            release_slot(slot);
+            active--;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        if (active == 0) {
+            return 0;
+        }
+
+        int submitted = ring_enter(ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (submitted >= 0) {
+            ring->to_submit -= submitted;
+        } else if (errno == EINTR) {
+            continue;
+        } else if ((errno == EAGAIN || errno == EBUSY) && retries++ < 100) {
+            usleep(1000); // Falta de memória temporária no kernel
+        } else {
+            return -1;
+        }
+    }
+}
+
+// Tratar uma leitura terminada; 1 se o ficheiro chegou ao fim
+static int handle_read(Slot *slot, int res, size_t overlap, const UringCallbacks *callbacks, void *arg) {
+    char *data = slot->buffer + URING_PREFIX - slot->kept;
+    size_t len = slot->kept + res;
+    if (callbacks->block(slot->file, data, len, slot->kept, arg)) {
+        return 1;
+    }
+    // Num ficheiro regular, uma leitura incompleta só acontece no fim
+    if (res < URING_BLOCK_SIZE) {
+        return 1;
+    }
+    slot->offset += res;
+    slot->kept = len < overlap ? len : overlap;
+    memmove(slot->buffer + URING_PREFIX - slot->kept, data + len - slot->kept, slot->kept);
+    return 0;
+}
+
+int uring_scan_files(const char *const *paths, int count, size_t overlap,
+                     const UringCallbacks *callbacks, void *arg) {
+    if (overlap > MAX_KEYWORD_SIZE) {
+        overlap = MAX_KEYWORD_SIZE;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+    if (!uring_available()) {
+        return -1;
+    }
+
+    Ring ring;
+    if (ring_open(&ring, URING_DEPTH) == -1) {
+        return -1;
+    }
+    int depth = count < URING_DEPTH ? count : URING_DEPTH;
+    size_t buffers_size = (size_t)depth * URING_SLOT_SIZE;
+    char *buffers = (char*)mmap(NULL, buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        ring_close(&ring);
+        return -1;
+    }
+
+    // Buffers registados: o kernel não tem de os mapear em cada leitura.
+    // Sem memória bloqueável suficiente (RLIMIT_MEMLOCK), leituras normais.
+    Slot slots[URING_DEPTH];
+    struct iovec iovecs[URING_DEPTH];
+    for (int i = 0; i < depth; i++) {
+        slots[i].state = SLOT_FREE;
+        slots[i].fd = -1;
+        slots[i].buffer = buffers + (size_t)i * URING_SLOT_SIZE;
+        iovecs[i].iov_base = slots[i].buffer;
+        iovecs[i].iov_len = URING_SLOT_SIZE;
+    }
+    int fixed = ring_register(ring.fd, IORING_REGISTER_BUFFERS, iovecs, depth) == 0;
+
+    int next_file = 0;
+    int active = 0;
+    int stopping = 0;
+    int failed = 0;
+    while (next_file < count || active > 0) {
+        // Ocupar os buffers livres com os ficheiros seguintes
+        for (int i = 0; i < depth && next_file < count && !stopping; i++) {
+            if (slots[i].state == SLOT_FREE) {
+                slots[i].file = next_file;
+                slots[i].offset = 0;
+                slots[i].kept = 0;
+                prepare_open(&ring, &slots[i], i, paths[next_file++]);
+                active++;
+            }
+        }
+        if (active == 0) {
+            break;
+        }
+        if (ring_submit(&ring, 1) == -1) {
+            failed = 1;
+            break;
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & ring.cq_mask];
+            int index = (int)cqe->user_data;
+            int res = cqe->res;
+            Slot *slot = &slots[index];
+            int finished = 0;
+            int error = 0;
+
+            if (slot->state == SLOT_OPENING) {
+                if (res < 0) {
+                    error = -res;
+                    finished = 1;
+                } else {
+                    slot->fd = res;
+                    finished = stopping || callbacks->opened(slot->file, slot->fd, arg);
+                }
+            } else if (res < 0) {
+                error = -res;
+                finished = 1;
+            } else {
+                finished = res == 0 || stopping || handle_read(slot, res, overlap, callbacks, arg);
+            }
+
+            if (!finished) {
+                prepare_read(&ring, slot, index, fixed);
+                continue;
+            }
+            int file = slot->file;
+            release_slot(slot);
+            active--;
+            // Depois de parar, os pedidos em curso só são recolhidos
+            if (!stopping && callbacks->done(file, error, arg)) {
+                stopping = 1;
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    // Sem falha, o ciclo só termina sem pedidos em curso
+    int drained = !failed || ring_drain(&ring, slots, active) == 0;
+    if (!drained) {
+        perror("Erro no io_uring");
+        for (int i = 0; i < depth; i++) {
+            if (slots[i].state != SLOT_FREE) {
+                release_slot(&slots[i]);
+            }
+        }
+    }
+    // Os buffers registados ficam presos pelo kernel até o anel ser fechado.
+    // Se ficaram leituras por recolher, os buffers não são libertados: o
+    // kernel ainda pode lá escrever
+    ring_close(&ring);
+    if (drained) {
+        munmap(buffers, buffers_size);
+    }
+    return failed ? -1 : 0;
+}
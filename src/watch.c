@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include "common.h"
+#include "watch.h"
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF)
+
+// Diretoria vigiada: descritor do inotify e caminho relativo ("" = a pasta)
+typedef struct {
+    int wd;
+    char dir[MAX_PATH_SIZE];
+} WatchedDir;
+
+static int inotify_fd = -1;
+static char folder[MAX_PATH_SIZE];
+static WatchedDir *dirs = NULL;
+static int num_dirs = 0;
+static int cap_dirs = 0;
+static pthread_mutex_t dirs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Eventos lidos e ainda não entregues
+static char events[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+static ssize_t events_len = 0;
+static ssize_t events_pos = 0;
+
+int watch_open(const char *document_folder) {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd == -1) {
+        perror("Erro ao iniciar inotify");
+        return -1;
+    }
+    strncpy(folder, document_folder, MAX_PATH_SIZE - 1);
+    folder[MAX_PATH_SIZE - 1] = '\0';
+    return 0;
+}
+
+void watch_close() {
+    if (inotify_fd != -1) {
+        close(inotify_fd);
+    }
+    inotify_fd = -1;
+    pthread_mutex_lock(&dirs_mutex);
+    free(dirs);
+    dirs = NULL;
+    num_dirs = 0;
+    cap_dirs = 0;
+    pthread_mutex_unlock(&dirs_mutex);
+}
+
+int watch_fd() {
+    return inotify_fd;
+}
+
+int watch_add_path(const char *path) {
+    if (inotify_fd == -1) {
+        return -1;
+    }
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path) : 0;
+
+    pthread_mutex_lock(&dirs_mutex);
+    for (int i = 0; i < num_dirs; i++) {
+        if (strlen(dirs[i].dir) == dir_len && strncmp(dirs[i].dir, path, dir_len) == 0) {
+            pthread_mutex_unlock(&dirs_mutex);
+            return 0; // Já vigiada
+        }
+    }
+    if (num_dirs == cap_dirs) {
+        int capacity = cap_dirs > 0 ? cap_dirs * 2 : 8;
+        WatchedDir *grown = (WatchedDir*)realloc(dirs, sizeof(WatchedDir) * capacity);
+        if (!grown) {
+            pthread_mutex_unlock(&dirs_mutex);
+            return -1;
+        }
+        dirs = grown;
+        cap_dirs = capacity;
+    }
+
+    char full_path[MAX_PATH_SIZE * 2];
+    snprintf(full_path, sizeof(full_path), "%s/%.*s", folder, (int)dir_len, path);
+    int wd = inotify_add_watch(inotify_fd, full_path, WATCH_MASK);
+    if (wd == -1) {
+        pthread_mutex_unlock(&dirs_mutex);
+        return -1; // Diretoria inexistente: o documento já não pode ser lido
+    }
+    WatchedDir *entry = &dirs[num_dirs++];
+    entry->wd = wd;
+    snprintf(entry->dir, MAX_PATH_SIZE, "%.*s", (int)dir_len, path);
+    pthread_mutex_unlock(&dirs_mutex);
+    return 0;
+}
+
+// Chamada com dirs_mutex
+static int find_dir(int wd) {
+    for (int i = 0; i < num_dirs; i++) {
+        if (dirs[i].wd == wd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int watch_next(char *path, size_t size) {
+    while (1) {
+        if (events_pos >= events_len) {
+            events_len = inotify_fd == -1 ? -1 : read(inotify_fd, events, sizeof(events));
+            events_pos = 0;
+            if (events_len <= 0) {
+                events_len = 0;
+                return 0; // EAGAIN: nada pendente
+            }
+        }
+
+        const struct inotify_event *event = (const struct inotify_event*)(events + events_pos);
+        events_pos += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            path[0] = '\0';
+            return WATCH_OVERFLOW;
+        }
+
+        pthread_mutex_lock(&dirs_mutex);
+        int i = find_dir(event->wd);
+        if (i >= 0 && (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))) {
+            // A diretoria desapareceu: os seus documentos também
+            dirs[i] = dirs[--num_dirs];
+            pthread_mutex_unlock(&dirs_mutex);
+            path[0] = '\0';
+            return WATCH_OVERFLOW;
+        }
+        if (i < 0 || event->len == 0 || (event->mask & IN_ISDIR) || strncmp(event->name, ".index", 6) == 0) {
+            pthread_mutex_unlock(&dirs_mutex);
+            continue;
+        }
+        if (dirs[i].dir[0] != '\0') {
+            snprintf(path, size, "%s/%s", dirs[i].dir, event->name);
+        } else {
+            snprintf(path, size, "%s", event->name);
+        }
+        pthread_mutex_unlock(&dirs_mutex);
+
+        return (event->mask & (IN_DELETE | IN_MOVED_FROM)) ? WATCH_REMOVED : WATCH_CHANGED;
+    }
+}
@@ -0,0 +1,116 @@
+#!/bin/bash
+# Recuperação depois de uma paragem abrupta do servidor (kill -9): tudo o que
+# foi confirmado ao cliente tem de sobreviver através do diário, e um registo
+# final incompleto no diário é descartado no arranque.
+#
+# A cache (CACHE documentos) é menor do que o número de documentos, para que
+# reaplicar o diário também retire documentos da cache e do índice.
+#
+# Uso: tests/recovery.sh (depois de make; BIN indica outra pasta de binários)
+
+BIN=$(cd "${BIN:-$(dirname "$0")/../bin}" && pwd)
+DOCS=$(mktemp -d)
+CACHE=15
+SERVER_PID=
+FAILED=0
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -9 "$SERVER_PID"
+        wait "$SERVER_PID"
+    fi 2>/dev/null
+    rm -rf "$DOCS"
+}
+trap cleanup EXIT
+
+start_server() {
+    # Depois de um kill -9 o pipe fica: o servidor criaria outro por baixo
+    # de um cliente que já o tivesse aberto
+    rm -f /tmp/server_pipe
+    "$BIN/dserver" "$DOCS" $CACHE -B 0 >> "$DOCS/server.log" 2>&1 &
+    SERVER_PID=$!
+    for i in $(seq 50); do
+        if [ -p /tmp/server_pipe ]; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    echo "O servidor não arrancou:"
+    cat "$DOCS/server.log"
+    exit 1
+}
+
+check() {
+    local description=$1 expected=$2 actual=$3
+    if [ "$actual" = "$expected" ]; then
+        echo "ok   $description"
+    else
+        echo "FAIL $description: esperado '$expected', obtido '$actual'"
+        FAILED=1
+    fi
+}
+
+# Um servidor que morreu deixa o cliente à espera no pipe
+client() {
+    (cd "$DOCS" && timeout 10 "$BIN/dclient" "$@")
+}
+
+if pgrep -x dserver > /dev/null; then
+    echo "Já há um servidor em execução"
+    exit 1
+fi
+
+for i in $(seq 20); do
+    echo "documento $i recuperado" > "$DOCS/doc$i.txt"
+done
+
+# Alterações confirmadas e depois paragem sem aviso
+start_server
+for i in $(seq 20); do
+    client -a "Titulo $i" "Autor" 2024 "doc$i.txt" > /dev/null
+done
+client -d 10 > /dev/null
+{ kill -9 "$SERVER_PID"; wait "$SERVER_PID"; } 2>/dev/null
+SERVER_PID=
+
+# Escrita interrompida a meio de um registo
+printf 'A\0\0' >> "$DOCS/.index_journal"
+
+start_server
+check "documento confirmado antes do kill" "Path: doc20.txt" "$(client -c 20 | grep Path)"
+check "remoção confirmada antes do kill" "" "$(client -c 10 | grep Path)"
+check "pesquisa depois do arranque" "14" "$(client -s recuperado | tr -d '[] ' | tr ',' '\n' | grep -c .)"
+check "registo incompleto descartado" "1" "$(grep -c "Diário truncado" "$DOCS/server.log")"
+check "IDs não são reutilizados" "Document 21 indexed" "$(client -a "Novo" "Autor" 2024 doc1.txt)"
+
+# Paragem normal: snapshot em vez do diário
+client -f > /dev/null
+wait "$SERVER_PID"
+SERVER_PID=
+start_server
+check "documentos depois do snapshot" "15" "$(client -s recuperado | tr -d '[] ' | tr ',' '\n' | grep -c .)"
+client -f > /dev/null
+wait "$SERVER_PID"
+SERVER_PID=
+
+# Um acesso muda o documento a retirar da cache, e os acessos não ficam no
+# diário: a reaplicação tem de retirar o mesmo que o servidor retirou
+rm -f "$DOCS"/.index*
+CACHE=3
+start_server
+for i in 1 2 3; do
+    client -a "Titulo $i" "Autor" 2024 "doc$i.txt" > /dev/null
+done
+client -c 1 > /dev/null
+client -a "Titulo 4" "Autor" 2024 doc4.txt > /dev/null
+{ kill -9 "$SERVER_PID"; wait "$SERVER_PID"; } 2>/dev/null
+SERVER_PID=
+
+start_server
+check "documento usado fica na cache" "Path: doc1.txt" "$(client -c 1 | grep Path)"
+check "documento retirado continua fora" "" "$(client -c 2 | grep Path)"
+client -f > /dev/null
+wait "$SERVER_PID"
+SERVER_PID=
+
+exit $FAILED